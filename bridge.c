@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "u_sstream.h"
+#include "u_strlen.h"
+#include "u_mem.h"
+#include "bridge.h"
+
+static void bridgeCloseClient(BRIDGE_State *br, unsigned id, const char *reason)
+{
+    unsigned i;
+    BRIDGE_Client *client;
+
+    client = &br->clients[id];
+
+    if (client->sock.state == S_STREAM_STATE_INIT)
+        return;
+
+    PL_Printf(DBG_INFO, "bridge client %u disconnected (%s)\n", id, reason);
+    PL_RemovePollHandle((PL_Handle)client->sock.handle);
+    SOCK_StreamFree(&client->sock);
+    client->rxPos = 0;
+
+    /* late responses are dropped */
+    for (i = 0; i < 256; i++)
+    {
+        if (br->requests[i].used && br->requests[i].client == id)
+            br->requests[i].client = BRIDGE_NO_CLIENT;
+    }
+}
+
+int BRIDGE_Init(BRIDGE_State *br, const char *addr, int mode)
+{
+    unsigned i;
+    U_SStream ss;
+    char host[16];
+    unsigned short port;
+
+    br->mode = mode;
+
+    /* called again on each retry, keep the socket */
+    if (br->listener.state == S_STREAM_STATE_LISTEN && br->addr == addr)
+        return 1;
+
+    BRIDGE_Exit(br);
+
+    for (i = 0; i < 256; i++)
+        br->requests[i].used = 0;
+
+    U_sstream_init(&ss, (void*)addr, U_strlen(addr));
+
+    if (U_sstream_starts_with(&ss, "unix:"))
+    {
+        if (SOCK_StreamListenUnix(&br->listener, &addr[5]) != 1)
+            return 0;
+    }
+    else if (U_sstream_starts_with(&ss, "tcp:"))
+    {
+        if (SOCK_ParseHostPort(&addr[4], &host[0], sizeof(host), &port) != 1)
+            return 0;
+
+        /* default is loopback */
+        if (SOCK_StreamListenTcp(&br->listener, host[0] ? host : "127.0.0.1", port) != 1)
+            return 0;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (PL_AddPollHandle((PL_Handle)br->listener.handle) != 1)
+    {
+        SOCK_StreamFree(&br->listener);
+        return 0;
+    }
+
+    br->addr = addr;
+    PL_Printf(DBG_INFO, "bridge listening on %s\n", addr);
+
+    return 1;
+}
+
+static void bridgeSend(BRIDGE_State *br, unsigned id, const unsigned char *data, unsigned len)
+{
+    int n;
+
+    n = SOCK_StreamSend(&br->clients[id].sock, data, len);
+
+    /* a partial write would corrupt the stream */
+    if (n != (int)len)
+        bridgeCloseClient(br, id, n < 0 ? "send error" : "client too slow");
+}
+
+void BRIDGE_Send(BRIDGE_State *br, const unsigned char *data, unsigned len)
+{
+    unsigned i;
+    BRIDGE_Request *req;
+    unsigned char buf[2 + BRIDGE_MAX_FRAME];
+
+    if (br->mode == BRIDGE_MODE_RAW)
+    {
+        if (br->clients[0].sock.state == S_STREAM_STATE_CONNECTED)
+            bridgeSend(br, 0, data, len);
+        return;
+    }
+
+    if (len > BRIDGE_MAX_FRAME)
+        return;
+
+    /* single send() per frame, the client sees no partial headers */
+    buf[0] = len & 0xFF;
+    buf[1] = (len >> 8) & 0xFF;
+    U_memcpy(&buf[2], data, len);
+
+    if (len >= 2)
+    {
+        req = &br->requests[data[1]];
+
+        if (req->used && req->cmd == data[0])
+        {
+            req->used = 0;
+
+            if (req->client != BRIDGE_NO_CLIENT)
+            {
+                buf[3] = req->seq;
+                bridgeSend(br, req->client, &buf[0], len + 2);
+            }
+            return;
+        }
+    }
+
+    /* unsolicited */
+    for (i = 0; i < BRIDGE_MAX_CLIENTS; i++)
+    {
+        if (br->clients[i].sock.state == S_STREAM_STATE_CONNECTED)
+            bridgeSend(br, i, &buf[0], len + 2);
+    }
+}
+
+/* Replaces the sequence number of a client request by a shared one.
+   \returns 1 on success, 0 if no sequence number is free. */
+static int bridgeRemapSeq(BRIDGE_State *br, unsigned id, unsigned char *frame)
+{
+    unsigned i;
+    unsigned seq;
+    PL_time_t now;
+    BRIDGE_Request *req;
+
+    now = PL_Time();
+    seq = GCF_NextSeq();
+
+    /* skip sequence numbers of pending requests */
+    for (i = 0; i < 256; i++, seq = GCF_NextSeq())
+    {
+        req = &br->requests[seq];
+        if (!req->used || req->time + BRIDGE_SEQ_TIMEOUT < now)
+            break;
+    }
+
+    if (i == 256) /* overwriting a pending request would misroute its response */
+        return 0;
+
+    req = &br->requests[seq];
+    req->used = 1;
+    req->time = now;
+    req->client = (unsigned char)id;
+    req->seq = frame[1];
+    req->cmd = frame[0];
+
+    frame[1] = (unsigned char)seq;
+
+    return 1;
+}
+
+static void bridgeProcessFrames(BRIDGE_State *br, unsigned id)
+{
+    unsigned i;
+    unsigned pos;
+    unsigned len;
+    BRIDGE_Client *client;
+
+    client = &br->clients[id];
+
+    for (pos = 0; client->rxPos - pos >= 2; pos += 2 + len)
+    {
+        len = client->rx[pos] | (client->rx[pos + 1] << 8);
+
+        if (len == 0 || len > BRIDGE_MAX_FRAME)
+        {
+            bridgeCloseClient(br, id, "invalid frame length");
+            return;
+        }
+
+        if (client->rxPos - pos < 2 + len)
+            break;
+
+        if (len >= 2 && bridgeRemapSeq(br, id, &client->rx[pos + 2]) == 0)
+        {
+            bridgeCloseClient(br, id, "too many pending requests");
+            return;
+        }
+
+        BRIDGE_Received(&client->rx[pos + 2], len);
+    }
+
+    for (i = 0; pos < client->rxPos; i++, pos++)
+        client->rx[i] = client->rx[pos];
+
+    client->rxPos = i;
+}
+
+static void bridgeAccept(BRIDGE_State *br)
+{
+    unsigned id;
+    unsigned max;
+    S_Stream conn;
+
+    if (SOCK_StreamAccept(&br->listener, &conn) != 1)
+        return;
+
+    max = br->mode == BRIDGE_MODE_RAW ? 1 : BRIDGE_MAX_CLIENTS;
+
+    for (id = 0; id < max; id++)
+    {
+        if (br->clients[id].sock.state == S_STREAM_STATE_INIT)
+            break;
+    }
+
+    if (id == max)
+    {
+        PL_Printf(DBG_INFO, "bridge busy, connection refused\n");
+        SOCK_StreamFree(&conn);
+    }
+    else if (PL_AddPollHandle((PL_Handle)conn.handle) != 1)
+    {
+        SOCK_StreamFree(&conn);
+    }
+    else
+    {
+        br->clients[id].sock = conn;
+        br->clients[id].rxPos = 0;
+        PL_Printf(DBG_INFO, "bridge client %u connected\n", id);
+    }
+}
+
+int BRIDGE_Readable(BRIDGE_State *br, PL_Handle handle)
+{
+    int n;
+    unsigned id;
+    BRIDGE_Client *client;
+
+    if (br->listener.state == S_STREAM_STATE_LISTEN && handle == (PL_Handle)br->listener.handle)
+    {
+        bridgeAccept(br);
+        return 1;
+    }
+
+    for (id = 0; id < BRIDGE_MAX_CLIENTS; id++)
+    {
+        client = &br->clients[id];
+
+        if (client->sock.state != S_STREAM_STATE_CONNECTED || handle != (PL_Handle)client->sock.handle)
+            continue;
+
+        n = SOCK_StreamRecv(&client->sock, &client->rx[client->rxPos], BRIDGE_RX_SIZE - client->rxPos);
+
+        if (n < 0)
+        {
+            bridgeCloseClient(br, id, "closed");
+        }
+        else if (n > 0 && br->mode == BRIDGE_MODE_RAW)
+        {
+            BRIDGE_Received(&client->rx[0], (unsigned)n);
+        }
+        else if (n > 0)
+        {
+            client->rxPos += (unsigned)n;
+            bridgeProcessFrames(br, id);
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+void BRIDGE_Exit(BRIDGE_State *br)
+{
+    unsigned id;
+
+    for (id = 0; id < BRIDGE_MAX_CLIENTS; id++)
+        bridgeCloseClient(br, id, "exit");
+
+    if (br->listener.state != S_STREAM_STATE_INIT)
+    {
+        PL_RemovePollHandle((PL_Handle)br->listener.handle);
+        SOCK_StreamFree(&br->listener);
+    }
+
+    br->addr = 0;
+}
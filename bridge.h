@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include "gcf.h"
+#include "net_sock.h"
+
+/* Serial to network bridge
+
+   Forwards the serial link to clients on a TCP or Unix domain socket.
+   In raw mode bytes are passed unchanged in both directions to a single
+   client. In frame mode clients exchange decoded frames (no SLIP framing
+   and CRC), each preceded by its length as U16 little-endian; the device
+   side is SLIP framed with CRC as usual.
+
+   Frame mode multiplexes up to BRIDGE_MAX_CLIENTS clients. The sequence
+   number of each request is replaced by one of the shared GCF_NextSeq()
+   space, a response with that sequence number and command is routed back
+   to the requesting client with its original sequence number restored.
+   All other frames from the device are sent to every client. A client
+   whose request finds all 256 sequence numbers pending is disconnected.
+*/
+#define BRIDGE_MODE_RAW    0
+#define BRIDGE_MODE_FRAMES 1
+#define BRIDGE_MAX_FRAME   256
+#define BRIDGE_RX_SIZE     2048
+#define BRIDGE_MAX_CLIENTS 8
+#define BRIDGE_SEQ_TIMEOUT 10000 /* ms until an unanswered request is dropped */
+#define BRIDGE_NO_CLIENT   0xFF
+
+typedef struct BRIDGE_Client
+{
+    S_Stream sock;
+    unsigned rxPos; /* pending bytes of incomplete frame */
+    unsigned char rx[BRIDGE_RX_SIZE];
+} BRIDGE_Client;
+
+typedef struct BRIDGE_Request
+{
+    PL_time_t time;
+    unsigned char used;
+    unsigned char client;
+    unsigned char seq; /* original sequence number */
+    unsigned char cmd;
+} BRIDGE_Request;
+
+typedef struct BRIDGE_State
+{
+    int mode;
+    const char *addr;
+    S_Stream listener;
+    BRIDGE_Client clients[BRIDGE_MAX_CLIENTS];
+    BRIDGE_Request requests[256]; /* indexed by shared sequence number */
+} BRIDGE_State;
+
+/*! Listens on "tcp:[<addr>:]<port>" or "unix:<path>", the socket and
+    client connection are kept when called again with the same address.
+ */
+int BRIDGE_Init(BRIDGE_State *br, const char *addr, int mode);
+/*! Forwards data from the device, a raw chunk or a single decoded frame. */
+void BRIDGE_Send(BRIDGE_State *br, const unsigned char *data, unsigned len);
+/*! \returns 1 if \p handle belongs to the bridge and was processed. */
+int BRIDGE_Readable(BRIDGE_State *br, PL_Handle handle);
+void BRIDGE_Exit(BRIDGE_State *br);
+
+/* callback implemented in gcf.c, raw data or a single frame from a client */
+void BRIDGE_Received(const unsigned char *data, unsigned len);
+
+#endif /* BRIDGE_H */
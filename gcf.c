@@ -24,12 +24,40 @@
 #include "protocol.h"
 #include "net.h"
 #include "net_sock.h"
+#include "metrics.h"
+#include "inventory.h"
+#include "timing.h"
+#include "status.h"
+#include "trace.h"
+#include "replay.h"
+#include "probe.h"
+#ifdef USE_SNIFF
+  #include "sniff.h"
+#endif
+#ifdef USE_NET
+  #include "bridge.h"
+#endif
 
 #define UI_MAX_INPUT_LENGTH 1024
 #define UI_MAX_LINE_LENGTH 384
 #define UI_MAX_LINES 32
 
-#define MAX_DEVICES 4
+#define MAX_DEVICES 512 /* test racks with hundreds of sticks */
+
+#define DEV_KEY_PATH       0
+#define DEV_KEY_SERIAL     1
+#define DEV_KEY_STABLEPATH 2
+#define DEV_KEY_COUNT      3
+
+#define DEV_CACHE_NAME   "gcfflasher-devices"
+#define DEV_CACHE_HEADER "# gcfflasher device cache 1\n"
+#define MAX_DEV_CACHE_SIZE (MAX_DEVICES * 256)
+
+#define SNIFF_RECONNECT_INTERVAL 250
+#define SNIFF_RECONNECT_TIMEOUT 30000
+
+#define GCF_MAX_JOBS 16
+#define GCF_JOB_TIMEOUT 10 /* default retry time in seconds */
 
 #define GCF_HEADER_SIZE 14
 #define GCF_MAGIC 0xCAFEFEED
@@ -45,38 +73,17 @@
 #define FW_VERSION_PLATFORM_AVR  0x00000500 /* 0x26390500*/
 
 
-/* Bootloader V3.x serial protocol */
-#define BTL_MAGIC              0x81
-#define BTL_ID_REQUEST         0x02
-#define BTL_ID_RESPONSE        0x82
-#define BTL_FW_UPDATE_REQUEST  0x03
-#define BTL_FW_UPDATE_RESPONSE 0x83
-#define BTL_FW_DATA_REQUEST    0x04
-#define BTL_FW_DATA_RESPONSE   0x84
-
 /* Bootloader V1 */
 #define V1_PAGESIZE 256
 
-/* Serial commands */
-#define CMD_STATUS             0x07
-#define CMD_FIRMWARE_VERSION   0x0D
-#define CMD_READ_REGISTER      0x18
-#define CMD_WRITE_PARAMETER    0x0B
-
 /* Parameter IDs */
 #define PARAM_WATCHDOG_TIMEOUT 0x26
 
-/* Serial command status codes */
-#define CMD_STATUS_SUCCESS      0x00
-#define CMD_STATUS_FAILURE      0x01
-#define CMD_STATUS_BUSY         0x02
-#define CMD_STATUS_TIMEOUT      0x03
-#define CMD_STATUS_UNSUPPORTED  0x04
-#define CMD_STATUS_ERROR        0x05
-#define CMD_STATUS_ENONET       0x06
-#define CMD_STATUS_EINVAL       0x07
-#define CMD_STATUS_ELEN         0x08
-#define CMD_STATUS_EOFFSET      0x09
+/* Reset, ST_ResetProbe asks firmware and bootloader before choosing a reset */
+#define RESET_PROBE_TIMEOUT    200
+#define RESET_FLAG_FIRMWARE    0x01 /* firmware answered the probe */
+#define RESET_FLAG_UART        0x02 /* watchdog reset tried */
+#define RESET_FLAG_GPIO        0x04 /* FTDI or RaspBee GPIO reset tried */
 
 typedef void (*state_handler_t)(GCF*, Event);
 
@@ -84,11 +91,14 @@ typedef enum
 {
     T_NONE,
     T_RESET,
+    T_RESET_FTDI,
     T_PROGRAM,
     T_LIST,
+    T_INVENTORY,
     T_CONNECT,
     T_DUMP_FLASH,
     T_SNIFF,
+    T_SERVE,
     T_HELP
 } Task;
 
@@ -125,6 +135,19 @@ typedef struct UI_Line
     char buf[UI_MAX_LINE_LENGTH];
 } UI_Line;
 
+#ifdef USE_NET
+/* Job received in server mode (--serve) */
+typedef struct GCF_Job
+{
+    unsigned long id;
+    int client; /* NET client id */
+    Task task;
+    unsigned long timeout; /* retry time in seconds */
+    char devpath[MAX_DEV_PATH_LENGTH];
+    char fname[MAX_DEV_PATH_LENGTH];
+} GCF_Job;
+#endif
+
 /* The GCF struct holds the complete state as well as GCF file data. */
 typedef struct GCF_t
 {
@@ -146,6 +169,10 @@ typedef struct GCF_t
     U_SStream uiStringStream;
     int uiDebugLevel;
     int uiInteractive;
+    int uiJson; /* --json */
+    int uiJsonResult; /* result line written */
+    PL_time_t uiJsonTime; /* last progress line */
+    state_handler_t uiJsonState; /* last reported state */
 
     int uiInputPos;
     int uiInputSize;
@@ -170,18 +197,86 @@ typedef struct GCF_t
     unsigned char sniffPacket[256];
     unsigned sniffSeqNum;
     S_Udp sniffUdp;
+#ifdef USE_SNIFF
+    PL_time_t sniffGapStart; /* wall clock time of disconnect, 0 if connected */
+    PL_time_t sniffReconnectEnd;
+    const char *sniffRingPrefix;
+    unsigned long sniffRingSeconds;
+    unsigned long sniffRingSize;
+    SNIFF_Ring sniffRing;
+    const char *sniffJsonPath;
+    SNIFF_Json sniffJson;
+    const char *sniffShmName;
+    SNIFF_Shm sniffShm;
+#endif
+
+#ifdef USE_NET
+    unsigned netMaxClients;
+    unsigned long netClientTtl;
+    unsigned short netPort;
+    const char *netInterface; /* -n, 0 for NET_DEFAULT_INTERFACE */
+
+    /* job server */
+    int serve;
+    int jobPercent;       /* last reported progress */
+    unsigned long jobId;  /* last assigned job id */
+    unsigned jobHead;     /* jobs[] queue */
+    unsigned jobCount;
+    GCF_Job *job;         /* running job */
+    GCF_Job jobs[GCF_MAX_JOBS];
+
+    const char *bridgeAddr;
+    int bridgeMode;
+    BRIDGE_State bridge;
+#endif
+
+#ifdef USE_METRICS
+    const char *metricsAddr;
+#endif
+
+    const char *timingPath; /* --timing */
+    TIMING_State timing;
+
+    const char *statusName; /* --status-shm */
+    STATUS_Shm status;
+    STATUS_Info statusInfo;
+    PL_time_t statusTime; /* last update */
+    state_handler_t statusState;
+    char statusLastMsg[STATUS_MAX_ERROR_LENGTH];
+
+    const char *tracePrefix; /* --wire-trace */
+    TRACE_Ring trace;
+
+    state_handler_t probeState; /* last reported to the tracepoints */
+    state_handler_t probeSubstate;
+    const char *probeStateName;
+    PL_time_t probeStateTime;
+    PL_time_t probeSubstateTime;
+
+    REPLAY_Recorder record; /* --record */
+    unsigned eventDepth; /* only events from the platform are recorded */
+
+    INV_State inventory;
+    unsigned inventoryPos; /* next device of devIndex[DEV_KEY_PATH] */
+    int inventoryJson;
 
     PL_time_t startTime;
     PL_time_t maxTime;
 
     unsigned devCount;
-    Device devices[MAX_DEVICES];
+    Device devices[MAX_DEVICES];   /* in enumeration order */
+    unsigned short devIndex[DEV_KEY_COUNT][MAX_DEVICES]; /* sorted by DEV_KEY_* */
+    char devCache[MAX_DEV_CACHE_SIZE];
 
     DeviceType devType;
 
     PL_Baudrate devBaudrate;
     char devpath[MAX_DEV_PATH_LENGTH];
     char devSerialNum[MAX_DEV_SERIALNR_LENGTH];
+    char devAddedPath[MAX_DEV_PATH_LENGTH]; /* of the last EV_DEVICE_ADDED */
+    char resetGpioChip[MAX_DEV_PATH_LENGTH]; /* --reset-gpio, empty for default */
+    unsigned resetGpioLine;
+    unsigned resetFlags; /* RESET_FLAG_* */
     GCF_File file;
 } GCF;
 
@@ -190,8 +285,21 @@ static void gcfScheduleEventAction(GCF *gcf);
 static void gcfRetry(GCF *gcf);
 static void gcfPrintHelp(void);
 static GCF_Status gcfProcessCommandline(GCF *gcf);
+static GCF_Status gcfProcessLongOption(GCF *gcf, int *i);
+static int gcfStrEquals(const char *a, const char *b);
 static void gcfGetDevices(GCF *gcf);
-static void gcfCommandResetUart(void);
+static int gcfMatchDevice(GCF *gcf);
+static int gcfFindDevice(GCF *gcf);
+static int gcfIsAddedDevice(GCF *gcf);
+static int gcfResolveDevice(GCF *gcf);
+static void gcfRefineDeviceType(GCF *gcf);
+static void gcfTaskDone(GCF *gcf, GCF_Status status);
+static void gcfUpdateTiming(GCF *gcf);
+static void gcfUpdateProbes(GCF *gcf);
+static void gcfUpdateStatus(GCF *gcf, int force);
+static void gcfStatusError(GCF *gcf);
+static void gcfTraceDump(GCF *gcf, const char *reason);
+static void gcfCommandResetUart(unsigned char timeout);
 static void gcfCommandQueryStatus(void);
 static void gcfCommandQueryFirmwareVersion(void);
 static void gcfCommandQueryParameter(unsigned char seq, unsigned char id, unsigned char *data, unsigned dataLength);
@@ -220,6 +328,8 @@ static void ST_SniffConfig(GCF *gcf, Event event);
 static void ST_SniffConfigConfirm(GCF *gcf, Event event);
 static void ST_SniffSyncData(GCF *gcf, Event event);
 static void ST_SniffRecvData(GCF *gcf, Event event);
+static void ST_SniffReconnect(GCF *gcf, Event event);
+static void gcfSniffStartReconnect(GCF *gcf);
 static void ST_SniffTeardown(GCF *gcf, Event event);
 
 static void ST_DumpFlashConnect(GCF *gcf, Event event);
@@ -228,13 +338,28 @@ static void ST_DumpFlashSend(GCF *gcf, Event event);
 static void ST_DumpFlashWait(GCF *gcf, Event event);
 
 static void ST_Reset(GCF *gcf, Event event);
+static void ST_ResetProbe(GCF *gcf, Event event);
 static void ST_ResetUart(GCF *gcf, Event event);
 static void ST_ResetFtdi(GCF *gcf, Event event);
 static void ST_ResetRaspBee(GCF *gcf, Event event);
 
 static void ST_ListDevices(GCF *gcf, Event event);
+static void ST_Inventory(GCF *gcf, Event event);
+static void ST_ResetFtdiAll(GCF *gcf, Event event);
+static void gcfInventoryRound(GCF *gcf);
+static void gcfInventoryNext(GCF *gcf);
+
+#ifdef USE_NET
+static void ST_ServeIdle(GCF *gcf, Event event);
+static void gcfJobBegin(GCF *gcf);
+static void gcfJobSetup(GCF *gcf);
+static void gcfJobFinish(GCF *gcf, GCF_Status status);
+static void gcfJobLog(GCF *gcf, const char *str);
+static void gcfNetReply(int client, const char *kind, unsigned long id, const char *text);
+#endif
 
 static UI_Line *UI_NextLine(GCF *gcf);
+static const char *gcfStateName(state_handler_t state);
 U_SStream *UI_StringStream(GCF *gcf);
 void U_sstream_put_u8hex(U_SStream *ss, unsigned char val);
 void U_sstream_put_u32hex(U_SStream *ss, unsigned long val);
@@ -282,12 +407,78 @@ static UI_Line *UI_NextLine(GCF *gcf)
     return line;
 }
 
+/* In --json mode each message becomes a log line without the
+   surrounding line breaks.
+*/
+static void UI_PutsJson(const char *str)
+{
+    unsigned len;
+    U_SStream ss;
+    char msg[UI_MAX_LINE_LENGTH];
+    char buf[UI_MAX_LINE_LENGTH * 2 + 32];
+
+    for (; *str == '\n' || *str == '\r'; str++)
+        ;
+
+    len = U_strlen(str);
+    len = len < sizeof(msg) - 1 ? len : sizeof(msg) - 1;
+
+    for (; len && (str[len - 1] == '\n' || str[len - 1] == '\r'); len--)
+        ;
+
+    if (len == 0)
+        return;
+
+    U_memcpy(&msg[0], str, len);
+    msg[len] = '\0';
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, "{\"event\":\"log\",\"msg\":");
+    U_sstream_put_json_str(&ss, &msg[0]);
+    U_sstream_put_str(&ss, "}\n");
+
+    if (ss.status == U_SSTREAM_OK)
+        PL_Print(ss.str);
+}
+
+/* Keeps \p str without line breaks for the error field of the status block. */
+static void UI_KeepLastMessage(GCF *gcf, const char *str)
+{
+    unsigned len;
+
+    len = U_strlen(str);
+
+    for (; len && (str[len - 1] == '\n' || str[len - 1] == '\r'); len--)
+        ;
+
+    if (len == 0)
+        return;
+
+    for (; *str == '\n' || *str == '\r'; str++, len--)
+        ;
+
+    len = len < sizeof(gcf->statusLastMsg) - 1 ? len : sizeof(gcf->statusLastMsg) - 1;
+    U_memcpy(&gcf->statusLastMsg[0], str, len);
+    gcf->statusLastMsg[len] = '\0';
+}
+
 void UI_Puts(GCF *gcf, const char *str)
 {
-    (void)gcf;
     if (str[0])
     {
-        PL_Print(str);
+        if (gcf->uiJson)
+            UI_PutsJson(str);
+        else
+            PL_Print(str);
+
+        if (gcf->status.block)
+            UI_KeepLastMessage(gcf, str);
+#ifdef USE_NET
+        if (gcf->job)
+            gcfJobLog(gcf, str);
+#else
+        (void)gcf;
+#endif
     }
 }
 
@@ -339,7 +530,51 @@ U_SStream *UI_StringStream(GCF *gcf)
   #define FMT_BLOCK_DONE "\xE2\x96\x93" /* Dark Shade U+2591 */
 #endif
 
-static void UI_UpdateProgress(GCF *gcf)
+#define UI_JSON_PROGRESS_INTERVAL 250 /* ms */
+
+/* --json progress line with the bytes \p done of the current upload,
+   rate-limited to UI_JSON_PROGRESS_INTERVAL except for the last one.
+   The rate includes earlier attempts of the run.
+*/
+static void UI_UpdateProgressJson(GCF *gcf, unsigned long total, unsigned long done)
+{
+    PL_time_t now;
+    PL_time_t elapsed;
+    unsigned long long rate;
+    U_SStream ss;
+    char buf[256];
+
+    now = PL_Time();
+
+    if (done < total && now < gcf->uiJsonTime + UI_JSON_PROGRESS_INTERVAL)
+        return;
+
+    gcf->uiJsonTime = now;
+    elapsed = TIMING_PhaseTime(&gcf->timing, TIMING_PHASE_UPLOAD);
+    rate = elapsed ? (unsigned long long)gcf->timing.uploadBytes * 1000 / elapsed : 0;
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, "{\"event\":\"progress\",\"state\":\"");
+    U_sstream_put_str(&ss, gcfStateName(gcf->state));
+    U_sstream_put_str(&ss, "\",\"done\":");
+    U_sstream_put_ulonglong(&ss, done);
+    U_sstream_put_str(&ss, ",\"total\":");
+    U_sstream_put_ulonglong(&ss, total);
+    U_sstream_put_str(&ss, ",\"bytes_per_sec\":");
+    U_sstream_put_ulonglong(&ss, rate);
+    U_sstream_put_str(&ss, ",\"eta_ms\":");
+    if (rate)
+        U_sstream_put_ulonglong(&ss, (unsigned long long)(total - done) * 1000 / rate);
+    else
+        U_sstream_put_str(&ss, "null");
+    U_sstream_put_str(&ss, ",\"retries\":");
+    U_sstream_put_long(&ss, (long)gcf->timing.retries);
+    U_sstream_put_str(&ss, "}\n");
+
+    PL_Print(ss.str);
+}
+
+static void UI_UpdateProgress(GCF *gcf, unsigned sent)
 {
     long percent;
     int ndone;
@@ -359,14 +594,32 @@ static void UI_UpdateProgress(GCF *gcf)
     if (total == 0)
         return;
 
-    UI_GetWinSize(&w, &h);
-
-    wmax = w - 2 <= 80 ? w : 80; // cap line length
+    gcf->statusInfo.uploadDone = total - gcf->remaining + sent;
+    gcf->statusInfo.uploadTotal = total;
     percent = (total - gcf->remaining) * 100 / total;
 
     if (percent > 95)
         percent = 100;
 
+#ifdef USE_NET
+    if (gcf->job && gcf->jobPercent != (int)percent)
+    {
+        gcf->jobPercent = (int)percent;
+        U_sstream_put_long(&ss, percent);
+        gcfNetReply(gcf->job->client, "progress", gcf->job->id, ss.str);
+        U_sstream_init(&ss, &buf[0], sizeof(buf));
+    }
+#endif
+
+    if (gcf->uiJson)
+    {
+        UI_UpdateProgressJson(gcf, total, total - gcf->remaining + sent);
+        return;
+    }
+
+    UI_GetWinSize(&w, &h);
+    wmax = w - 2 <= 80 ? w : 80; // cap line length
+
     U_sstream_put_str(&ss, "\r ");
 
     /* ' 100 % '   right align percent number */
@@ -394,6 +647,50 @@ static void UI_UpdateProgress(GCF *gcf)
     PL_Print(&buf[0]);
 }
 
+/* --json line for each change of the main state. */
+static void UI_UpdateState(GCF *gcf)
+{
+    U_SStream ss;
+    char buf[128];
+
+    if (!gcf->uiJson || gcf->uiJsonResult || gcf->uiJsonState == gcf->state)
+        return;
+
+    gcf->uiJsonState = gcf->state;
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, "{\"event\":\"state\",\"state\":\"");
+    U_sstream_put_str(&ss, gcfStateName(gcf->state));
+    U_sstream_put_str(&ss, "\",\"retries\":");
+    U_sstream_put_long(&ss, (long)gcf->timing.retries);
+    U_sstream_put_str(&ss, "}\n");
+
+    PL_Print(ss.str);
+}
+
+/* --json final line of the task. */
+static void UI_PutResult(GCF *gcf, GCF_Status status)
+{
+    U_SStream ss;
+    char buf[128];
+
+    if (!gcf->uiJson || gcf->uiJsonResult)
+        return;
+
+    gcf->uiJsonResult = 1;
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, "{\"event\":\"result\",\"status\":\"");
+    U_sstream_put_str(&ss, status == GCF_SUCCESS ? "success" : "failed");
+    U_sstream_put_str(&ss, "\",\"total_ms\":");
+    U_sstream_put_ulonglong(&ss, PL_Time() - gcf->startTime);
+    U_sstream_put_str(&ss, ",\"retries\":");
+    U_sstream_put_long(&ss, (long)gcf->timing.retries);
+    U_sstream_put_str(&ss, "}\n");
+
+    PL_Print(ss.str);
+}
+
 static void ST_Void(GCF *gcf, Event event)
 {
     (void)gcf;
@@ -404,8 +701,16 @@ static void ST_Init(GCF *gcf, Event event)
 {
     if (event == EV_PL_STARTED || event == EV_TIMEOUT)
     {
+#ifdef USE_NET
+        if (gcf->job) /* retry */
+        {
+            gcfJobSetup(gcf);
+            return;
+        }
+#endif
         if (gcfProcessCommandline(gcf) == GCF_FAILED)
         {
+            UI_PutResult(gcf, GCF_FAILED);
             PL_ShutDown();
         }
         else
@@ -420,7 +725,8 @@ static void ST_Reset(GCF *gcf, Event event)
     if (event == EV_ACTION)
     {
         gcf->wp = 0;
-        gcf->substate = ST_ResetUart;
+        gcf->resetFlags = 0;
+        gcf->substate = ST_ResetProbe;
         gcf->substate(gcf, EV_ACTION);
     }
     else if (event == EV_UART_RESET_SUCCESS || event == EV_FTDI_RESET_SUCCESS || event == EV_RASPBEE_RESET_SUCCESS)
@@ -429,7 +735,7 @@ static void ST_Reset(GCF *gcf, Event event)
 
         if (gcf->task == T_RESET)
         {
-            PL_ShutDown();
+            gcfTaskDone(gcf, GCF_SUCCESS);
         }
         else if (gcf->task == T_PROGRAM)
         {
@@ -439,7 +745,11 @@ static void ST_Reset(GCF *gcf, Event event)
     }
     else if (event == EV_UART_RESET_FAILED)
     {
-        if (gcf->devType == DEV_CONBEE_1)
+        if (gcf->resetFlags & RESET_FLAG_GPIO)
+        {
+            /* already tried */
+        }
+        else if (gcf->devType == DEV_CONBEE_1)
         {
             if (PL_Connect(gcf->devpath, gcf->devBaudrate) == GCF_SUCCESS)
             {
@@ -462,6 +772,11 @@ static void ST_Reset(GCF *gcf, Event event)
         PL_SetTimeout(500); /* for connect bootloader */
         GCF_HandleEvent(gcf, EV_UART_RESET_SUCCESS);
     }
+    else if ((event == EV_FTDI_RESET_FAILED || event == EV_RASPBEE_RESET_FAILED) && !(gcf->resetFlags & RESET_FLAG_UART))
+    {
+        gcf->substate = ST_ResetUart;
+        gcf->substate(gcf, EV_ACTION);
+    }
     else if (event == EV_FTDI_RESET_FAILED)
     {
         /* pretent it worked and jump to bootloader detection */
@@ -480,20 +795,131 @@ static void ST_Reset(GCF *gcf, Event event)
     }
 }
 
+/* Picks the fastest reset once the probe is done, GPIO resets don't
+   depend on the firmware and the watchdog is the fallback. */
+static void gcfResetStart(GCF *gcf)
+{
+    gcf->wp = 0;
+
+    if (gcf->devType == DEV_CONBEE_1)
+        gcf->substate = ST_ResetFtdi;
+    else if (gcf->devType == DEV_RASPBEE_1 || gcf->devType == DEV_RASPBEE_2)
+        gcf->substate = ST_ResetRaspBee;
+    else
+        gcf->substate = ST_ResetUart;
+
+    gcf->substate(gcf, EV_ACTION);
+}
+
+/* A running bootloader needs no reset before programming, continue
+   right away. -r always resets the device. */
+static void gcfResetSkip(GCF *gcf, Event event)
+{
+    PL_ClearTimeout();
+
+    if (gcf->task != T_PROGRAM)
+    {
+        gcfResetStart(gcf);
+        return;
+    }
+
+    UI_Puts(gcf, "bootloader detected, skip reset\n");
+    gcf->substate = ST_Void;
+    gcf->retry = 0;
+    PL_SetTimeout(200);
+    gcf->state = ST_BootloaderQuery;
+    GCF_HandleEvent(gcf, event);
+}
+
+static void ST_ResetProbe(GCF *gcf, Event event)
+{
+    U_SStream ss;
+    unsigned char buf[2];
+
+    if (event == EV_ACTION)
+    {
+        if (PL_Connect(gcf->devpath, gcf->devBaudrate) != GCF_SUCCESS)
+        {
+            /* the GPIO reset doesn't need the tty, ST_ResetUart reports and
+               waits for the device if it fails */
+            if (gcf->devType == DEV_RASPBEE_1 || gcf->devType == DEV_RASPBEE_2)
+                gcf->substate = ST_ResetRaspBee;
+            else
+                gcf->substate = ST_ResetUart;
+            gcf->substate(gcf, EV_ACTION);
+            return;
+        }
+
+        gcf->wp = 0;
+        gcf->ascii[0] = '\0';
+
+        if (gcf->file.gcfFileType < 30) /* V1 bootloader answers with text */
+        {
+            buf[0] = 'I';
+            buf[1] = 'D';
+            PROT_Write(buf, sizeof(buf));
+        }
+
+        buf[0] = BTL_MAGIC;
+        buf[1] = BTL_ID_REQUEST;
+        PROT_SendFlagged(buf, sizeof(buf));
+
+        if (gcf->task == T_RESET)
+        {
+            UI_Puts(gcf, "query firmware version\n");
+            gcfCommandQueryFirmwareVersion();
+        }
+        gcfCommandQueryStatus();
+
+        PL_SetTimeout(RESET_PROBE_TIMEOUT);
+    }
+    else if (event == EV_RX_PKG_DATA)
+    {
+        PL_ClearTimeout();
+        gcf->resetFlags |= RESET_FLAG_FIRMWARE;
+        gcfResetStart(gcf);
+    }
+    else if (event == EV_RX_BTL_PKG_DATA)
+    {
+        if ((unsigned char)gcf->ascii[1] == BTL_ID_RESPONSE)
+            gcfResetSkip(gcf, event);
+    }
+    else if (event == EV_RX_ASCII)
+    {
+        U_sstream_init(&ss, &gcf->ascii[0], gcf->wp);
+        if (U_sstream_find(&ss, "Bootloader"))
+            gcfResetSkip(gcf, event);
+    }
+    else if (event == EV_DISCONNECTED)
+    {
+        /* ST_BootloaderConnect connects on EV_DEVICE_ADDED as soon as the
+           device is back, the timeout is the fallback without hotplug events */
+        PL_ClearTimeout();
+        PL_SetTimeout(500);
+        GCF_HandleEvent(gcf, EV_UART_RESET_SUCCESS);
+    }
+    else if (event == EV_TIMEOUT)
+    {
+        UI_Puts(gcf, "no answer to probe\n");
+        gcfResetStart(gcf);
+    }
+}
+
 static void ST_ResetUart(GCF *gcf, Event event)
 {
     if (event == EV_ACTION)
     {
-        PL_SetTimeout(3000);
+        gcf->resetFlags |= RESET_FLAG_UART;
+
+        /* firmware which answered the probe is trusted with a shorter watchdog */
+        if (gcf->resetFlags & RESET_FLAG_FIRMWARE)
+            PL_SetTimeout(1500);
+        else
+            PL_SetTimeout(3000);
 
         if (PL_Connect(gcf->devpath, gcf->devBaudrate) == GCF_SUCCESS)
         {
-            if (gcf->task == T_RESET)
-            {
-                UI_Puts(gcf, "query firmware version\n");
-                gcfCommandQueryFirmwareVersion();
-            }
-            gcfCommandResetUart();
+            gcfCommandResetUart(gcf->resetFlags & RESET_FLAG_FIRMWARE ? 1 : 2);
         }
         else
         {
@@ -539,6 +965,8 @@ static void ST_ResetFtdi(GCF *gcf, Event event)
 {
     if (event == EV_ACTION)
     {
+        gcf->resetFlags |= RESET_FLAG_GPIO;
+
         if (PL_ResetFTDI(0, &gcf->devSerialNum[0]) == 0)
         {
             UI_Puts(gcf, "FTDI reset done\n");
@@ -552,12 +980,71 @@ static void ST_ResetFtdi(GCF *gcf, Event event)
     }
 }
 
+/*! Resets all attached ConBee I in one round of CBUS0 toggles. */
+static void ST_ResetFtdiAll(GCF *gcf, Event event)
+{
+    int ret;
+    unsigned i;
+    unsigned n;
+    Device *dev;
+    U_SStream ss;
+    U_SStream *out;
+    const char *serials[MAX_DEVICES];
+
+    if (event != EV_ACTION)
+        return;
+
+    gcfGetDevices(gcf);
+
+    for (i = 0, n = 0; i < gcf->devCount; i++)
+    {
+        dev = &gcf->devices[gcf->devIndex[DEV_KEY_PATH][i]];
+
+        if (dev->serial[0] == '\0')
+            continue;
+
+        U_sstream_init(&ss, &dev->path[0], U_strlen(&dev->path[0]));
+
+        if (U_sstream_find(&ss, "ttyUSB") || U_sstream_find(&ss, "cu.usbserial"))
+            serials[n++] = &dev->serial[0];
+    }
+
+    if (n == 0)
+    {
+        UI_Puts(gcf, "no ConBee I found\n");
+        gcfTaskDone(gcf, GCF_FAILED);
+        return;
+    }
+
+    ret = PL_ResetFTDIDevices(&serials[0], n);
+
+    out = UI_StringStream(gcf);
+
+    if (ret > 0)
+    {
+        U_sstream_put_str(out, "FTDI reset done for ");
+        U_sstream_put_long(out, (long)ret);
+        U_sstream_put_str(out, " of ");
+        U_sstream_put_long(out, (long)n);
+        U_sstream_put_str(out, " devices\n");
+    }
+    else
+    {
+        U_sstream_put_str(out, "FTDI reset failed\n");
+    }
+
+    UI_Puts(gcf, out->str);
+    gcfTaskDone(gcf, ret == (int)n ? GCF_SUCCESS : GCF_FAILED);
+}
+
 /*! RaspBee reset applies only to RaspBee I & II */
 static void ST_ResetRaspBee(GCF *gcf, Event event)
 {
     if (event == EV_ACTION)
     {
-        if (PL_ResetRaspBee() == 0)
+        gcf->resetFlags |= RESET_FLAG_GPIO;
+
+        if (PL_ResetRaspBee(gcf->resetGpioChip[0] ? &gcf->resetGpioChip[0] : 0, gcf->resetGpioLine) == 0)
         {
             UI_Puts(gcf, "RaspBee reset done\n");
             GCF_HandleEvent(gcf, EV_RASPBEE_RESET_SUCCESS);
@@ -570,41 +1057,380 @@ static void ST_ResetRaspBee(GCF *gcf, Event event)
     }
 }
 
-static void gcfGetDevices(GCF *gcf)
+static const char *gcfDeviceKey(const Device *dev, unsigned key)
 {
-    int i;
-    int n;
-    U_SStream ss;
-    n = PL_GetDevices(&gcf->devices[0], MAX_DEVICES);
-    gcf->devCount = n > 0 ? (unsigned)n : 0;
+    if      (key == DEV_KEY_PATH)   { return &dev->path[0]; }
+    else if (key == DEV_KEY_SERIAL) { return &dev->serial[0]; }
+    else                            { return &dev->stablepath[0]; }
+}
 
-    if (gcf->devpath[0] != '\0' && gcf->devSerialNum[0] == '\0')
-    {
-        U_sstream_init(&ss, &gcf->devpath[0], U_strlen(&gcf->devpath[0]));
+/* Compares embedded numbers by value so that ttyACM2 sorts before ttyACM10. */
+static int gcfCompareNatural(const char *a, const char *b)
+{
+    unsigned i;
+    unsigned la;
+    unsigned lb;
 
-        for (i = 0; i < n; i++)
+    for (;;)
+    {
+        if (*a >= '0' && *a <= '9' && *b >= '0' && *b <= '9')
         {
-            if (gcf->devices[i].serial[0] == '\0')
-                continue;
+            for (la = 0; a[la] >= '0' && a[la] <= '9'; la++)
+                ;
+            for (lb = 0; b[lb] >= '0' && b[lb] <= '9'; lb++)
+                ;
 
-            if (U_sstream_find(&ss, &gcf->devices[i].path[0]) || U_sstream_find(&ss, &gcf->devices[i].stablepath[0]))
-            {
-                U_memcpy(&gcf->devSerialNum[0], &gcf->devices[i].serial[0], MAX_DEV_SERIALNR_LENGTH);
-
-                if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
-                    gcf->devBaudrate = gcf->devices[i].baudrate;
+            if (la != lb)
+                return la < lb ? -1 : 1;
 
-                break;
+            for (i = 0; i < la; i++)
+            {
+                if (a[i] != b[i])
+                    return a[i] < b[i] ? -1 : 1;
             }
+
+            a += la;
+            b += lb;
+            continue;
         }
+
+        if (*a != *b)
+            return (unsigned char)*a < (unsigned char)*b ? -1 : 1;
+
+        if (*a == '\0')
+            return 0;
+
+        a++;
+        b++;
     }
 }
 
-static void ST_ListDevices(GCF *gcf, Event event)
+/* Insertion sort of the index, enumeration returns at most a few hundred
+   devices which are mostly in order already. */
+static void gcfIndexDevices(GCF *gcf)
 {
     unsigned i;
-    Device *dev;
-    U_SStream *ss;
+    unsigned j;
+    unsigned key;
+    unsigned short v;
+    unsigned short *idx;
+
+    for (key = 0; key < DEV_KEY_COUNT; key++)
+    {
+        idx = &gcf->devIndex[key][0];
+
+        for (i = 0; i < gcf->devCount; i++)
+        {
+            v = (unsigned short)i;
+
+            for (j = i; j > 0; j--)
+            {
+                if (gcfCompareNatural(gcfDeviceKey(&gcf->devices[idx[j - 1]], key),
+                                      gcfDeviceKey(&gcf->devices[v], key)) <= 0)
+                    break;
+
+                idx[j] = idx[j - 1];
+            }
+
+            idx[j] = v;
+        }
+    }
+}
+
+/* Binary search of \p value in the \p key index.
+
+   \returns the device or 0 if not found
+*/
+static Device *gcfLookupDevice(GCF *gcf, unsigned key, const char *value)
+{
+    int cmp;
+    unsigned lo;
+    unsigned hi;
+    unsigned mid;
+    Device *dev;
+
+    lo = 0;
+    hi = gcf->devCount;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        dev = &gcf->devices[gcf->devIndex[key][mid]];
+        cmp = gcfCompareNatural(gcfDeviceKey(dev, key), value);
+
+        if      (cmp < 0) { lo = mid + 1; }
+        else if (cmp > 0) { hi = mid; }
+        else              { return dev; }
+    }
+
+    return 0;
+}
+
+/* Device cache
+
+   Keeps the last enumeration on disk so that repeated runs can skip it,
+   one line per device with a serial number:
+
+   <serial> TAB <node id> TAB <baudrate> TAB <path> TAB <stablepath> TAB <name>
+
+   An entry is only used while the device node still has the same node id,
+   otherwise devices are enumerated again and the cache is rewritten.
+*/
+static void gcfSaveDeviceCache(GCF *gcf)
+{
+    unsigned i;
+    unsigned long long id;
+    char path[MAX_DEV_PATH_LENGTH];
+    Device *dev;
+    U_SStream ss;
+
+    if (PL_GetCachePath(DEV_CACHE_NAME, &path[0], sizeof(path)) == 0)
+        return;
+
+    U_sstream_init(&ss, &gcf->devCache[0], sizeof(gcf->devCache));
+    U_sstream_put_str(&ss, DEV_CACHE_HEADER);
+
+    for (i = 0; i < gcf->devCount; i++)
+    {
+        dev = &gcf->devices[gcf->devIndex[DEV_KEY_SERIAL][i]];
+
+        if (dev->serial[0] == '\0' || PL_GetDeviceNodeId(&dev->path[0], &id) == 0)
+            continue;
+
+        U_sstream_put_str(&ss, &dev->serial[0]);
+        U_sstream_put_str(&ss, "\t");
+        U_sstream_put_ulonglong(&ss, id);
+        U_sstream_put_str(&ss, "\t");
+        U_sstream_put_long(&ss, (long)dev->baudrate);
+        U_sstream_put_str(&ss, "\t");
+        U_sstream_put_str(&ss, &dev->path[0]);
+        U_sstream_put_str(&ss, "\t");
+        U_sstream_put_str(&ss, &dev->stablepath[0]);
+        U_sstream_put_str(&ss, "\t");
+        U_sstream_put_str(&ss, &dev->name[0]);
+        U_sstream_put_str(&ss, "\n");
+    }
+
+    if (ss.status != U_SSTREAM_OK)
+    {
+        PL_Printf(DBG_DEBUG, "device cache too large, not saved\n");
+        return;
+    }
+
+    /* many instances may save at the same time, the last one wins */
+    PL_ReplaceFile(&path[0], ss.str, ss.pos);
+}
+
+/* Looks up the device by serial number (DEV_KEY_SERIAL) or by path
+   (DEV_KEY_PATH, matches path and stable path) in the device cache.
+
+   \returns 1 if a valid entry was found, devpath, serial number and
+   baudrate are set accordingly
+*/
+static int gcfLoadCachedDevice(GCF *gcf, unsigned key)
+{
+    int n;
+    unsigned nfields;
+    unsigned long long id;
+    unsigned long long nodeId;
+    char *p;
+    char *fields[6];
+    const char *value;
+    char path[MAX_DEV_PATH_LENGTH];
+    U_SStream ss;
+
+    if (PL_GetCachePath(DEV_CACHE_NAME, &path[0], sizeof(path)) == 0)
+        return 0;
+
+    n = PL_ReadFile(&path[0], (unsigned char*)&gcf->devCache[0], sizeof(gcf->devCache) - 1);
+    if (n <= 0)
+        return 0;
+
+    gcf->devCache[n] = '\0';
+    value = key == DEV_KEY_SERIAL ? &gcf->devSerialNum[0] : &gcf->devpath[0];
+
+    for (p = &gcf->devCache[0]; *p != '\0'; p++)
+    {
+        fields[0] = p;
+        nfields = 1;
+
+        for (; *p != '\n'; p++)
+        {
+            if (*p == '\0')
+                return 0; /* incomplete line */
+
+            if (*p == '\t' && nfields < 6)
+            {
+                *p = '\0';
+                fields[nfields++] = p + 1;
+            }
+        }
+
+        *p = '\0';
+
+        if (nfields != 6)
+            continue;
+
+        if (key == DEV_KEY_SERIAL)
+        {
+            if (!gcfStrEquals(fields[0], value))
+                continue;
+        }
+        else if (!gcfStrEquals(fields[3], value) && !gcfStrEquals(fields[4], value))
+        {
+            continue;
+        }
+
+        for (id = 0; *fields[1] >= '0' && *fields[1] <= '9'; fields[1]++)
+            id = id * 10 + (unsigned long long)(*fields[1] - '0');
+
+        if (PL_GetDeviceNodeId(fields[3], &nodeId) == 0 || nodeId != id)
+            return 0; /* stale */
+
+        if (U_strlen(fields[0]) >= sizeof(gcf->devSerialNum) || U_strlen(fields[3]) >= sizeof(gcf->devpath))
+            return 0;
+
+        U_memcpy(&gcf->devSerialNum[0], fields[0], U_strlen(fields[0]) + 1);
+        U_memcpy(&gcf->devpath[0], fields[3], U_strlen(fields[3]) + 1);
+
+        if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
+        {
+            U_sstream_init(&ss, fields[2], U_strlen(fields[2]));
+            gcf->devBaudrate = (PL_Baudrate)U_sstream_get_long(&ss);
+        }
+
+        PL_Printf(DBG_DEBUG, "device cache: %s %s\n", gcf->devSerialNum, gcf->devpath);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void gcfGetDevices(GCF *gcf)
+{
+    int n;
+    n = PL_GetDevices(&gcf->devices[0], MAX_DEVICES);
+    gcf->devCount = n > 0 ? (unsigned)n : 0;
+
+    gcfIndexDevices(gcf);
+    gcfSaveDeviceCache(gcf);
+    gcfMatchDevice(gcf);
+}
+
+/* Looks up devpath in the enumerated devices to get serial number and baudrate.
+
+   \returns 1 if the device was found
+*/
+static int gcfMatchDevice(GCF *gcf)
+{
+    Device *dev;
+
+    if (gcf->devpath[0] != '\0' && gcf->devSerialNum[0] == '\0')
+    {
+        dev = gcfLookupDevice(gcf, DEV_KEY_PATH, &gcf->devpath[0]);
+        if (!dev)
+            dev = gcfLookupDevice(gcf, DEV_KEY_STABLEPATH, &gcf->devpath[0]);
+
+        if (dev && dev->serial[0] != '\0')
+        {
+            U_memcpy(&gcf->devSerialNum[0], &dev->serial[0], MAX_DEV_SERIALNR_LENGTH);
+
+            if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
+                gcf->devBaudrate = dev->baudrate;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Re-enumerates and looks up the device by serial number, the path may
+   change when the device reappears on USB.
+
+   \returns 1 if the device was found or the serial number isn't known
+*/
+static int gcfFindDevice(GCF *gcf)
+{
+    Device *dev;
+
+    if (gcf->devSerialNum[0] == '\0')
+        return 1;
+
+    gcfGetDevices(gcf);
+
+    dev = gcfLookupDevice(gcf, DEV_KEY_SERIAL, &gcf->devSerialNum[0]);
+    if (!dev)
+        return 0;
+
+    U_memcpy(&gcf->devpath[0], &dev->path[0], sizeof(gcf->devpath));
+
+    if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
+        gcf->devBaudrate = dev->baudrate;
+
+    return 1;
+}
+
+/* Checks if the device of EV_DEVICE_ADDED is the -d device. A device with
+   known serial number is looked up again, it might have a new path.
+*/
+static int gcfIsAddedDevice(GCF *gcf)
+{
+    unsigned long long id;
+    unsigned long long addedId;
+
+    if (gcf->devSerialNum[0] != '\0' && gcfFindDevice(gcf) == 0)
+        return 0;
+
+    if (gcfStrEquals(&gcf->devAddedPath[0], &gcf->devpath[0]))
+        return 1;
+
+    /* -d might be a symlink like /dev/serial/by-id/... */
+    if (PL_GetDeviceNodeId(&gcf->devpath[0], &id) && PL_GetDeviceNodeId(&gcf->devAddedPath[0], &addedId))
+        return id == addedId;
+
+    return 0;
+}
+
+/* Fills in serial number and baudrate of the -d device, on retries the
+   previous enumeration is used as long as the path still matches and
+   otherwise the device cache is tried before enumerating.
+   A "serial:<SN>" device is resolved to its current path.
+
+   \returns 0 if a serial number device isn't present
+*/
+static int gcfResolveDevice(GCF *gcf)
+{
+    unsigned len;
+    U_SStream ss;
+
+    U_sstream_init(&ss, &gcf->devpath[0], U_strlen(&gcf->devpath[0]));
+
+    if (U_sstream_starts_with(&ss, "serial:"))
+    {
+        len = U_strlen(&gcf->devpath[7]);
+        if (len == 0 || len >= sizeof(gcf->devSerialNum))
+            return 0;
+
+        U_memcpy(&gcf->devSerialNum[0], &gcf->devpath[7], len + 1);
+
+        if (gcfLoadCachedDevice(gcf, DEV_KEY_SERIAL))
+            return 1;
+
+        return gcfFindDevice(gcf);
+    }
+
+    if (gcfMatchDevice(gcf) == 0 && gcfLoadCachedDevice(gcf, DEV_KEY_PATH) == 0)
+        gcfGetDevices(gcf);
+
+    return 1;
+}
+
+static void ST_ListDevices(GCF *gcf, Event event)
+{
+    unsigned i;
+    Device *dev;
+    U_SStream *ss;
 
     if (event == EV_ACTION)
     {
@@ -620,7 +1446,7 @@ static void ST_ListDevices(GCF *gcf, Event event)
 
         for (i = 0; i < gcf->devCount; i++)
         {
-            dev = &gcf->devices[i];
+            dev = &gcf->devices[gcf->devIndex[DEV_KEY_PATH][i]];
             ss = UI_StringStream(gcf);
 
             /* 1st column */
@@ -646,15 +1472,179 @@ static void ST_ListDevices(GCF *gcf, Event event)
             UI_Puts(gcf, ss->str);
         }
 
-        PL_ShutDown();
+        gcfTaskDone(gcf, GCF_SUCCESS);
     }
 }
 
-static void ST_Program(GCF *gcf, Event event)
+static void gcfInventoryPrint(GCF *gcf, const INV_Device *d)
+{
+    U_SStream *ss;
+    const char *status;
+    const char *platform;
+
+    ss = UI_StringStream(gcf);
+
+    if      (d->status == INV_STATUS_FIRMWARE)    { status = "firmware"; }
+    else if (d->status == INV_STATUS_BOOTLOADER)  { status = "bootloader"; }
+    else if (d->status == INV_STATUS_OPEN_FAILED) { status = "open failed"; }
+    else                                          { status = "no response"; }
+
+    platform = "";
+    if (d->status == INV_STATUS_FIRMWARE)
+    {
+        if      ((d->fwVersion & FW_VERSION_PLATFORM_MASK) == FW_VERSION_PLATFORM_R21) { platform = "R21"; }
+        else if ((d->fwVersion & FW_VERSION_PLATFORM_MASK) == FW_VERSION_PLATFORM_AVR) { platform = "AVR"; }
+        else                                                                          { platform = "unknown"; }
+    }
+
+    if (gcf->inventoryJson)
+    {
+        U_sstream_put_str(ss, "{\"path\":");
+        U_sstream_put_json_str(ss, d->dev->path);
+        U_sstream_put_str(ss, ",\"serial\":");
+        U_sstream_put_json_str(ss, d->dev->serial);
+        U_sstream_put_str(ss, ",\"status\":\"");
+        U_sstream_put_str(ss, status);
+        U_sstream_put_str(ss, "\",\"firmware\":");
+
+        if (d->status == INV_STATUS_FIRMWARE)
+        {
+            U_sstream_put_str(ss, "\"0x");
+            U_sstream_put_u32hex(ss, d->fwVersion);
+            U_sstream_put_str(ss, "\",\"platform\":\"");
+            U_sstream_put_str(ss, platform);
+            U_sstream_put_str(ss, "\"");
+        }
+        else
+        {
+            U_sstream_put_str(ss, "null,\"platform\":null");
+        }
+
+        U_sstream_put_str(ss, ",\"bootloader\":");
+        if (d->status == INV_STATUS_BOOTLOADER)
+        {
+            U_sstream_put_str(ss, "\"0x");
+            U_sstream_put_u32hex(ss, d->btlVersion);
+            U_sstream_put_str(ss, "\",\"app_crc\":\"0x");
+            U_sstream_put_u32hex(ss, d->appCrc);
+            U_sstream_put_str(ss, "\"}\n");
+        }
+        else
+        {
+            U_sstream_put_str(ss, "null,\"app_crc\":null}\n");
+        }
+
+        UI_Puts(gcf, ss->str);
+        return;
+    }
+
+    U_sstream_put_str(ss, d->dev->path);
+    for (;ss->pos < 18;)
+        U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, "| ");
+
+    U_sstream_put_str(ss, d->dev->serial);
+    for (;ss->pos < 32;)
+        U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, "| ");
+
+    if (d->status == INV_STATUS_FIRMWARE)
+    {
+        U_sstream_put_str(ss, "0x");
+        U_sstream_put_u32hex(ss, d->fwVersion);
+    }
+    else if (d->status != INV_STATUS_BOOTLOADER)
+    {
+        U_sstream_put_str(ss, status);
+    }
+    for (;ss->pos < 47;)
+        U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, "| ");
+
+    U_sstream_put_str(ss, platform);
+    for (;ss->pos < 58;)
+        U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, "| ");
+
+    if (d->status == INV_STATUS_BOOTLOADER)
+    {
+        U_sstream_put_str(ss, "0x");
+        U_sstream_put_u32hex(ss, d->btlVersion);
+    }
+    U_sstream_put_str(ss, "\n");
+
+    UI_Puts(gcf, ss->str);
+}
+
+/* Queries the next batch of devices, all ports of a batch are open at the
+   same time so that a round takes at most INV_TIMEOUT. */
+static void gcfInventoryRound(GCF *gcf)
+{
+    Device *dev;
+
+    INV_Reset(&gcf->inventory);
+
+    for (; gcf->inventoryPos < gcf->devCount; gcf->inventoryPos++)
+    {
+        dev = &gcf->devices[gcf->devIndex[DEV_KEY_PATH][gcf->inventoryPos]];
+        if (INV_Query(&gcf->inventory, dev) == 0)
+            break;
+    }
+
+    if (INV_Done(&gcf->inventory))
+        gcfInventoryNext(gcf);
+    else
+        PL_SetTimeout(INV_TIMEOUT);
+}
+
+static void gcfInventoryNext(GCF *gcf)
+{
+    unsigned i;
+
+    PL_ClearTimeout();
+    INV_End(&gcf->inventory);
+
+    for (i = 0; i < gcf->inventory.count; i++)
+        gcfInventoryPrint(gcf, &gcf->inventory.devices[i]);
+
+    gcf->inventory.count = 0;
+
+    if (gcf->inventoryPos < gcf->devCount)
+        gcfInventoryRound(gcf);
+    else
+        gcfTaskDone(gcf, GCF_SUCCESS);
+}
+
+static void ST_Inventory(GCF *gcf, Event event)
 {
     if (event == EV_ACTION)
     {
         gcfGetDevices(gcf);
+        gcf->inventoryPos = 0;
+
+        if (gcf->devCount == 0 && !gcf->inventoryJson)
+        {
+            UI_Puts(gcf, "no devices found\n");
+        }
+
+        if (!gcf->inventoryJson)
+        {
+            UI_Puts(gcf, "Path              | Serial      | Firmware     | Platform | Bootloader\n");
+            UI_Puts(gcf, "------------------+-------------+--------------+----------+-----------\n");
+        }
+
+        gcfInventoryRound(gcf);
+    }
+    else if (event == EV_TIMEOUT)
+    {
+        gcfInventoryNext(gcf);
+    }
+}
+
+static void ST_Program(GCF *gcf, Event event)
+{
+    if (event == EV_ACTION)
+    {
         UI_Puts(gcf, "flash firmware\n");
         gcf->state = ST_Reset;
         GCF_HandleEvent(gcf, event);
@@ -674,7 +1664,7 @@ static void ST_Program(GCF *gcf, Event event)
     }
     else if (event == EV_RESET_FAILED)
     {
-        PL_ShutDown();
+        gcfTaskDone(gcf, GCF_FAILED);
     }
 }
 
@@ -699,6 +1689,22 @@ static void ST_BootloaderConnect(GCF *gcf, Event event)
             UI_Puts(gcf, ss->str);
         }
     }
+    else if (event == EV_DEVICE_ADDED && gcfIsAddedDevice(gcf))
+    {
+        /* connect as soon as the device reappeared, the timeout remains
+           for devices which don't re-enumerate */
+        if (PL_Connect(gcf->devpath, gcf->devBaudrate) == GCF_SUCCESS)
+        {
+            gcf->state = ST_BootloaderQuery;
+            GCF_HandleEvent(gcf, EV_ACTION);
+            /* the bootloader is running once the device reappeared on USB */
+            ST_BootloaderQuery(gcf, EV_TIMEOUT);
+        }
+        else
+        {
+            PL_SetTimeout(100); /* udev might not have applied permissions yet */
+        }
+    }
     else if (event == EV_RX_ASCII)
     {
         /* short cut if we are already in bootloader */
@@ -910,13 +1916,14 @@ static void ST_V1ProgramUpload(GCF *gcf, Event event)
 
         if (pageNumber % 20 == 0 || gcf->remaining < V1_PAGESIZE)
         {
-            UI_UpdateProgress(gcf);
+            UI_UpdateProgress(gcf, size);
         }
 
         gcf->wp = 0;
         gcf->ascii[0] = '\0';
 
         PROT_Write(page, size);
+        gcf->timing.uploadBytes += size;
 
         if ((gcf->remaining - size) == 0)
         {
@@ -946,7 +1953,7 @@ static void ST_V1ProgramValidate(GCF *gcf, Event event)
         if (gcf->wp > 6 && U_sstream_find(&ss, "#VALID CRC"))
         {
             UI_Puts(gcf, FMT_GREEN "firmware successful written\n" FMT_RESET);
-            PL_ShutDown();
+            gcfTaskDone(gcf, GCF_SUCCESS);
         }
         else
         {
@@ -1071,6 +2078,7 @@ static void ST_V3ProgramUpload(GCF *gcf, Event event)
                 Assert(length > 0);
                 U_memcpy(p, &gcf->file.fcontent[gcf->file.dataOffset + offset], length);
                 p += length;
+                gcf->timing.uploadBytes += length;
             }
             else
             {
@@ -1086,7 +2094,7 @@ static void ST_V3ProgramUpload(GCF *gcf, Event event)
 
             PROT_SendFlagged(buf, (unsigned)(p - buf));
 
-            UI_UpdateProgress(gcf);
+            UI_UpdateProgress(gcf, status == 0 ? length : 0);
 
             if (gcf->remaining == length)
             {
@@ -1115,9 +2123,11 @@ static void ST_V3ProgramWaitID(GCF *gcf, Event event)
         {
             unsigned long btlVersion;
             unsigned long appCrc;
+            GCF_Status status;
 
             get_u32_le((unsigned char*)&gcf->ascii[2], &btlVersion);
             get_u32_le((unsigned char*)&gcf->ascii[6], &appCrc);
+            status = GCF_SUCCESS;
 
             if (gcf->file.gcfCrc32 != 0)
             {
@@ -1130,6 +2140,7 @@ static void ST_V3ProgramWaitID(GCF *gcf, Event event)
                 }
                 else
                 {
+                    status = GCF_FAILED;
                     U_sstream_put_str(ss, " (expected 0x");
                     U_sstream_put_u32hex(ss, gcf->file.gcfCrc32);
                     U_sstream_put_str(ss, ")");
@@ -1139,7 +2150,7 @@ static void ST_V3ProgramWaitID(GCF *gcf, Event event)
             }
 
             UI_Puts(gcf, "finished\n");
-            PL_ShutDown();
+            gcfTaskDone(gcf, status);
         }
     }
     else if (event == EV_TIMEOUT)
@@ -1170,6 +2181,11 @@ static void ST_Connected(GCF *gcf, Event event)
 {
     if (event == EV_TIMEOUT)
     {
+#ifdef USE_NET
+        /* the bridge client owns the protocol, don't inject requests */
+        if (gcf->bridgeAddr)
+            return;
+#endif
         if (gcf->uiInteractive == 0)
         {
             gcfCommandQueryStatus();
@@ -1179,6 +2195,7 @@ static void ST_Connected(GCF *gcf, Event event)
     }
     else if (event == EV_DISCONNECTED)
     {
+        METRICS_Add(METRICS_RECONNECTS, 1);
         PL_ClearTimeout();
         gcf->state = ST_Init;
         UI_Puts(gcf, "disconnected\n");
@@ -1232,6 +2249,10 @@ static void ST_SniffConfig(GCF *gcf, Event event)
         gcf->state = ST_SniffConfigConfirm;
         PL_SetTimeout(1000);
     }
+    else if (event == EV_DISCONNECTED && gcf->sniffGapStart != 0)
+    {
+        gcfSniffStartReconnect(gcf);
+    }
     else if (event == EV_DISCONNECTED)
     {
         PL_ClearTimeout();
@@ -1243,6 +2264,8 @@ static void ST_SniffConfig(GCF *gcf, Event event)
 static void ST_SniffConfigConfirm(GCF *gcf, Event event)
 {
     U_SStream ss;
+    U_SStream *ss1;
+    PL_time_t gap;
 
     if (event == EV_RX_ASCII)
     {
@@ -1254,19 +2277,44 @@ static void ST_SniffConfigConfirm(GCF *gcf, Event event)
             gcf->state = ST_SniffSyncData;
             gcf->sniffWp = 0;
             gcf->sniffLength = 0;
-            UI_Puts(gcf, "sniffing started, send traffic to host ");
-            UI_Puts(gcf, gcf->sniffHost);
-            UI_Puts(gcf, " port 17754\n");
+
+            if (gcf->sniffGapStart != 0)
+            {
+                gap = PL_WallTime() - gcf->sniffGapStart;
+                SNIFF_JsonGap(&gcf->sniffJson, gcf->sniffGapStart, gap);
+                gcf->sniffGapStart = 0;
+
+                ss1 = UI_StringStream(gcf);
+                U_sstream_put_str(ss1, "sniffing resumed after ");
+                U_sstream_put_ulonglong(ss1, gap);
+                U_sstream_put_str(ss1, " ms gap\n");
+                UI_Puts(gcf, ss1->str);
+            }
+            else
+            {
+                UI_Puts(gcf, "sniffing started, send traffic to host ");
+                UI_Puts(gcf, gcf->sniffHost);
+                UI_Puts(gcf, " port 17754\n");
+            }
+
             PL_SetTimeout(3600000);
             gcf->wp = 0;
             gcf->rp = 0;
         }
     }
+    else if (event == EV_TIMEOUT && gcf->sniffGapStart != 0)
+    {
+        PL_Disconnect(); /* continues in ST_SniffReconnect */
+    }
     else if (event == EV_TIMEOUT)
     {
         gcf->state = ST_SniffTeardown;
         PL_SetTimeout(1000);
     }
+    else if (event == EV_DISCONNECTED && gcf->sniffGapStart != 0)
+    {
+        gcfSniffStartReconnect(gcf);
+    }
     else if (event == EV_DISCONNECTED)
     {
         PL_ClearTimeout();
@@ -1334,9 +2382,7 @@ static void ST_SniffSyncData(GCF *gcf, Event event)
     }
     else if (event == EV_DISCONNECTED)
     {
-        PL_ClearTimeout();
-        gcf->state = ST_SniffTeardown;
-        PL_SetTimeout(1000);
+        gcfSniffStartReconnect(gcf);
     }
 }
 
@@ -1346,6 +2392,7 @@ static void ST_SniffRecvData(GCF *gcf, Event event)
     unsigned char type;
     U_SStream *ss;
     U_BStream bs;
+    SNIFF_Frame frame;
     char buf[256];
 
     if (event == EV_RX_ASCII)
@@ -1455,7 +2502,20 @@ static void ST_SniffRecvData(GCF *gcf, Event event)
                         U_bstream_put_u8(&bs, gcf->sniffPacket[i]); /* data */
                 }
 
-                SOCK_UdpSend(&gcf->sniffUdp, bs.data, bs.pos);
+                if (SOCK_UdpSend(&gcf->sniffUdp, bs.data, bs.pos) < 0)
+                    METRICS_Add(METRICS_UDP_FAILED, 1);
+                else
+                    METRICS_Add(METRICS_UDP_SENT, 1);
+
+                METRICS_Add(METRICS_FRAMES, 1);
+
+                frame.timestamp = PL_WallTime();
+                frame.channel = (unsigned)gcf->sniffChannel;
+                frame.length = gcf->sniffLength - 8;
+                frame.data = &gcf->sniffPacket[8];
+                SNIFF_RingPush(&gcf->sniffRing, &frame);
+                SNIFF_JsonPush(&gcf->sniffJson, &frame);
+                SNIFF_ShmPush(&gcf->sniffShm, &frame);
             }
 
             gcf->sniffWp = 0;
@@ -1470,9 +2530,59 @@ static void ST_SniffRecvData(GCF *gcf, Event event)
     }
     else if (event == EV_DISCONNECTED)
     {
-        PL_ClearTimeout();
+        gcfSniffStartReconnect(gcf);
+    }
+}
+
+/* Fast path after a disconnect while sniffing.
+
+   The UDP socket and sinks are kept, the device is looked up by its
+   serial number (the path may change) and reconfigured as soon as it
+   reappears. After SNIFF_RECONNECT_TIMEOUT the full teardown is done.
+*/
+static void gcfSniffStartReconnect(GCF *gcf)
+{
+    PL_ClearTimeout();
+
+    if (gcf->sniffGapStart == 0)
+    {
+        gcf->sniffGapStart = PL_WallTime();
+        gcf->sniffReconnectEnd = PL_Time() + SNIFF_RECONNECT_TIMEOUT;
+        UI_Puts(gcf, "sniffer disconnected, waiting for device\n");
+        METRICS_Add(METRICS_RECONNECTS, 1);
+    }
+
+    gcf->state = ST_SniffReconnect;
+    PL_SetTimeout(SNIFF_RECONNECT_INTERVAL);
+}
+
+static void ST_SniffReconnect(GCF *gcf, Event event)
+{
+    int found;
+
+    if (event == EV_DEVICE_ADDED && !gcfIsAddedDevice(gcf))
+        return;
+
+    if (event != EV_TIMEOUT && event != EV_DEVICE_ADDED)
+        return;
+
+    found = gcfFindDevice(gcf);
+
+    if (found && PL_Connect(gcf->devpath, gcf->devBaudrate) == GCF_SUCCESS)
+    {
+        gcf->state = ST_SniffConfig;
+        gcf->state(gcf, EV_TIMEOUT); /* configure right away */
+    }
+    else if (gcf->sniffReconnectEnd < PL_Time())
+    {
+        UI_Puts(gcf, "device didn't come back\n");
+        gcf->sniffGapStart = 0;
         gcf->state = ST_SniffTeardown;
-        PL_SetTimeout(1000);
+        gcf->state(gcf, EV_ACTION);
+    }
+    else
+    {
+        PL_SetTimeout(SNIFF_RECONNECT_INTERVAL);
     }
 }
 
@@ -1480,6 +2590,7 @@ static void ST_SniffTeardown(GCF *gcf, Event event)
 {
     (void)event;
 
+    gcf->sniffGapStart = 0;
     SOCK_UdpFree(&gcf->sniffUdp);
     PL_ClearTimeout();
     gcf->state = ST_Init;
@@ -1503,7 +2614,7 @@ static void ST_DumpFlashConnect(GCF *gcf, Event event)
         else
         {
             UI_Puts(gcf, "failed to connect\n");
-            PL_ShutDown();
+            gcfTaskDone(gcf, GCF_FAILED);
         }
     }
 }
@@ -1542,14 +2653,14 @@ static void ST_DumpFlashQueryFirmwareVersion(GCF *gcf, Event event)
             else
             {
                 UI_Puts(gcf, "dump flash currently only supported on ConBee II and RaspBee II\n");
-                PL_ShutDown();
+                gcfTaskDone(gcf, GCF_FAILED);
             }
         }
     }
     else if (event == EV_TIMEOUT)
     {
         UI_Puts(gcf, "failed to query firmware version\n");
-        PL_ShutDown();
+        gcfTaskDone(gcf, GCF_FAILED);
     }
 }
 
@@ -1559,7 +2670,7 @@ static void ST_DumpFlashSend(GCF *gcf, Event event)
     {
         if (gcf->flashAddress == gcf->flashSize)
         {
-            PL_ShutDown();
+            gcfTaskDone(gcf, GCF_SUCCESS);
             return;
         }
 
@@ -1639,25 +2750,31 @@ static void ST_DumpFlashWait(GCF *gcf, Event event)
                 U_sstream_put_u8hex(ss, status);
                 U_sstream_put_str(ss, "\n");
                 UI_Puts(gcf, ss->str);
-                PL_ShutDown();
+                gcfTaskDone(gcf, GCF_FAILED);
             }
         }
     }
     else if (event == EV_TIMEOUT)
     {
         UI_Puts(gcf, "timeout reading flash");
-        PL_ShutDown();
+        gcfTaskDone(gcf, GCF_FAILED);
     }
 }
 
 GCF *GCF_Init(int argc, char *argv[])
 {
+    int i;
+    int replayRealtime;
+    const char *recordPath;
+    const char *replayPath;
     GCF *gcf;
 
     gcf = &gcfLocal;
+    replayRealtime = 0;
+    recordPath = 0;
+    replayPath = 0;
 
     U_bzero(&gcf->rxstate, sizeof(gcf->rxstate));
-    gcf->startTime = PL_Time();
     gcf->maxTime = 0;
     gcf->sniffChannel = 0;
     gcf->sniffHost = "127.0.0.1";
@@ -1668,6 +2785,10 @@ GCF *GCF_Init(int argc, char *argv[])
     gcf->uiInputPos = 0;
     gcf->uiInputSize = 0;
     gcf->uiInputLine[0] = '\0';
+    gcf->uiJson = 0;
+    gcf->uiJsonResult = 0;
+    gcf->uiJsonTime = 0;
+    gcf->uiJsonState = ST_Init;
     gcf->state = ST_Init;
     gcf->substate = ST_Void;
     gcf->argc = argc;
@@ -1676,35 +2797,122 @@ GCF *GCF_Init(int argc, char *argv[])
     gcf->ascii[0] = '\0';
     gcf->evAction = 0;
 
+    gcf->eventDepth = 0;
+
+    /* needed before the first output of gcfProcessCommandline(), the
+       recording and replay also cover EV_PL_STARTED */
+    for (i = 1; i < argc; i++)
+    {
+        if (gcfStrEquals(argv[i], "--json"))
+            gcf->uiJson = 1;
+        else if (gcfStrEquals(argv[i], "--replay-realtime"))
+            replayRealtime = 1;
+        else if (i + 1 == argc)
+            break;
+        else if (gcfStrEquals(argv[i], "--record"))
+            recordPath = argv[++i];
+        else if (gcfStrEquals(argv[i], "--replay"))
+            replayPath = argv[++i];
+    }
+
+    /* stdout only carries JSON lines */
+    if (gcf->uiJson)
+        PL_SetPrintStderr(1);
+
+    if (replayPath && PL_StartReplay(replayPath, replayRealtime) == 0)
+    {
+        PL_Printf(DBG_INFO, "failed to replay %s\n", replayPath);
+        return 0;
+    }
+
+    gcf->startTime = PL_Time(); /* replay time starts with PL_StartReplay() */
+    gcf->probeState = ST_Init;
+    gcf->probeSubstate = ST_Void;
+    gcf->probeStateName = gcfStateName(ST_Init);
+    gcf->probeStateTime = gcf->startTime;
+    gcf->probeSubstateTime = gcf->startTime;
+
+    if (recordPath && REPLAY_RecordInit(&gcf->record, recordPath) == 0)
+    {
+        PL_Printf(DBG_INFO, "failed to create recording %s\n", recordPath);
+        return 0;
+    }
+
     return gcf;
 }
 
 void GCF_Exit(GCF *gcf)
 {
-    (void)gcf;
+#ifdef USE_SNIFF
+    SNIFF_RingExit(&gcf->sniffRing);
+    SNIFF_JsonExit(&gcf->sniffJson);
+    SNIFF_ShmExit(&gcf->sniffShm);
+#endif
+#ifdef USE_NET
+    BRIDGE_Exit(&gcf->bridge);
+#endif
+    INV_End(&gcf->inventory);
+    METRICS_Exit();
+
+    if (gcf->timingPath) /* interrupted run */
+        TIMING_Write(&gcf->timing, gcf->timingPath, GCF_FAILED, gcf->devpath, gcf->file.fname);
+
+    UI_PutResult(gcf, GCF_FAILED); /* no-op if the task was done */
+
+    if (gcf->status.block)
+    {
+        if (gcf->statusInfo.result == STATUS_RESULT_RUNNING) /* interrupted */
+        {
+            gcfStatusError(gcf);
+            gcf->statusInfo.result = STATUS_RESULT_FAILED;
+        }
+
+        gcfUpdateStatus(gcf, 1);
+        STATUS_Exit(&gcf->status);
+    }
+
+    gcfTraceDump(gcf, "exit");
+    REPLAY_RecordExit(&gcf->record);
 }
 
-void GCF_HandleEvent(GCF *gcf, Event event)
+static void gcfHandleEvent(GCF *gcf, Event event)
 {
-#if 0
-    const char *str;
-
-    if      (gcf->substate == ST_ResetFtdi) str = "ST_ResetFtdi";
-    else if (gcf->substate == ST_ResetUart) str = "ST_ResetUart";
-    else if (gcf->state == ST_Reset) str = "ST_Reset";
-    else if (gcf->state == ST_Program) str = "ST_Program";
-    else if (gcf->state == ST_V1ProgramSync) str = "ST_V1ProgramSync";
-    else if (gcf->state == ST_V1ProgramUpload) str = "ST_V1ProgramUpload";
-    else if (gcf->state == ST_V1ProgramValidate) str = "ST_V1ProgramValidate";
-    else if (gcf->state == ST_V1ProgramWriteHeader) str = "ST_V1ProgramWriteHeader";
-    else if (gcf->state == ST_Connect) str = "ST_Connect";
-    else if (gcf->state == ST_BootloaderQuery) str = "ST_BootloaderQuery";
-    else if (gcf->state == ST_BootloaderConnect) str = "ST_BootloaderConnect";
-    else                               str = "(unknown)";
-
-    PL_Printf(DBG_DEBUG, "GCF_HandleEvent: state: %s, event: %d\n", str, (int)event);
+    if (event == EV_INPUT_CLOSED)
+    {
+#ifdef USE_NET
+        if (gcf->serve)
+            return; /* keep running without terminal */
+#endif
+        PL_ShutDown();
+        return;
+    }
+
+    if (event == EV_TRIGGER)
+    {
+#ifdef USE_SNIFF
+        SNIFF_RingTrigger(&gcf->sniffRing, "signal");
+#endif
+        gcfTraceDump(gcf, "signal");
+        return;
+    }
+
+#ifdef USE_SNIFF
+    if (event == EV_PL_LOOP)
+    {
+        if (gcf->sniffRing.file)
+            SNIFF_RingStep(&gcf->sniffRing, PL_Time());
+
+        if (gcf->sniffJson.pos)
+            SNIFF_JsonStep(&gcf->sniffJson, PL_Time());
+    }
 #endif
 
+    if (event == EV_PL_LOOP && gcf->status.block)
+        gcfUpdateStatus(gcf, 0);
+
+    if (event == EV_PL_LOOP && gcf->record.file)
+        REPLAY_RecordStep(&gcf->record, PL_Time());
+
     if (event == EV_PL_LOOP && gcf->state == ST_SniffSyncData)
     {
         /* allowed to process loop */
@@ -1714,15 +2922,146 @@ void GCF_HandleEvent(GCF *gcf, Event event)
         if (gcf->evAction)
         {
             gcf->evAction = 0;
+            PROBE_EVENT(gcf->probeStateName, (int)EV_ACTION);
             gcf->state(gcf, EV_ACTION);
+            gcfUpdateTiming(gcf);
+            gcfUpdateProbes(gcf);
+            UI_UpdateState(gcf);
         }
 
-        NET_Step();
         return;
     }
 
+    if (event == EV_TIMEOUT)
+        PROBE_TIMEOUT(gcf->probeStateName);
+
+    PROBE_EVENT(gcf->probeStateName, (int)event);
     gcf->state(gcf, event);
+    gcfUpdateTiming(gcf);
+    gcfUpdateProbes(gcf);
+    UI_UpdateState(gcf);
+}
+
+void GCF_HandleEvent(GCF *gcf, Event event)
+{
+    /* idle loop events are only recorded when they are processed */
+    if (gcf->eventDepth == 0 && gcf->record.file &&
+        (event != EV_PL_LOOP || gcf->evAction || gcf->state == ST_SniffSyncData))
+        REPLAY_RecordEvent(&gcf->record, event);
+
+    gcf->eventDepth++;
+    gcfHandleEvent(gcf, event);
+    gcf->eventDepth--;
+}
+
+void GCF_DeviceAdded(GCF *gcf, const char *path)
+{
+    unsigned len;
+
+    len = U_strlen(path);
+    len = len < sizeof(gcf->devAddedPath) - 1 ? len : sizeof(gcf->devAddedPath) - 1;
+    U_memcpy(&gcf->devAddedPath[0], path, len);
+    gcf->devAddedPath[len] = '\0';
+
+    if (gcf->eventDepth == 0 && gcf->record.file)
+        REPLAY_RecordDeviceAdded(&gcf->record, &gcf->devAddedPath[0]);
+
+    gcf->eventDepth++;
+    gcfHandleEvent(gcf, EV_DEVICE_ADDED);
+    gcf->eventDepth--;
+}
+
+void GCF_HandleReadable(GCF *gcf, PL_Handle handle)
+{
+    if (METRICS_Readable(handle))
+        return;
+
+    if (INV_Readable(&gcf->inventory, handle))
+    {
+        if (gcf->state == ST_Inventory && INV_Done(&gcf->inventory))
+            gcfInventoryNext(gcf);
+        return;
+    }
+
+#ifdef USE_NET
+    if (BRIDGE_Readable(&gcf->bridge, handle))
+        return;
+#else
+    (void)gcf;
+    (void)handle;
+#endif
+
+    NET_Step();
+}
+
+#define GCF_STATE_NAME(st) { st, #st }
+
+static const struct
+{
+    state_handler_t state;
+    const char *name;
+} gcfStateNames[] =
+{
+    GCF_STATE_NAME(ST_Void),
+    GCF_STATE_NAME(ST_Init),
+    GCF_STATE_NAME(ST_Reset),
+    GCF_STATE_NAME(ST_ResetProbe),
+    GCF_STATE_NAME(ST_ResetUart),
+    GCF_STATE_NAME(ST_ResetFtdi),
+    GCF_STATE_NAME(ST_ResetRaspBee),
+    GCF_STATE_NAME(ST_ListDevices),
+    GCF_STATE_NAME(ST_Inventory),
+    GCF_STATE_NAME(ST_ResetFtdiAll),
+    GCF_STATE_NAME(ST_Program),
+    GCF_STATE_NAME(ST_BootloaderConnect),
+    GCF_STATE_NAME(ST_BootloaderQuery),
+    GCF_STATE_NAME(ST_V1ProgramSync),
+    GCF_STATE_NAME(ST_V1ProgramWriteHeader),
+    GCF_STATE_NAME(ST_V1ProgramUpload),
+    GCF_STATE_NAME(ST_V1ProgramValidate),
+    GCF_STATE_NAME(ST_V3ProgramSync),
+    GCF_STATE_NAME(ST_V3ProgramUpload),
+    GCF_STATE_NAME(ST_V3ProgramWaitID),
+    GCF_STATE_NAME(ST_Connect),
+    GCF_STATE_NAME(ST_Connected),
+#ifdef USE_SNIFF
+    GCF_STATE_NAME(ST_SniffConnect),
+    GCF_STATE_NAME(ST_SniffConfig),
+    GCF_STATE_NAME(ST_SniffConfigConfirm),
+    GCF_STATE_NAME(ST_SniffSyncData),
+    GCF_STATE_NAME(ST_SniffRecvData),
+    GCF_STATE_NAME(ST_SniffReconnect),
+    GCF_STATE_NAME(ST_SniffTeardown),
+#endif
+    GCF_STATE_NAME(ST_DumpFlashConnect),
+    GCF_STATE_NAME(ST_DumpFlashQueryFirmwareVersion),
+    GCF_STATE_NAME(ST_DumpFlashSend),
+    GCF_STATE_NAME(ST_DumpFlashWait),
+#ifdef USE_NET
+    GCF_STATE_NAME(ST_ServeIdle),
+#endif
+    { 0, "unknown" }
+};
+
+static const char *gcfStateName(state_handler_t state)
+{
+    unsigned i;
+
+    for (i = 0; gcfStateNames[i].state; i++)
+    {
+        if (gcfStateNames[i].state == state)
+            break;
+    }
+
+    return gcfStateNames[i].name;
+}
+
+#ifdef USE_METRICS
+const char *METRICS_StateName(void)
+{
+    return gcfStateName(gcfLocal.state);
 }
+#endif /* USE_METRICS */
 
 int GCF_ParseFile(GCF_File *file)
 {
@@ -1863,17 +3202,30 @@ int GCF_ParseFile(GCF_File *file)
     return 0;
 }
 
-void GCF_Received(GCF *gcf, const unsigned char *data, int len)
+static void gcfReceived(GCF *gcf, const unsigned char *data, int len)
 {
     int i;
     unsigned char ch;
     unsigned ascii;
 
-    Assert(len > 0);
-
     /*gcfDebugHex(gcf, "recv", data, len);*/
 
+    if (gcf->trace.buf)
+        TRACE_Push(&gcf->trace, TRACE_DIR_RX, data, (unsigned)len);
+
+    METRICS_Add(METRICS_SERIAL_RX_BYTES, (unsigned long)len);
+
+#ifdef USE_NET
+    if (gcf->bridgeAddr && gcf->bridgeMode == BRIDGE_MODE_RAW && gcf->state == ST_Connected)
+    {
+        /* straight from the platform read buffer */
+        BRIDGE_Send(&gcf->bridge, data, (unsigned)len);
+        return;
+    }
+#endif
+
     if (gcf->task == T_SNIFF ||
+        gcf->substate == ST_ResetProbe ||
         gcf->state == ST_BootloaderQuery ||
         gcf->state == ST_V1ProgramSync ||
         gcf->state == ST_V1ProgramWriteHeader ||
@@ -1921,12 +3273,26 @@ void GCF_Received(GCF *gcf, const unsigned char *data, int len)
         }
     }
 
-    if (0 != PROT_ReceiveFlagged(&gcf->rxstate, data, (unsigned)len))
+    i = PROT_ReceiveFlagged(&gcf->rxstate, data, (unsigned)len);
+    if (i != 0)
     {
+        METRICS_Add(METRICS_CRC_ERRORS, (unsigned long)i);
         PL_Printf(DBG_DEBUG, "received invalid CRC\n");
     }
 }
 
+void GCF_Received(GCF *gcf, const unsigned char *data, int len)
+{
+    Assert(len > 0);
+
+    if (gcf->eventDepth == 0 && gcf->record.file)
+        REPLAY_RecordData(&gcf->record, REPLAY_REC_RX, data, (unsigned)len);
+
+    gcf->eventDepth++;
+    gcfReceived(gcf, data, len);
+    gcf->eventDepth--;
+}
+
 static void GCF_ProcessInput(GCF *gcf)
 {
     U_SStream rs;
@@ -2106,100 +3472,422 @@ void GCF_KeyboardInput(GCF *gcf, unsigned long codepoint)
     }
 }
 
-void NET_Received(int client_id, const unsigned char *buf, unsigned bufsize)
-{
-    (void)buf;
-    PL_Printf(DBG_DEBUG, "NET received from client %d: %d bytes\n", client_id, bufsize);
-}
-
-void PROT_Packet(const unsigned char *data, unsigned len)
+#ifdef USE_NET
+/* Job server
+
+   Requests are text datagrams sent to the -p port:
+
+     list
+     flash <device> <firmware> [timeout]
+     reset <device> [timeout]
+     dump <device>
+
+   Jobs are queued and executed one after another, the firmware file and
+   device enumeration are kept between jobs. Replies:
+
+     queued <job> <number of jobs ahead>
+     start <job>
+     log <job> <text>
+     progress <job> <percent>
+     result <job> ok|failed
+     error <text>
+*/
+static void gcfNetReply(int client, const char *kind, unsigned long id, const char *text)
 {
-    int i;
-    char *p;
-    GCF *gcf;
-    U_SStream *ss;
-    unsigned printlen;
-
-    Assert(len > 0);
+    U_SStream ss;
+    char buf[UI_MAX_LINE_LENGTH + 32];
 
-    gcf = &gcfLocal;
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, kind);
 
-    if (gcf->uiInteractive && gcf->uiInputSize)
+    if (id)
     {
-        /* don't scramble console output */
+        U_sstream_put_str(&ss, " ");
+        U_sstream_put_long(&ss, (long)id);
     }
-    else if (data[0] != BTL_MAGIC && gcf->task == T_CONNECT)
-    {
-        printlen = len;
-        if (printlen > (sizeof(gcf->ascii) - 1) / 2)
-            printlen = (sizeof(gcf->ascii) - 1) / 2;
 
-        p = &gcf->ascii[0];
-        for (i = 0; i < (int)printlen; i++, p += 2)
-        {
-            put_hex(data[i], p);
-        }
-        *p = '\0';
-        ss = UI_StringStream(gcf);
-        U_sstream_put_str(ss, "packet: ");
-        U_sstream_put_long(ss, (long)len);
-        U_sstream_put_str(ss, " bytes, ");
-        U_sstream_put_str(ss, gcf->ascii);
-        U_sstream_put_str(ss, "\n");
-        UI_Puts(gcf, ss->str);
-    }
-    else
+    if (text)
     {
-        gcfDebugHex(gcf, "recv_packet", data, len);
+        U_sstream_put_str(&ss, " ");
+        U_sstream_put_str(&ss, text);
     }
 
-    if (data[0] == CMD_WRITE_PARAMETER && len >= 8) /* write parameter response */
-    {
-        switch (data[7])
-        {
-            case PARAM_WATCHDOG_TIMEOUT:
-            {
-                GCF_HandleEvent(gcf, EV_PKG_UART_RESET);
-            } break;
+    NET_Send(client, (unsigned char*)ss.str, ss.pos);
+}
 
-            default:
-                break;
-        }
-    }
-    else if (data[0] == BTL_MAGIC)
+/* Forwards UI output line by line without terminal control sequences. */
+static void gcfJobLog(GCF *gcf, const char *str)
+{
+    unsigned i;
+    char buf[UI_MAX_LINE_LENGTH];
+
+    for (i = 0; *str; str++)
     {
-        // TODO(mpi): use gcf->rxPacket
-        if (len < sizeof(gcf->ascii))
+        if (*str == '\x1b')
         {
-            U_memcpy(&gcf->ascii[0], data, len);
-            gcf->wp = len;
-            GCF_HandleEvent(gcf, EV_RX_BTL_PKG_DATA);
+            for (; str[1] && *str != 'm'; str++)
+            { }
         }
-    }
-    else
-    {
-        if (data[0] == CMD_FIRMWARE_VERSION && len >= 9 && data[2] == CMD_STATUS_SUCCESS)
+        else if (*str == '\n')
         {
-            unsigned fw;
-            U_memcpy(&fw, &data[5], 4);
-            ss = UI_StringStream(gcf);
-            U_sstream_put_str(ss, "firmware version: 0x");
-            U_sstream_put_u32hex(ss, fw);
-            U_sstream_put_str(ss, "\n");
-
-            UI_Puts(gcf, ss->str);
+            if (i)
+            {
+                buf[i] = '\0';
+                gcfNetReply(gcf->job->client, "log", gcf->job->id, buf);
+                i = 0;
+            }
         }
-
-        if (len < sizeof(gcf->rxPacket))
+        else if (*str != '\r' && i + 1 < sizeof(buf))
         {
-            U_memcpy(&gcf->rxPacket[0], data, len);
-            gcf->rxPacketLength = (int)len;
-            GCF_HandleEvent(gcf, EV_RX_PKG_DATA);
+            buf[i++] = *str;
         }
     }
+
+    if (i)
+    {
+        buf[i] = '\0';
+        gcfNetReply(gcf->job->client, "log", gcf->job->id, buf);
+    }
 }
 
-static DeviceType gcfGetDeviceType(GCF *gcf)
+static int gcfGetToken(U_SStream *ss, char *buf, unsigned size)
+{
+    unsigned i;
+    char ch;
+
+    U_sstream_skip_whitespace(ss);
+
+    for (i = 0; ss->pos < ss->len; ss->pos++, i++)
+    {
+        ch = ss->str[ss->pos];
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+            break;
+
+        if (i + 1 == size)
+            return 0;
+
+        buf[i] = ch;
+    }
+
+    buf[i] = '\0';
+    return i != 0;
+}
+
+static void gcfJobRequest(GCF *gcf, int client, U_SStream *ss)
+{
+    long longval;
+    GCF_Job *job;
+    char cmd[8];
+
+    if (gcf->jobCount == GCF_MAX_JOBS)
+    {
+        gcfNetReply(client, "error", 0, "queue full");
+        return;
+    }
+
+    job = &gcf->jobs[(gcf->jobHead + gcf->jobCount) % GCF_MAX_JOBS];
+    job->client = client;
+    job->timeout = GCF_JOB_TIMEOUT;
+    job->devpath[0] = '\0';
+    job->fname[0] = '\0';
+
+    if (gcfGetToken(ss, &cmd[0], sizeof(cmd)) == 0)
+        goto err_invalid;
+
+    if      (gcfStrEquals(cmd, "list"))  { job->task = T_LIST; }
+    else if (gcfStrEquals(cmd, "flash")) { job->task = T_PROGRAM; }
+    else if (gcfStrEquals(cmd, "reset")) { job->task = T_RESET; }
+    else if (gcfStrEquals(cmd, "dump"))  { job->task = T_DUMP_FLASH; }
+    else
+    {
+        goto err_invalid;
+    }
+
+    if (job->task != T_LIST && gcfGetToken(ss, &job->devpath[0], sizeof(job->devpath)) == 0)
+        goto err_invalid;
+
+    if (job->task == T_PROGRAM && gcfGetToken(ss, &job->fname[0], sizeof(job->fname)) == 0)
+        goto err_invalid;
+
+    U_sstream_skip_whitespace(ss);
+    if (!U_sstream_at_end(ss))
+    {
+        longval = U_sstream_get_long(ss); /* seconds */
+        if (ss->status != U_SSTREAM_OK || longval < 0 || longval > 3600)
+            goto err_invalid;
+
+        job->timeout = (unsigned long)longval;
+        U_sstream_skip_whitespace(ss);
+        if (!U_sstream_at_end(ss))
+            goto err_invalid;
+    }
+
+    job->id = ++gcf->jobId;
+    gcf->jobCount++;
+    NET_PinClient(client, 1); /* replies may follow long after the TTL */
+
+    U_sstream_init(ss, &cmd[0], sizeof(cmd));
+    U_sstream_put_long(ss, (long)gcf->jobCount - 1);
+    gcfNetReply(client, "queued", job->id, ss->str);
+
+    if (!gcf->job)
+        gcfScheduleEventAction(gcf);
+
+    return;
+
+err_invalid:
+    gcfNetReply(client, "error", 0, "invalid request");
+}
+
+static void ST_ServeIdle(GCF *gcf, Event event)
+{
+    if (event == EV_ACTION && gcf->jobCount && !gcf->job)
+    {
+        gcfJobBegin(gcf);
+    }
+}
+
+static void gcfJobBegin(GCF *gcf)
+{
+    long nread;
+    GCF_Job *job;
+
+    job = &gcf->jobs[gcf->jobHead];
+    gcf->job = job;
+    gcf->task = job->task;
+    gcf->jobPercent = -1;
+    gcf->uiJsonResult = 0;
+    gcf->statusInfo.result = STATUS_RESULT_RUNNING;
+    gcf->statusInfo.error[0] = '\0';
+    gcf->maxTime = PL_Time() + (PL_time_t)job->timeout * 1000;
+
+    gcfNetReply(job->client, "start", job->id, 0);
+
+    /* read on every job, the same path may hold a new image by now */
+    if (job->task == T_PROGRAM)
+    {
+        U_memcpy(gcf->file.fname, job->fname, sizeof(gcf->file.fname));
+        nread = (long)PL_ReadFile(gcf->file.fname, gcf->file.fcontent, sizeof(gcf->file.fcontent));
+        gcf->file.fsize = nread > 0 ? (unsigned long)nread : 0;
+
+        if (nread <= 0 || GCF_ParseFile(&gcf->file) != 0)
+        {
+            UI_Puts(gcf, "invalid firmware file\n");
+            gcf->file.fname[0] = '\0';
+            gcfTaskDone(gcf, GCF_FAILED);
+            return;
+        }
+    }
+
+    gcfJobSetup(gcf);
+}
+
+/* Starts an attempt of the current job, also called for retries. */
+static void gcfJobSetup(GCF *gcf)
+{
+    GCF_Job *job;
+
+    job = gcf->job;
+    gcf->substate = ST_Void;
+    gcf->devSerialNum[0] = '\0';
+    gcf->devBaudrate = PL_BAUDRATE_UNKNOWN;
+    U_memcpy(gcf->devpath, job->devpath, sizeof(gcf->devpath));
+
+    if (job->task != T_LIST)
+    {
+        if (gcfResolveDevice(gcf) == 0)
+        {
+            UI_Puts(gcf, "device not found\n");
+            gcfTaskDone(gcf, GCF_FAILED);
+            return;
+        }
+
+        gcf->devType = gcfGetDeviceType(gcf);
+    }
+
+    if (job->task == T_PROGRAM)
+    {
+        gcfRefineDeviceType(gcf);
+        PL_EnableHotplug();
+        gcf->state = ST_Program;
+    }
+    else if (job->task == T_RESET)
+    {
+        gcf->state = ST_Reset;
+    }
+    else if (job->task == T_DUMP_FLASH)
+    {
+        gcf->state = ST_DumpFlashConnect;
+    }
+    else
+    {
+        gcf->state = ST_ListDevices;
+    }
+
+    GCF_HandleEvent(gcf, EV_ACTION);
+}
+
+static void gcfJobFinish(GCF *gcf, GCF_Status status)
+{
+    GCF_Job *job;
+
+    job = gcf->job;
+    gcf->job = 0;
+    gcf->task = T_SERVE;
+    gcf->state = ST_ServeIdle;
+    gcf->substate = ST_Void;
+
+    PL_ClearTimeout();
+    PL_Disconnect();
+
+    gcfNetReply(job->client, "result", job->id, status == GCF_SUCCESS ? "ok" : "failed");
+    NET_PinClient(job->client, 0);
+
+    gcf->jobHead = (gcf->jobHead + 1) % GCF_MAX_JOBS;
+    gcf->jobCount--;
+
+    if (gcf->jobCount)
+        gcfScheduleEventAction(gcf);
+}
+#endif /* USE_NET */
+
+void NET_Received(int client_id, const unsigned char *buf, unsigned bufsize)
+{
+    U_SStream ss;
+
+    PL_Printf(DBG_DEBUG, "NET received from client %d: %d bytes\n", client_id, bufsize);
+
+    U_sstream_init(&ss, (void*)buf, bufsize);
+
+#ifdef USE_SNIFF
+    if (U_sstream_starts_with(&ss, "trigger"))
+    {
+        SNIFF_RingTrigger(&gcfLocal.sniffRing, "udp");
+        return;
+    }
+#endif
+
+#ifdef USE_NET
+    if (gcfLocal.serve && client_id >= 0)
+        gcfJobRequest(&gcfLocal, client_id, &ss);
+#endif
+}
+
+#ifdef USE_NET
+void BRIDGE_Received(const unsigned char *data, unsigned len)
+{
+    GCF *gcf;
+
+    gcf = &gcfLocal;
+
+    if (gcf->state != ST_Connected)
+        return; /* device not connected */
+
+    if (gcf->bridgeMode == BRIDGE_MODE_RAW)
+        PROT_Write(data, len);
+    else
+        PROT_SendFlagged(data, len);
+}
+#endif
+
+void PROT_Packet(const unsigned char *data, unsigned len)
+{
+    int i;
+    char *p;
+    GCF *gcf;
+    U_SStream *ss;
+    unsigned printlen;
+
+    Assert(len > 0);
+
+    gcf = &gcfLocal;
+
+    METRICS_Add(METRICS_FRAMES, 1);
+
+#ifdef USE_NET
+    if (gcf->bridgeAddr && gcf->state == ST_Connected)
+    {
+        BRIDGE_Send(&gcf->bridge, data, len);
+        return;
+    }
+#endif
+
+    if (gcf->uiInteractive && gcf->uiInputSize)
+    {
+        /* don't scramble console output */
+    }
+    else if (data[0] != BTL_MAGIC && gcf->task == T_CONNECT)
+    {
+        printlen = len;
+        if (printlen > (sizeof(gcf->ascii) - 1) / 2)
+            printlen = (sizeof(gcf->ascii) - 1) / 2;
+
+        p = &gcf->ascii[0];
+        for (i = 0; i < (int)printlen; i++, p += 2)
+        {
+            put_hex(data[i], p);
+        }
+        *p = '\0';
+        ss = UI_StringStream(gcf);
+        U_sstream_put_str(ss, "packet: ");
+        U_sstream_put_long(ss, (long)len);
+        U_sstream_put_str(ss, " bytes, ");
+        U_sstream_put_str(ss, gcf->ascii);
+        U_sstream_put_str(ss, "\n");
+        UI_Puts(gcf, ss->str);
+    }
+    else
+    {
+        gcfDebugHex(gcf, "recv_packet", data, len);
+    }
+
+    if (data[0] == CMD_WRITE_PARAMETER && len >= 8) /* write parameter response */
+    {
+        switch (data[7])
+        {
+            case PARAM_WATCHDOG_TIMEOUT:
+            {
+                GCF_HandleEvent(gcf, EV_PKG_UART_RESET);
+            } break;
+
+            default:
+                break;
+        }
+    }
+    else if (data[0] == BTL_MAGIC)
+    {
+        // TODO(mpi): use gcf->rxPacket
+        if (len < sizeof(gcf->ascii))
+        {
+            U_memcpy(&gcf->ascii[0], data, len);
+            gcf->wp = len;
+            GCF_HandleEvent(gcf, EV_RX_BTL_PKG_DATA);
+        }
+    }
+    else
+    {
+        if (data[0] == CMD_FIRMWARE_VERSION && len >= 9 && data[2] == CMD_STATUS_SUCCESS)
+        {
+            unsigned fw;
+            U_memcpy(&fw, &data[5], 4);
+            ss = UI_StringStream(gcf);
+            U_sstream_put_str(ss, "firmware version: 0x");
+            U_sstream_put_u32hex(ss, fw);
+            U_sstream_put_str(ss, "\n");
+
+            UI_Puts(gcf, ss->str);
+        }
+
+        if (len < sizeof(gcf->rxPacket))
+        {
+            U_memcpy(&gcf->rxPacket[0], data, len);
+            gcf->rxPacketLength = (int)len;
+            GCF_HandleEvent(gcf, EV_RX_PKG_DATA);
+        }
+    }
+}
+
+static DeviceType gcfGetDeviceType(GCF *gcf)
 {
     int ftype;
     U_SStream ss;
@@ -2246,40 +3934,253 @@ static DeviceType gcfGetDeviceType(GCF *gcf)
     else if (result == DEV_CONBEE_1 && ftype > 9)                   { result = DEV_UNKNOWN; baudrate = PL_BAUDRATE_38400; }
     else if (result == DEV_RASPBEE_2 && ftype >= 30 && ftype <= 39) { result = DEV_RASPBEE_2; baudrate = PL_BAUDRATE_38400; }
 
-    if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
-        gcf->devBaudrate = baudrate;
+    if (gcf->devBaudrate == PL_BAUDRATE_UNKNOWN)
+        gcf->devBaudrate = baudrate;
+
+    return result;
+}
+
+/* The /dev/ttyACM0 and similar doesn't tell if this is RaspBee II,
+   the fwVersion of the file is more specific.
+*/
+static void gcfRefineDeviceType(GCF *gcf)
+{
+    if (gcf->devType == DEV_RASPBEE_1 &&
+        (gcf->file.fwVersion & FW_VERSION_PLATFORM_MASK) == FW_VERSION_PLATFORM_R21)
+    {
+        PL_Printf(DBG_DEBUG, "assume RaspBee II\n");
+        gcf->devType = DEV_RASPBEE_2;
+    }
+    else if (gcf->devType == DEV_RASPBEE_1 && gcf->file.gcfTargetAddress == 0x5000)
+    {
+        PL_Printf(DBG_DEBUG, "assume RaspBee II\n");
+        gcf->devType = DEV_RASPBEE_2;
+    }
+}
+
+unsigned char GCF_NextSeq(void)
+{
+    return gcfSeq++;
+}
+
+static void gcfScheduleEventAction(GCF *gcf)
+{
+    gcf->evAction = 1;
+}
+
+static void gcfRetry(GCF *gcf)
+{
+    PL_time_t now;
+    U_SStream *ss;
+
+    now = PL_Time();
+
+    if (gcf->maxTime > now)
+    {
+        gcfStatusError(gcf); /* before the retry message */
+
+        ss = UI_StringStream(gcf);
+        U_sstream_put_str(ss, "retry: ");
+        U_sstream_put_long(ss, (long)(gcf->maxTime - now) / 1000);
+        U_sstream_put_str(ss, " seconds left\n");
+        UI_Puts(gcf, ss->str);
+
+        gcf->timing.retries++;
+        PROBE_RETRY(gcf->probeStateName, gcf->timing.retries);
+        gcf->state = ST_Init;
+        gcf->substate = ST_Void;
+        PL_SetTimeout(250);
+    }
+    else
+    {
+        gcfTaskDone(gcf, GCF_FAILED);
+    }
+}
+
+/* Called when a task has finished, ends the program or in server mode
+   the current job.
+*/
+static void gcfTaskDone(GCF *gcf, GCF_Status status)
+{
+    if (gcf->timingPath)
+        TIMING_Write(&gcf->timing, gcf->timingPath, status, gcf->devpath, gcf->file.fname);
+
+    UI_PutResult(gcf, status);
+
+    if (gcf->status.block)
+    {
+        if (status != GCF_SUCCESS)
+            gcfStatusError(gcf);
+
+        gcf->statusInfo.result = status == GCF_SUCCESS ? STATUS_RESULT_SUCCESS : STATUS_RESULT_FAILED;
+        gcfUpdateStatus(gcf, 1);
+    }
+
+    if (status != GCF_SUCCESS)
+        gcfTraceDump(gcf, "failed");
+
+#ifdef USE_NET
+    if (gcf->job)
+    {
+        gcfJobFinish(gcf, status);
+        return;
+    }
+#endif
+    (void)status;
+    PL_ShutDown();
+}
+
+/* Flash phase of a state for the --timing report. */
+static TIMING_Phase gcfTimingPhase(state_handler_t state)
+{
+    if (state == ST_Program || state == ST_Reset)
+        return TIMING_PHASE_RESET;
+
+    if (state == ST_BootloaderConnect || state == ST_BootloaderQuery)
+        return TIMING_PHASE_BOOTLOADER;
+
+    if (state == ST_V1ProgramSync || state == ST_V1ProgramWriteHeader || state == ST_V3ProgramSync)
+        return TIMING_PHASE_SYNC;
+
+    if (state == ST_V1ProgramUpload || state == ST_V3ProgramUpload)
+        return TIMING_PHASE_UPLOAD;
+
+    if (state == ST_V1ProgramValidate || state == ST_V3ProgramWaitID)
+        return TIMING_PHASE_VERIFY;
+
+    return TIMING_PHASE_OTHER;
+}
+
+/* Fires the state_exit and state_enter tracepoints for changes of the
+   state and the reset substate. The name lookup only runs on a change,
+   the other probes use the cached name.
+*/
+static void gcfUpdateProbes(GCF *gcf)
+{
+    PL_time_t now;
+
+    if (gcf->probeState != gcf->state)
+    {
+        now = PL_Time();
+        PROBE_STATE_EXIT(gcf->probeStateName, (unsigned long)(now - gcf->probeStateTime));
+        gcf->probeState = gcf->state;
+        gcf->probeStateName = gcfStateName(gcf->state);
+        gcf->probeStateTime = now;
+        PROBE_STATE_ENTER(gcf->probeStateName);
+    }
+
+    if (gcf->probeSubstate != gcf->substate)
+    {
+        now = PL_Time();
+        if (gcf->probeSubstate != ST_Void)
+            PROBE_STATE_EXIT(gcfStateName(gcf->probeSubstate), (unsigned long)(now - gcf->probeSubstateTime));
+        gcf->probeSubstate = gcf->substate;
+        gcf->probeSubstateTime = now;
+        if (gcf->substate != ST_Void)
+            PROBE_STATE_ENTER(gcfStateName(gcf->substate));
+    }
+}
 
-    return result;
+static void gcfUpdateTiming(GCF *gcf)
+{
+    /* --json and --status-shm report the upload rate and retries from the timing state */
+    if ((gcf->timingPath || gcf->uiJson || gcf->status.block) && gcf->task == T_PROGRAM)
+        TIMING_SetPhase(&gcf->timing, gcfTimingPhase(gcf->state));
 }
 
-static void gcfScheduleEventAction(GCF *gcf)
+/* The message printed before a retry or failure is kept as error. */
+static void gcfStatusError(GCF *gcf)
 {
-    gcf->evAction = 1;
+    U_memcpy(&gcf->statusInfo.error[0], &gcf->statusLastMsg[0], sizeof(gcf->statusInfo.error));
 }
 
-static void gcfRetry(GCF *gcf)
+/* Publishes the status block on state changes, otherwise every
+   STATUS_INTERVAL as heartbeat.
+*/
+static void gcfUpdateStatus(GCF *gcf, int force)
 {
+    unsigned len;
     PL_time_t now;
-    U_SStream *ss;
+    PL_time_t elapsed;
+    const char *name;
+    STATUS_Info *info;
 
     now = PL_Time();
 
-    if (gcf->maxTime > now)
+    if (!force && gcf->statusState == gcf->state && now < gcf->statusTime + STATUS_INTERVAL)
+        return;
+
+    gcf->statusTime = now;
+    info = &gcf->statusInfo;
+
+    if (gcf->statusState != gcf->state)
     {
-        ss = UI_StringStream(gcf);
-        U_sstream_put_str(ss, "retry: ");
-        U_sstream_put_long(ss, (long)(gcf->maxTime - now) / 1000);
-        U_sstream_put_str(ss, " seconds left\n");
-        UI_Puts(gcf, ss->str);
+        gcf->statusState = gcf->state;
+        name = gcfStateName(gcf->state);
+        len = U_strlen(name);
+        len = len < sizeof(info->state) - 1 ? len : sizeof(info->state) - 1;
+        U_memcpy(&info->state[0], name, len);
+        info->state[len] = '\0';
+    }
 
-        gcf->state = ST_Init;
-        gcf->substate = ST_Void;
-        PL_SetTimeout(250);
+    len = U_strlen(gcf->devpath);
+    len = len < sizeof(info->device) - 1 ? len : sizeof(info->device) - 1;
+    U_memcpy(&info->device[0], gcf->devpath, len);
+    info->device[len] = '\0';
+
+    elapsed = TIMING_PhaseTime(&gcf->timing, TIMING_PHASE_UPLOAD);
+    info->bytesPerSec = elapsed ? (unsigned long long)gcf->timing.uploadBytes * 1000 / elapsed : 0;
+    info->retries = gcf->timing.retries;
+    info->timestamp = PL_WallTime();
+
+    STATUS_Publish(&gcf->status, info);
+}
+
+void GCF_TraceSent(GCF *gcf, const unsigned char *data, unsigned len)
+{
+    if (gcf->trace.buf)
+        TRACE_Push(&gcf->trace, TRACE_DIR_TX, data, len);
+
+    if (gcf->record.file)
+        REPLAY_RecordData(&gcf->record, REPLAY_REC_TX, data, len);
+}
+
+static void gcfTraceDump(GCF *gcf, const char *reason)
+{
+    long n;
+    unsigned long dropped;
+    U_SStream *ss;
+    char path[MAX_DEV_PATH_LENGTH];
+
+    dropped = gcf->trace.dropped;
+    n = TRACE_Dump(&gcf->trace, &path[0], sizeof(path));
+    if (n == 0)
+        return;
+
+    ss = UI_StringStream(gcf);
+    if (n < 0)
+    {
+        U_sstream_put_str(ss, "failed to write wire trace ");
+        U_sstream_put_str(ss, gcf->tracePrefix);
     }
     else
     {
-        PL_ShutDown();
+        U_sstream_put_str(ss, "wire trace (");
+        U_sstream_put_str(ss, reason);
+        U_sstream_put_str(ss, "), ");
+        U_sstream_put_long(ss, n);
+        U_sstream_put_str(ss, " records written to ");
+        U_sstream_put_str(ss, &path[0]);
+
+        if (dropped)
+        {
+            U_sstream_put_str(ss, ", ");
+            U_sstream_put_long(ss, (long)dropped);
+            U_sstream_put_str(ss, " older dropped");
+        }
     }
+    U_sstream_put_str(ss, "\n");
+    UI_Puts(gcf, ss->str);
 }
 
 static void gcfPrintHelp(void)
@@ -2288,15 +4189,43 @@ static void gcfPrintHelp(void)
     "usage: GCFFlasher <options>\n"
     "options:\n"
     " -r              force device reboot without programming\n"
+    " --reset-ftdi               reboot all attached ConBee I at once\n"
+#ifdef PL_LINUX
+    " --reset-gpio <chip>:<line> RaspBee reset pin, e.g. /dev/gpiochip0:17\n"
+#endif
     " -f <firmware>   flash firmware file\n"
+    " --timing <file>            append phase durations of the flash run as\n"
+    "                            JSON line to file (- for stdout)\n"
+    " --json                     print state, progress and result as JSON\n"
+    "                            lines instead of the progress bar\n"
+    " --status-shm <name>        publish the status in shared memory <name>\n"
+    " --wire-trace <prefix>      record the serial traffic in memory and write\n"
+    "                            it to <prefix>-<time>.pcap on exit, failure,\n"
+    "                            SIGINT, SIGTERM or SIGUSR1\n"
+    " --record <file>            record the serial session to file\n"
+#if !defined(PL_WIN) && !defined(PL_DOS)
+    " --replay <file>            run against a recorded session instead of\n"
+    "                            the device, needs the same options\n"
+    " --replay-realtime          replay at recorded speed\n"
+#endif
 #if defined(PL_WIN) || defined(PL_DOS)
     " -d <com port>   COM port to use, e.g. COM1\n"
 #else
     " -d <device>     device number or path to use, e.g. 0, /dev/ttyUSB0 or RaspBee\n"
+    "                 or serial:<serial number> as shown by -l\n"
 #ifdef USE_NET
-    " -n <interface>  listen interface\n"
-    "                 when only -p is specified default is 0.0.0.0 for any interface\n"
+    " -n <interface>  listen interface, e.g. 0.0.0.0 for any interface\n"
+    "                 when only -p is specified default is 127.0.0.1\n"
     " -p <port>       listen port\n"
+    " --net-clients <n>          max. number of network clients, default 64\n"
+    " --net-ttl <sec>            inactive clients may be replaced after\n"
+    "                            <sec> seconds, default 300\n"
+    " --serve                    run as job server for flash, reset, dump and\n"
+    "                            list requests received on -p port\n"
+    " --bridge <addr>            connect and forward the serial link to one\n"
+    "                            client on tcp:[<ip>:]<port> or unix:<path>\n"
+    " --bridge-frames            forward decoded frames with U16 length prefix\n"
+    "                            instead of raw bytes, allows up to 8 clients\n"
 #endif
 #endif
     " -b <baudrate>   use specific baudrate (if not detected automatically)\n"
@@ -2307,17 +4236,38 @@ static void gcfPrintHelp(void)
     "                 the Wireshark sniffer traffic is send to UDP port 17754\n"
     " -H <host>       send sniffer traffic to Wireshark running on host\n"
     "                 default is 172.0.0.1 (localhost)\n"
+    " --ring <prefix>            keep recent sniffer frames in memory and write\n"
+    "                            them to <prefix>-<time>.pcap when triggered\n"
+#ifdef USE_NET
+    "                            by SIGUSR1 or 'trigger' UDP message (-p port)\n"
+#else
+    "                            by SIGUSR1\n"
+#endif
+    " --ring-window <sec>[,<MB>] ring limits, default 30 seconds and 4 MB\n"
+    " --ring-trigger <hex>       trigger on frames containing the hex pattern\n"
+    " --sniff-json <file>        write decoded frames as JSON lines to file\n"
+    "                            (- for stdout)\n"
+    " --sniff-shm <name>         publish frames in shared memory ring <name>\n"
     #endif
     " -c              connect and debug serial protocol\n"
 //    " -s <serial>     serial number to use\n"
     " -t <timeout>    retry until timeout (seconds) is reached\n"
     " -l              list devices\n"
+#if !defined(PL_WIN) && !defined(PL_DOS)
+    " --inventory                query firmware and bootloader versions of\n"
+    "                            all devices at once\n"
+    " --inventory-json           same as --inventory with JSON lines output\n"
+#endif
     " -x <loglevel>   debug log level 0, 1, 3\n"
     " -k              dump flash in SREC format to stdout\n"
     "                 (currently only for ConBee II / RaspBee II)\n"
     "                 requires latest firmware version\n"
 #ifdef PL_LINUX
     " -i              interactive mode for debugging\n"
+#endif
+#ifdef USE_METRICS
+    " --metrics [<ip>:]<port>    serve Prometheus metrics over HTTP,\n"
+    "                            default address is 127.0.0.1\n"
 #endif
     " -h -?           print this help\n";
 
@@ -2368,34 +4318,275 @@ void U_sstream_put_u8hex(U_SStream *ss, unsigned char val)
     ss->str[ss->pos] = '\0';
 }
 
+#define DEBUG_HEX_LINE 128 /* bytes per line, fits UI_MAX_LINE_LENGTH */
+
 void gcfDebugHex(GCF *gcf, const char *msg, const unsigned char *data, unsigned size)
 {
+    unsigned i;
+    unsigned n;
+    U_SStream *ss;
+
     if (gcf->uiDebugLevel == 0)
         return;
 
-    char *p;
-    char buf[1024];
-    unsigned i;
-    U_SStream *ss;
+    /* long buffers are printed in several lines */
+    i = 0;
+    do
+    {
+        ss = UI_StringStream(gcf);
+        U_sstream_put_str(ss, FMT_GREEN);
+        U_sstream_put_str(ss, msg);
+        U_sstream_put_str(ss, ":" FMT_RESET " ");
+
+        for (n = 0; n < DEBUG_HEX_LINE && i < size; n++, i++)
+            U_sstream_put_u8hex(ss, data[i]);
+
+        U_sstream_put_str(ss, " (");
+        U_sstream_put_long(ss, (long)size);
+        U_sstream_put_str(ss, ")\n");
+        UI_Puts(gcf, ss->str);
+    } while (i < size);
+}
+
+static int gcfStrEquals(const char *a, const char *b)
+{
+    for (; *a && *a == *b; a++, b++)
+    { }
+
+    return *a == *b;
+}
+
+/* Long options "--name [value]", \p i points to the current argument
+   and is advanced when a value is consumed.
+*/
+static GCF_Status gcfProcessLongOption(GCF *gcf, int *i)
+{
+    const char *opt;
+    const char *arg;
+    long longval;
+    unsigned j;
+    U_SStream ss;
 
-    p = &buf[0];
+    opt = gcf->argv[*i];
+    arg = 0;
 
-    Assert(size < (sizeof(buf) / 2) - 1);
-    for (i = 0; i < size; i++, p += 2)
+    if ((*i + 1) < gcf->argc)
+        arg = gcf->argv[*i + 1];
+
+    if (0) { }
+#ifdef USE_SNIFF
+    else if (gcfStrEquals(opt, "--ring"))
     {
-        put_hex(data[i], p);
+        if (!arg)
+            goto err_missing;
+
+        gcf->sniffRingPrefix = arg;
+        *i += 1;
     }
-    *p = '\0';
+    else if (gcfStrEquals(opt, "--ring-window"))
+    {
+        if (!arg)
+            goto err_missing;
 
-    ss = UI_StringStream(gcf);
-    U_sstream_put_str(ss, FMT_GREEN);
-    U_sstream_put_str(ss, msg);
-    U_sstream_put_str(ss, ":" FMT_RESET " ");
-    U_sstream_put_str(ss, &buf[0]);
-    U_sstream_put_str(ss, " (");
-    U_sstream_put_long(ss, (long)size);
-    U_sstream_put_str(ss, ")\n");
-    UI_Puts(gcf, ss->str);
+        U_sstream_init(&ss, (void*)arg, U_strlen(arg));
+        longval = U_sstream_get_long(&ss); /* seconds */
+
+        if (ss.status != U_SSTREAM_OK || longval < 1 || longval > 86400)
+            goto err_invalid;
+
+        gcf->sniffRingSeconds = (unsigned long)longval;
+
+        if (U_sstream_peek_char(&ss) == ',')
+        {
+            ss.pos++;
+            longval = U_sstream_get_long(&ss); /* MB */
+
+            if (ss.status != U_SSTREAM_OK || longval < 1 || (unsigned long)longval > (SNIFF_RING_MAX_SIZE >> 20))
+                goto err_invalid;
+
+            gcf->sniffRingSize = (unsigned long)longval << 20;
+        }
+
+        if (!U_sstream_at_end(&ss))
+            goto err_invalid;
+
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--ring-trigger"))
+    {
+        unsigned char byte;
+
+        if (!arg)
+            goto err_missing;
+
+        U_sstream_init(&ss, (void*)arg, U_strlen(arg));
+        if (U_sstream_starts_with(&ss, "0x"))
+            ss.pos += 2;
+
+        gcf->sniffRing.patternLength = 0;
+        for (; gcf->sniffRing.patternLength < SNIFF_RING_MAX_PATTERN && GCF_sstream_get_hexbyte(&ss, &byte);)
+        {
+            gcf->sniffRing.pattern[gcf->sniffRing.patternLength++] = byte;
+        }
+
+        if (gcf->sniffRing.patternLength == 0 || !U_sstream_at_end(&ss))
+            goto err_invalid;
+
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--sniff-json"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->sniffJsonPath = arg;
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--sniff-shm"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->sniffShmName = arg;
+        *i += 1;
+    }
+#endif /* USE_SNIFF */
+#ifdef USE_NET
+    else if (gcfStrEquals(opt, "--net-clients") || gcfStrEquals(opt, "--net-ttl"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        U_sstream_init(&ss, (void*)arg, U_strlen(arg));
+        longval = U_sstream_get_long(&ss);
+
+        if (ss.status != U_SSTREAM_OK || longval < 1 || !U_sstream_at_end(&ss))
+            goto err_invalid;
+
+        if (gcfStrEquals(opt, "--net-clients"))
+        {
+            if (longval > NET_MAX_CLIENTS)
+                goto err_invalid;
+            gcf->netMaxClients = (unsigned)longval;
+        }
+        else
+        {
+            gcf->netClientTtl = (unsigned long)longval;
+        }
+
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--serve"))
+    {
+        gcf->serve = 1;
+        gcf->task = T_SERVE;
+    }
+    else if (gcfStrEquals(opt, "--bridge"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->bridgeAddr = arg;
+        gcf->task = T_CONNECT;
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--bridge-frames"))
+    {
+        gcf->bridgeMode = BRIDGE_MODE_FRAMES;
+    }
+#endif /* USE_NET */
+    else if (gcfStrEquals(opt, "--inventory") || gcfStrEquals(opt, "--inventory-json"))
+    {
+        gcf->task = T_INVENTORY;
+        gcf->inventoryJson = gcfStrEquals(opt, "--inventory-json");
+    }
+    else if (gcfStrEquals(opt, "--json") || gcfStrEquals(opt, "--replay-realtime"))
+    {
+        /* handled in GCF_Init() */
+    }
+    else if (gcfStrEquals(opt, "--record") || gcfStrEquals(opt, "--replay"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        *i += 1; /* handled in GCF_Init() */
+    }
+    else if (gcfStrEquals(opt, "--wire-trace"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->tracePrefix = arg;
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--status-shm"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->statusName = arg;
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--timing"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->timingPath = arg;
+        *i += 1;
+    }
+    else if (gcfStrEquals(opt, "--reset-ftdi"))
+    {
+        gcf->task = T_RESET_FTDI;
+    }
+    else if (gcfStrEquals(opt, "--reset-gpio"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        /* <gpiochip>:<line> */
+        for (j = U_strlen(arg); j > 0 && arg[j - 1] != ':'; j--)
+            ;
+
+        if (j < 2 || j > sizeof(gcf->resetGpioChip))
+            goto err_invalid;
+
+        U_sstream_init(&ss, (void*)&arg[j], U_strlen(&arg[j]));
+        longval = U_sstream_get_long(&ss);
+
+        if (ss.status != U_SSTREAM_OK || longval < 0 || !U_sstream_at_end(&ss))
+            goto err_invalid;
+
+        U_memcpy(&gcf->resetGpioChip[0], arg, j - 1);
+        gcf->resetGpioChip[j - 1] = '\0';
+        gcf->resetGpioLine = (unsigned)longval;
+        *i += 1;
+    }
+#ifdef USE_METRICS
+    else if (gcfStrEquals(opt, "--metrics"))
+    {
+        if (!arg)
+            goto err_missing;
+
+        gcf->metricsAddr = arg;
+        *i += 1;
+    }
+#endif
+    else
+    {
+        PL_Printf(DBG_INFO, "unknown option: %s\n", opt);
+        return GCF_FAILED;
+    }
+
+    return GCF_SUCCESS;
+
+err_missing:
+    PL_Printf(DBG_INFO, "missing argument for parameter %s\n", opt);
+    return GCF_FAILED;
+
+err_invalid:
+    PL_Printf(DBG_INFO, "invalid argument, %s, for parameter %s\n", arg, opt);
+    return GCF_FAILED;
 }
 
 static GCF_Status gcfProcessCommandline(GCF *gcf)
@@ -2407,12 +4598,37 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
     long nread;
     GCF_Status ret = GCF_FAILED;
     U_SStream ss;
+    U_SStream *ss_ui;
 
     gcf->state = ST_Void;
     gcf->substate = ST_Void;
+    gcf->resetGpioChip[0] = '\0';
+    gcf->timingPath = 0;
+    gcf->statusName = 0;
+    gcf->tracePrefix = 0;
     gcf->uiInteractive = 0;
     gcf->uiDebugLevel = 0;
     gcf->sniffChannel = 0;
+#ifdef USE_SNIFF
+    gcf->sniffRingPrefix = 0;
+    gcf->sniffRingSeconds = 30;
+    gcf->sniffRingSize = 4UL << 20;
+    gcf->sniffRing.patternLength = 0;
+    gcf->sniffJsonPath = 0;
+    gcf->sniffShmName = 0;
+#endif
+#ifdef USE_NET
+    gcf->netMaxClients = NET_DEFAULT_CLIENTS;
+    gcf->netClientTtl = NET_DEFAULT_CLIENT_TTL;
+    gcf->netPort = 0;
+    gcf->netInterface = 0;
+    gcf->serve = 0;
+    gcf->bridgeAddr = 0;
+    gcf->bridgeMode = BRIDGE_MODE_RAW;
+#endif
+#ifdef USE_METRICS
+    gcf->metricsAddr = 0;
+#endif
     gcf->devpath[0] = '\0';
     gcf->devSerialNum[0] = '\0';
     gcf->devType = DEV_UNKNOWN;
@@ -2499,7 +4715,13 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
                         return GCF_FAILED;
                     }
 
-                    PL_Printf(DBG_INFO, "read file success: %s (%ld bytes)\n", gcf->file.fname, nread);
+                    ss_ui = UI_StringStream(gcf);
+                    U_sstream_put_str(ss_ui, "read file success: ");
+                    U_sstream_put_str(ss_ui, gcf->file.fname);
+                    U_sstream_put_str(ss_ui, " (");
+                    U_sstream_put_long(ss_ui, nread);
+                    U_sstream_put_str(ss_ui, " bytes)\n");
+                    UI_Puts(gcf, ss_ui->str);
                     gcf->file.fsize = (unsigned long)nread;
 
                     if (GCF_ParseFile(&gcf->file) != 0)
@@ -2657,14 +4879,37 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
                         return GCF_FAILED;
                     }
 
-                    if (NET_Init(0, (unsigned short)longval) != 1)
+                    gcf->netPort = (unsigned short)longval;
+                }
+                    break;
+
+                case 'n':
+                {
+                    if ((i + 1) == gcf->argc || gcf->argv[i + 1][0] == '-')
+                    {
+                        PL_Printf(DBG_INFO, "missing argument for parameter -n\n");
+                        return GCF_FAILED;
+                    }
+
+                    i++;
+                    arg = gcf->argv[i];
+
+                    if (SOCK_GetHostAF(arg) != S_AF_IPV4)
                     {
-                        PL_Printf(DBG_INFO, "failed to start network server\n");
+                        PL_Printf(DBG_INFO, "invalid argument, %s, for parameter -n\n", arg);
                         return GCF_FAILED;
                     }
+
+                    gcf->netInterface = arg;
                 }
                     break;
 #endif /* USE_NET */
+                case '-':
+                {
+                    if (gcfProcessLongOption(gcf, &i) != GCF_SUCCESS)
+                        return GCF_FAILED;
+                } break;
+
                 case '?':
                 case 'h':
                 {
@@ -2682,9 +4927,69 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
         }
     }
 
-    gcfGetDevices(gcf);
+#ifdef USE_NET
+    NET_SetClientLimits(gcf->netMaxClients, gcf->netClientTtl);
+
+    /* after all options, -n may follow -p */
+    if (gcf->netPort && NET_Init(gcf->netInterface, gcf->netPort) != 1)
+    {
+        PL_Printf(DBG_INFO, "failed to start network server\n");
+        return GCF_FAILED;
+    }
+#endif
+
+    if (gcf->devpath[0] != '\0' && gcf->task != T_LIST && gcf->task != T_INVENTORY && gcf->task != T_HELP)
+    {
+        if (gcfResolveDevice(gcf) == 0)
+        {
+            PL_Printf(DBG_INFO, "device %s not found\n", gcf->devpath);
+            return GCF_FAILED;
+        }
+    }
+
     gcf->devType = gcfGetDeviceType(gcf);
 
+#ifdef USE_SNIFF
+    if (gcf->task == T_SNIFF && gcf->sniffRingPrefix)
+    {
+        if (SNIFF_RingInit(&gcf->sniffRing, gcf->sniffRingPrefix, gcf->sniffRingSeconds, gcf->sniffRingSize) == 0)
+        {
+            PL_Printf(DBG_INFO, "failed to setup sniffer ring\n");
+            return GCF_FAILED;
+        }
+    }
+
+    if (gcf->task == T_SNIFF && gcf->sniffJsonPath)
+    {
+        if (SNIFF_JsonInit(&gcf->sniffJson, gcf->sniffJsonPath) == 0)
+        {
+            PL_Printf(DBG_INFO, "failed to open %s\n", gcf->sniffJsonPath);
+            return GCF_FAILED;
+        }
+    }
+
+    if (gcf->task == T_SNIFF && gcf->sniffShmName)
+    {
+        if (SNIFF_ShmInit(&gcf->sniffShm, gcf->sniffShmName) == 0)
+        {
+            PL_Printf(DBG_INFO, "failed to setup shared memory %s\n", gcf->sniffShmName);
+            return GCF_FAILED;
+        }
+    }
+#endif
+
+    if (gcf->tracePrefix)
+        TRACE_Init(&gcf->trace, gcf->tracePrefix);
+
+    if (gcf->statusName)
+    {
+        if (STATUS_Init(&gcf->status, gcf->statusName) == 0)
+        {
+            PL_Printf(DBG_INFO, "failed to setup shared memory %s\n", gcf->statusName);
+            return GCF_FAILED;
+        }
+    }
+
     if (gcf->task == T_PROGRAM)
     {
         if (gcf->devpath[0] == '\0')
@@ -2706,20 +5011,8 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
             gcf->maxTime += gcf->startTime;
         }
 
-        /* The /dev/ttyACM0 and similar doesn't tell if this is RaspBee II,
-           the fwVersion of the file is more specific.
-        */
-        if (gcf->devType == DEV_RASPBEE_1 &&
-            (gcf->file.fwVersion & FW_VERSION_PLATFORM_MASK) == FW_VERSION_PLATFORM_R21)
-        {
-            PL_Printf(DBG_DEBUG, "assume RaspBee II\n");
-            gcf->devType = DEV_RASPBEE_2;
-        }
-        else if (gcf->devType == DEV_RASPBEE_1 && gcf->file.gcfTargetAddress == 0x5000)
-        {
-            PL_Printf(DBG_DEBUG, "assume RaspBee II\n");
-            gcf->devType = DEV_RASPBEE_2;
-        }
+        gcfRefineDeviceType(gcf);
+        PL_EnableHotplug();
 
         gcf->state = ST_Program;
         ret = GCF_SUCCESS;
@@ -2732,6 +5025,14 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
             return GCF_FAILED;
         }
 
+#ifdef USE_NET
+        if (gcf->bridgeAddr && BRIDGE_Init(&gcf->bridge, gcf->bridgeAddr, gcf->bridgeMode) == 0)
+        {
+            PL_Printf(DBG_INFO, "failed to setup bridge on %s\n", gcf->bridgeAddr);
+            return GCF_FAILED;
+        }
+#endif
+
         gcf->state = ST_Connect;
         ret = GCF_SUCCESS;
     }
@@ -2744,10 +5045,25 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
             return GCF_FAILED;
         }
 
+        PL_EnableHotplug(); /* for reconnects */
         gcf->state = ST_SniffConnect;
         ret = GCF_SUCCESS;
     }
 #endif /* USE_SNIFF */
+#ifdef USE_NET
+    else if (gcf->task == T_SERVE)
+    {
+        if (gcf->netPort == 0)
+        {
+            PL_Printf(DBG_INFO, "missing -p argument\n");
+            return GCF_FAILED;
+        }
+
+        UI_Puts(gcf, "waiting for jobs\n");
+        gcf->state = ST_ServeIdle;
+        ret = GCF_SUCCESS;
+    }
+#endif /* USE_NET */
     else if (gcf->task == T_DUMP_FLASH)
     {
         if (gcf->devpath[0] == '\0')
@@ -2770,6 +5086,16 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
         gcf->state = ST_Reset;
         ret = GCF_SUCCESS;
     }
+    else if (gcf->task == T_RESET_FTDI)
+    {
+        gcf->state = ST_ResetFtdiAll;
+        ret = GCF_SUCCESS;
+    }
+    else if (gcf->task == T_INVENTORY)
+    {
+        gcf->state = ST_Inventory;
+        ret = GCF_SUCCESS;
+    }
     else if (gcf->task == T_HELP)
     {
         gcfPrintHelp();
@@ -2777,22 +5103,32 @@ static GCF_Status gcfProcessCommandline(GCF *gcf)
         ret = GCF_SUCCESS;
     }
 
+#ifdef USE_METRICS
+    if (ret == GCF_SUCCESS && gcf->metricsAddr && METRICS_Init(gcf->metricsAddr) == 0)
+    {
+        PL_Printf(DBG_INFO, "failed to setup metrics on %s\n", gcf->metricsAddr);
+        return GCF_FAILED;
+    }
+#endif
+
     return ret;
 }
 
-static void gcfCommandResetUart(void)
+static void gcfCommandResetUart(unsigned char timeout)
 {
-    const unsigned char cmd[] = {
+    unsigned char cmd[] = {
         CMD_WRITE_PARAMETER,
         0x03, // seq
         0x00, // status
         0x0C, 0x00, // frame length (12)
         0x05, 0x00, // buffer length (5)
         PARAM_WATCHDOG_TIMEOUT,
-        0x02, 0x00, 0x00, 0x00  // U32 timeout (2 seconds)
+        0x02, 0x00, 0x00, 0x00  // U32 timeout (seconds)
     };
 
-    PL_Printf(DBG_INFO, "send uart reset\n");
+    cmd[8] = timeout;
+
+    UI_Puts(&gcfLocal, "send uart reset\n");
 
     PROT_SendFlagged(cmd, sizeof(cmd));
 }
@@ -2829,7 +5165,7 @@ static void gcfCommandQueryStatus(void)
         0x00, 0x00, 0x00 // dummy bytes
     };
 
-    cmd[1] = gcfSeq++;
+    cmd[1] = GCF_NextSeq();
 
     PROT_SendFlagged(cmd, sizeof(cmd));
 }
@@ -2855,7 +5191,7 @@ static void gcfCommandReadFlash(unsigned addr, unsigned size)
     U_bstream_init(&bs, &cmd[0], sizeof(cmd));
 
     U_bstream_put_u8(&bs, CMD_READ_REGISTER);
-    U_bstream_put_u8(&bs, gcfSeq++);
+    U_bstream_put_u8(&bs, GCF_NextSeq());
     U_bstream_put_u8(&bs, 0); // status
     U_bstream_put_u16_le(&bs, 13); // frame length
     U_bstream_put_u16_le(&bs, 6); // payload length
@@ -30,7 +30,10 @@ typedef enum
     EV_RX_PKG_DATA = 41,
     EV_CONNECTED = 200,
     EV_DISCONNECTED = 203,
-    EV_TIMEOUT = 333
+    EV_DEVICE_ADDED = 204, /* serial device hotplug, if supported by the platform */
+    EV_TIMEOUT = 333,
+    EV_TRIGGER = 400,
+    EV_INPUT_CLOSED = 401
 } Event;
 
 typedef enum
@@ -64,6 +67,13 @@ typedef struct GCF_File_t GCF_File;
 /* TODO detect old 32-bit only compilers */
 typedef unsigned long long PL_time_t;
 
+/* OS file, socket or device handle */
+#ifdef PL_WIN
+typedef unsigned long long PL_Handle;
+#else
+typedef int PL_Handle;
+#endif
+
 
 #ifdef NDEBUG
   #define Assert(c) ((void)0)
@@ -85,9 +95,18 @@ void GCF_Received(GCF *gcf, const unsigned char *data, int len);
 /*! Called from platform layer for keyboard input. */
 void GCF_KeyboardInput(GCF *gcf, unsigned long codepoint);
 void GCF_HandleEvent(GCF *gcf, Event event);
+/*! Called from platform layer when a handle added by PL_AddPollHandle() is readable. */
+void GCF_HandleReadable(GCF *gcf, PL_Handle handle);
+/*! Called from platform layer when serial device \p path was plugged in,
+    dispatches EV_DEVICE_ADDED. */
+void GCF_DeviceAdded(GCF *gcf, const char *path);
 
 int GCF_ParseFile(GCF_File *file);
+/*! Returns the next sequence number for serial protocol requests. */
+unsigned char GCF_NextSeq(void);
 void gcfDebugHex(GCF *gcf, const char *msg, const unsigned char *data, unsigned size);
+/*! Called from platform layer with the bytes written to the device. */
+void GCF_TraceSent(GCF *gcf, const unsigned char *data, unsigned len);
 void put_hex(unsigned char ch, char *buf);
 
 /* Platform specific declarations.
@@ -98,6 +117,9 @@ void put_hex(unsigned char ch, char *buf);
 /*! Returns a monotonic time in milliseconds. */
 PL_time_t PL_Time(void);
 
+/*! Returns the wall clock time in milliseconds since 1970-01-01 UTC. */
+PL_time_t PL_WallTime(void);
+
 /*! Lets the programm sleep for \p ms milliseconds. */
 void PL_MSleep(unsigned long ms);
 
@@ -138,17 +160,126 @@ GCF_Status PL_Connect(const char *path, PL_Baudrate baudrate);
 /*! Closed the serial port connection. */
 void PL_Disconnect(void);
 
+/*! Opens an additional serial port next to the PL_Connect() one, used to
+    query many devices at once. Received data is read with PL_SerialRead()
+    once GCF_HandleReadable() reports the handle, see PL_AddPollHandle().
+
+    \returns the handle or 0 on failure.
+ */
+PL_Handle PL_SerialOpen(const char *path, PL_Baudrate baudrate);
+/*! \returns number of bytes read, or -1 on error or when the device is gone. */
+int PL_SerialRead(PL_Handle handle, unsigned char *buf, unsigned size);
+int PL_SerialWrite(PL_Handle handle, const unsigned char *data, unsigned len);
+void PL_SerialClose(PL_Handle handle);
+
 /*! Shuts down platform layer (ends main loop). */
 void PL_ShutDown(void);
 
+/*! Runs the main loop against the recording \p path instead of the device,
+    see replay.h. Must be called before PL_Time() is used.
+
+    \param realtime - 1 to replay at recorded speed, 0 as fast as possible.
+    \returns 1 on success, 0 if replay isn't supported or the file is invalid.
+ */
+int PL_StartReplay(const char *path, int realtime);
+
 /*! Executes a MCU reset for ConBee I via FTDI CBUS0 reset. */
 int PL_ResetFTDI(int num, const char *serialnum);
 
-/*! Executes a MCU reset for RaspBee I / II via GPIO17 reset pin. */
-int PL_ResetRaspBee(void);
+/*! Resets several ConBee I with one round of CBUS0 toggles.
+
+    \returns the number of devices reset, or < 0 on failure.
+ */
+int PL_ResetFTDIDevices(const char *const *serialnums, unsigned count);
+
+/*! Executes a MCU reset for RaspBee I / II via GPIO17 reset pin.
+
+    \p gpiochip and \p line select another reset pin, NULL for the default.
+ */
+int PL_ResetRaspBee(const char *gpiochip, unsigned line);
 
 int PL_ReadFile(const char *path, unsigned char *buf, unsigned long buflen);
 
+typedef PL_Handle PL_File;
+
+#define PL_FILE_WRITE  1 /* create or truncate */
+#define PL_FILE_APPEND 2 /* create or append */
+
+/*! Opens a file for writing, the \p path "-" refers to stdout.
+
+    \returns a file handle or 0 on failure.
+ */
+PL_File PL_FileOpen(const char *path, int mode);
+int PL_FileWrite(PL_File file, const void *data, unsigned long len);
+void PL_FileClose(PL_File file);
+/*! Replaces the file at \p path with \p data, concurrent readers see either
+    the old or the new content, never a partial one.
+
+    \returns 1 on success, 0 on failure.
+ */
+int PL_ReplaceFile(const char *path, const void *data, unsigned long len);
+
+/*! Gets the path of file \p name in the per user cache directory.
+
+    \returns 1 on success, 0 if caching isn't supported.
+ */
+int PL_GetCachePath(const char *name, char *buf, unsigned size);
+
+/*! Identifies the device node at \p path, changes when the node is
+    recreated, e.g. after the device was unplugged.
+
+    \returns 1 on success, 0 if \p path isn't a device node.
+ */
+int PL_GetDeviceNodeId(const char *path, unsigned long long *id);
+
+/*! Starts watching for serial device hotplug, see GCF_DeviceAdded().
+    Only needed by tasks which wait for the device to re-enumerate,
+    no-op if the platform doesn't support it.
+ */
+void PL_EnableHotplug(void);
+
+/*! Creates or opens the named shared memory region \p name of \p size bytes.
+
+    \returns pointer to the mapped memory or 0 on failure.
+ */
+void *PL_SharedMemoryOpen(const char *name, unsigned long size);
+void PL_SharedMemoryClose(void *mem, unsigned long size);
+
+/*! Allocates \p size bytes of zeroed memory which stay valid until exit.
+    For large optional buffers, which would otherwise be static storage.
+
+    \returns pointer to the memory or 0 on failure.
+ */
+void *PL_MemoryAlloc(unsigned long size);
+
+/* Store ordering for data read by other processes from shared memory. */
+#if defined(__GNUC__) || defined(__clang__)
+  #define SHM_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+  #define SHM_FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+  #include <intrin.h>
+  #if defined(_M_ARM64)
+    #define SHM_FENCE_RELEASE() __dmb(_ARM64_BARRIER_ISH)
+  #else
+    /* x86 doesn't reorder stores, only the compiler may */
+    #define SHM_FENCE_RELEASE() _ReadWriteBarrier()
+  #endif
+  /* not relying on /volatile:ms, which isn't the default on ARM */
+  #define SHM_STORE_RELEASE(p, v) do { SHM_FENCE_RELEASE(); *(p) = (v); } while (0)
+#else
+  #define SHM_STORE_RELEASE(p, v) (*(p) = (v))
+  #define SHM_FENCE_RELEASE() ((void)0)
+#endif
+
+/*! Adds \p handle to the main loop, GCF_HandleReadable() is called when it
+    has data to read.
+
+    \returns 1 on success, 0 when no slot is left or the platform
+    doesn't support it (only POSIX does).
+ */
+int PL_AddPollHandle(PL_Handle handle);
+void PL_RemovePollHandle(PL_Handle handle);
+
 
 /* Terminal printing and logging */
 
@@ -176,6 +307,8 @@ typedef enum
 void PL_Print(const char *line);
 
 void PL_Printf(DebugLevel level, const char *format, ...);
+/*! Writes PL_Printf() messages to stderr, keeps stdout for machine readable output. */
+void PL_SetPrintStderr(int enable);
 
 void UI_GetWinSize(unsigned *w, unsigned *h);
 void UI_SetCursor(unsigned x, unsigned y);
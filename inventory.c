@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "inventory.h"
+#include "buffer_helper.h"
+#include "u_mem.h"
+
+static void invClose(INV_Device *d)
+{
+    if (d->handle == 0)
+        return;
+
+    PL_RemovePollHandle(d->handle);
+    PL_SerialClose(d->handle);
+    d->handle = 0;
+}
+
+static void invPacket(void *user, const unsigned char *data, unsigned len)
+{
+    INV_Device *d;
+
+    d = (INV_Device*)user;
+
+    if (d->status != INV_STATUS_PENDING)
+        return;
+
+    if (data[0] == CMD_FIRMWARE_VERSION && len >= 9 && data[2] == CMD_STATUS_SUCCESS)
+    {
+        get_u32_le(&data[5], &d->fwVersion);
+        d->status = INV_STATUS_FIRMWARE;
+    }
+    else if (data[0] == BTL_MAGIC && len >= 10 && data[1] == BTL_ID_RESPONSE)
+    {
+        get_u32_le(&data[2], &d->btlVersion);
+        get_u32_le(&data[6], &d->appCrc);
+        d->status = INV_STATUS_BOOTLOADER;
+    }
+}
+
+void INV_Reset(INV_State *inv)
+{
+    INV_End(inv);
+    inv->count = 0;
+    inv->pending = 0;
+}
+
+int INV_Query(INV_State *inv, const Device *dev)
+{
+    unsigned n;
+    INV_Device *d;
+    unsigned char buf[64];
+    unsigned char cmd[9];
+
+    if (inv->count == INV_MAX_DEVICES)
+        return 0;
+
+    d = &inv->devices[inv->count++];
+    U_bzero(d, sizeof(*d));
+    d->dev = dev;
+    d->status = INV_STATUS_OPEN_FAILED;
+
+    d->handle = PL_SerialOpen(&dev->path[0], dev->baudrate);
+    if (d->handle == 0)
+        return 1;
+
+    if (PL_AddPollHandle(d->handle) != 1)
+    {
+        PL_SerialClose(d->handle);
+        d->handle = 0;
+        return 1;
+    }
+
+    cmd[0] = CMD_FIRMWARE_VERSION;
+    cmd[1] = GCF_NextSeq();
+    cmd[2] = 0x00; /* status */
+    cmd[3] = 0x09; /* frame length */
+    cmd[4] = 0x00;
+    cmd[5] = cmd[6] = cmd[7] = cmd[8] = 0x00;
+
+    n = PROT_EncodeFlagged(cmd, sizeof(cmd), &buf[0], sizeof(buf));
+
+    cmd[0] = BTL_MAGIC;
+    cmd[1] = BTL_ID_REQUEST;
+    n += PROT_EncodeFlagged(cmd, 2, &buf[n], sizeof(buf) - n);
+
+    if (PL_SerialWrite(d->handle, &buf[0], n) != (int)n)
+    {
+        invClose(d);
+        return 1;
+    }
+
+    d->status = INV_STATUS_PENDING;
+    inv->pending++;
+
+    return 1;
+}
+
+int INV_Readable(INV_State *inv, PL_Handle handle)
+{
+    int n;
+    unsigned i;
+    INV_Device *d;
+    unsigned char buf[256];
+
+    for (i = 0; i < inv->count; i++)
+    {
+        d = &inv->devices[i];
+
+        if (d->handle == 0 || d->handle != handle)
+            continue;
+
+        n = PL_SerialRead(handle, &buf[0], sizeof(buf));
+
+        if (n > 0)
+            PROT_DecodeFlagged(&d->rx, &buf[0], (unsigned)n, invPacket, d);
+
+        if (n < 0 && d->status == INV_STATUS_PENDING)
+            d->status = INV_STATUS_NO_RESPONSE;
+
+        if (d->status != INV_STATUS_PENDING)
+        {
+            invClose(d);
+            inv->pending--;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
+
+int INV_Done(const INV_State *inv)
+{
+    return inv->pending == 0;
+}
+
+void INV_End(INV_State *inv)
+{
+    unsigned i;
+    INV_Device *d;
+
+    for (i = 0; i < inv->count; i++)
+    {
+        d = &inv->devices[i];
+
+        if (d->status == INV_STATUS_PENDING)
+            d->status = INV_STATUS_NO_RESPONSE;
+
+        invClose(d);
+    }
+
+    inv->pending = 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include "gcf.h"
+#include "protocol.h"
+
+/* Inventory scan
+
+   Opens the serial ports of up to INV_MAX_DEVICES devices at once and
+   sends each a CMD_FIRMWARE_VERSION request and a V3 bootloader
+   BTL_ID_REQUEST. Running firmware answers the first, a stick sitting
+   in the bootloader the second. The caller runs further rounds when more
+   devices are attached, a round ends after INV_TIMEOUT milliseconds or
+   when all devices have answered.
+*/
+#define INV_MAX_DEVICES 64
+#define INV_TIMEOUT     500
+
+#define INV_STATUS_PENDING     0
+#define INV_STATUS_FIRMWARE    1
+#define INV_STATUS_BOOTLOADER  2
+#define INV_STATUS_NO_RESPONSE 3
+#define INV_STATUS_OPEN_FAILED 4
+
+typedef struct INV_Device
+{
+    const Device *dev;
+    PL_Handle handle;
+    int status;
+    unsigned long fwVersion;
+    unsigned long btlVersion;
+    unsigned long appCrc;
+    PROT_RxState rx;
+} INV_Device;
+
+typedef struct INV_State
+{
+    unsigned count;
+    unsigned pending;
+    INV_Device devices[INV_MAX_DEVICES];
+} INV_State;
+
+/*! Starts a new round. */
+void INV_Reset(INV_State *inv);
+/*! Opens \p dev and sends the queries.
+
+    \returns 0 if the round is full, 1 otherwise (also when opening failed).
+ */
+int INV_Query(INV_State *inv, const Device *dev);
+/*! \returns 1 if \p handle belongs to a queried device and was processed. */
+int INV_Readable(INV_State *inv, PL_Handle handle);
+/*! \returns 1 when no device of the round is waiting for an answer. */
+int INV_Done(const INV_State *inv);
+/*! Closes all ports, unanswered devices get INV_STATUS_NO_RESPONSE. */
+void INV_End(INV_State *inv);
+
+#endif /* INVENTORY_H */
@@ -11,204 +11,300 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <unistd.h>
 #include "gcf.h"
 #include "u_sstream.h"
+#include "u_strlen.h"
 #include "u_mem.h"
 
 
-/*  Query USB info via udevadm
-    This works also when /dev/by-id .. is symlinks aren't available
+/* Reads sysfs attribute \p dir/\p attr into \p buf without trailing newline.
 
-    udevadm info --name=/dev/ttyACM0
+   \returns length of the value or -1 if not available.
 */
-static int query_udevadm(Device *dev, Device *end)
+static int sysfs_read_attr(const char *dir, const char *attr, char *buf, unsigned size)
 {
-    FILE *f;
-    size_t n;
+    int fd;
+    ssize_t n;
     U_SStream ss;
+    char path[PATH_MAX];
+
+    U_sstream_init(&ss, &path[0], sizeof(path));
+    U_sstream_put_str(&ss, dir);
+    U_sstream_put_str(&ss, "/");
+    U_sstream_put_str(&ss, attr);
+
+    if (ss.status != U_SSTREAM_OK)
+        return -1;
+
+    fd = open(ss.str, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    n = read(fd, buf, size - 1);
+    close(fd);
+
+    if (n < 0)
+        return -1;
+
+    for (; n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r'); n--)
+        ;
+
+    buf[n] = '\0';
+    return (int)n;
+}
+
+/* Walks up from \p dir to the USB device directory which has idVendor,
+   \p dir is modified in place and \p buf receives the vendor id.
+
+   \returns 1 if found within \p levels
+*/
+static int sysfs_usb_device_dir(char *dir, unsigned levels, char *buf, unsigned size)
+{
+    unsigned i;
+    unsigned level;
+
+    for (level = 0; level < levels; level++)
+    {
+        if (sysfs_read_attr(dir, "idVendor", buf, size) == 4)
+            return 1;
+
+        for (i = U_strlen(dir); i > 1 && dir[i - 1] != '/'; i--)
+            ;
+
+        dir[i > 1 ? i - 1 : 1] = '\0';
+    }
+
+    return 0;
+}
+
+/* Reads the serial number of USB device \p usbdir in the same format as
+   udev ID_USB_SERIAL_SHORT, without ':' in hex strings like 40:4C:CA:42:8B:50.
+*/
+static void sysfs_usb_serial(const char *usbdir, char *serial, unsigned size)
+{
+    int n;
     char ch;
-    char buf[4096 * 4];
-    long udevadm_version;
     unsigned i;
-    unsigned dev_major;
-    unsigned usb_vendor;
+    unsigned pos;
+    char buf[128];
 
-    Device *dev_cur;
-    DIR *dir;
-    struct dirent *entry;
-    struct stat statbuf;
+    n = sysfs_read_attr(usbdir, "serial", &buf[0], sizeof(buf));
+    for (pos = 0, i = 0; n > 0 && pos < (unsigned)n && i + 1 < size; pos++)
+    {
+        ch = buf[pos];
+        if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9'))
+            serial[i++] = ch;
+        else if (ch != ':')
+            break;
+    }
+    serial[i] = '\0';
+}
 
-    dev_cur = dev;
-    udevadm_version = 0;
-    /* check if udevadm is available */
-    f = popen("udevadm --version", "r");
-    if (f)
+/* \returns the length of the UTF-8 sequence at \p str, 0 if it is invalid. */
+static unsigned utf8_sequence_length(const unsigned char *str)
+{
+    unsigned i;
+    unsigned len;
+
+    if      ((str[0] & 0xE0) == 0xC0) { len = 2; }
+    else if ((str[0] & 0xF0) == 0xE0) { len = 3; }
+    else if ((str[0] & 0xF8) == 0xF0) { len = 4; }
+    else                              { return 0; }
+
+    for (i = 1; i < len; i++)
     {
-        n = fread(&buf[0], 1, sizeof(buf) - 1, f);
-        if (n > 0 && n < 10)
+        if ((str[i] & 0xC0) != 0x80)
+            return 0;
+    }
+
+    return len;
+}
+
+/* Reads the product name of USB device \p usbdir in the same format as
+   udev ID_USB_MODEL: whitespace is trimmed and each run of it becomes one
+   '_', alphanumerics, valid UTF-8 and "#+-.:=@_" are kept, everything
+   else becomes '_'. E.g. "USB JTAG/serial debug unit" -> USB_JTAG_serial_debug_unit
+
+    \returns the length of \p name.
+*/
+static unsigned sysfs_usb_model(const char *usbdir, char *name, unsigned size)
+{
+    int n;
+    unsigned char ch;
+    unsigned i;
+    unsigned j;
+    unsigned len;
+    unsigned pos;
+    char buf[128];
+
+    n = sysfs_read_attr(usbdir, "product", &buf[0], sizeof(buf));
+
+    for (; n > 0 && (buf[n - 1] == ' ' || buf[n - 1] == '\t'); n--)
+        ;
+
+    for (pos = 0; n > 0 && pos < (unsigned)n && (buf[pos] == ' ' || buf[pos] == '\t'); pos++)
+        ;
+
+    for (i = 0; n > 0 && pos < (unsigned)n && i + 1 < size; pos++)
+    {
+        ch = (unsigned char)buf[pos];
+
+        if (ch == ' ' || ch == '\t')
+        {
+            for (; buf[pos + 1] == ' ' || buf[pos + 1] == '\t'; pos++)
+                ;
+            name[i++] = '_';
+        }
+        else if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+                 (ch != '\0' && strchr("#+-.:=@_", ch)))
         {
-            buf[n] = '\0';
-            U_sstream_init(&ss, &buf[0], (unsigned)n);
-            udevadm_version = U_sstream_get_long(&ss);
-            if (ss.status != U_SSTREAM_OK)
-                udevadm_version = 0;
+            name[i++] = (char)ch;
+        }
+        else if (ch >= 0x80 && (len = utf8_sequence_length((unsigned char*)&buf[pos])) != 0)
+        {
+            if (i + len >= size)
+                break;
+
+            for (j = 0; j < len; j++)
+                name[i++] = buf[pos + j];
+            pos += len - 1;
+        }
+        else
+        {
+            name[i++] = '_';
         }
-        pclose(f);
     }
+    name[i] = '\0';
+
+    return i;
+}
 
-    if (udevadm_version == 0)
+/*! Gets the serial number of the USB device \p syspath belongs to, e.g.
+    /sys/bus/gpio/devices/gpiochip3 of a FTDI CBUS GPIO controller.
+
+    \returns 1 on success
+ */
+int plGetLinuxUSBSerial(const char *syspath, char *serial, unsigned size)
+{
+    char buf[8];
+    char usbdir[PATH_MAX];
+
+    serial[0] = '\0';
+
+    if (!realpath(syspath, usbdir) || !sysfs_usb_device_dir(usbdir, 4, &buf[0], sizeof(buf)))
         return 0;
 
-    dir = opendir("/dev");
+    sysfs_usb_serial(usbdir, serial, size);
+
+    return serial[0] != '\0';
+}
+
+/*  Query USB info from sysfs
+    This works also when /dev/serial/by-id/.. symlinks aren't available
+
+    /sys/class/tty/ttyACM0/device points to the USB interface, for
+    USB serial converters (ttyUSB) to the port below the interface.
+    The USB device with idVendor, product and serial is a parent of it.
+*/
+static int query_sysfs(Device *dev, Device *end)
+{
+    unsigned i;
+    unsigned usb_vendor;
+    U_SStream ss;
+    Device *dev_cur;
+    DIR *dir;
+    struct dirent *entry;
+    char buf[128];
+    char usbdir[PATH_MAX];
+
+    dev_cur = dev;
+
+    dir = opendir("/sys/class/tty");
 
     if (!dir)
         return 0;
 
     while ((entry = readdir(dir)) != NULL)
     {
-        if (entry->d_type != DT_CHR)
-            continue;
-
         if (dev_cur == end)
             break;
 
-        U_bzero(dev_cur, sizeof(*dev_cur));
+        if (strncmp(entry->d_name, "ttyACM", 6) != 0 && strncmp(entry->d_name, "ttyUSB", 6) != 0)
+            continue;
 
-        U_sstream_init(&ss, &dev_cur->path[0], sizeof(dev_cur->path));
-        U_sstream_put_str(&ss, "/dev/");
+        U_sstream_init(&ss, &buf[0], sizeof(buf));
+        U_sstream_put_str(&ss, "/sys/class/tty/");
         U_sstream_put_str(&ss, &entry->d_name[0]);
+        U_sstream_put_str(&ss, "/device");
 
-        if (stat(ss.str, &statbuf) != 0)
+        if (ss.status != U_SSTREAM_OK || !realpath(ss.str, usbdir))
             continue;
 
-        dev_major = statbuf.st_rdev >> 8;
-        if (dev_major != 166 && dev_major != 188)
+        if (!sysfs_usb_device_dir(usbdir, 3, &buf[0], sizeof(buf)))
             continue;
 
-        U_sstream_init(&ss, &buf[0], sizeof(buf));
-        U_sstream_put_str(&ss, "udevadm info --name=");
+        usb_vendor = 0;
+        if      (strcmp(buf, "1cf1") == 0) { usb_vendor = 0x1cf1; }
+        else if (strcmp(buf, "0403") == 0) { usb_vendor = 0x0403; }
+        else if (strcmp(buf, "1a86") == 0) { usb_vendor = 0x1a86; }
+        else if (strcmp(buf, "303a") == 0) { usb_vendor = 0x303a; }
+        else    { continue; }
+
+        U_bzero(dev_cur, sizeof(*dev_cur));
+
+        U_sstream_init(&ss, &dev_cur->path[0], sizeof(dev_cur->path));
         U_sstream_put_str(&ss, "/dev/");
         U_sstream_put_str(&ss, &entry->d_name[0]);
 
-        f = popen(ss.str, "r");
-        if (f)
-        {
-            usb_vendor = 0;
-            dev_cur->serial[0] = '\0';
-            dev_cur->name[0] = '\0';
+        sysfs_usb_serial(usbdir, &dev_cur->serial[0], sizeof(dev_cur->serial));
 
-            n = fread(&buf[0], 1, sizeof(buf) - 1, f);
-            pclose(f);
+        i = sysfs_usb_model(usbdir, &dev_cur->name[0], sizeof(dev_cur->name));
 
-            if (n > 0 && n < sizeof(buf) - 1)
+        {
+            U_SStream s2;
+            U_sstream_init(&s2, dev_cur->name, i);
+
+            if (U_sstream_starts_with(&s2, "ConBee_III"))
             {
-                buf[n] = '\0';
-                U_sstream_init(&ss, &buf[0], (unsigned)n);
-                while (U_sstream_find(&ss, "E: ") && U_sstream_remaining(&ss) > 8)
-                {
-                    ss.pos += 3;
-                    if (U_sstream_starts_with(&ss, "ID_USB_VENDOR_ID=") && U_sstream_find(&ss, "="))
-                    {
-                        ss.pos += 1;
-                        if      (U_sstream_starts_with(&ss, "1cf1")) { usb_vendor = 0x1cf1; }
-                        else if (U_sstream_starts_with(&ss, "0403")) { usb_vendor = 0x0403; }
-                        else if (U_sstream_starts_with(&ss, "1a86")) { usb_vendor = 0x1a86; }
-                        else if (U_sstream_starts_with(&ss, "303a")) { usb_vendor = 0x303a; }
-                    }
-                    else if (U_sstream_starts_with(&ss, "ID_USB_SERIAL_SHORT=") && U_sstream_find(&ss, "="))
-                    {
-                        i = 0;
-                        ss.pos += 1;
-                        dev_cur->serial[0] = '\0';
-
-                        for (;ss.pos < ss.len && i + 1 < sizeof(dev_cur->serial); ss.pos++)
-                        {
-                            ch = U_sstream_peek_char(&ss);
-                            if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9'))
-                            {
-                                dev_cur->serial[i] = ch;
-                                dev_cur->serial[i + 1] = '\0';
-                                i++;
-                            }
-                            else if (ch == ':')
-                            {
-                                /* 40:4C:CA:42:8B:50 (ignore ':' in hex string) */
-                            }
-                            else
-                            {
-                                break;
-                            }
-                        }
-                    }
-                    else if (U_sstream_starts_with(&ss, "ID_USB_MODEL=") && U_sstream_find(&ss, "="))
-                    {
-                        i = 0;
-                        ss.pos += 1;
-                        dev_cur->name[0] = '\0';
-
-                        for (;ss.pos < ss.len && i + 1 < sizeof(dev_cur->name); ss.pos++, i++)
-                        {
-                            ch = U_sstream_peek_char(&ss);
-                            if (ch == ' ' || ch == '_' || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9'))
-                            {
-                                dev_cur->name[i] = ch;
-                                dev_cur->name[i + 1] = '\0';
-                            }
-                            else
-                            {
-                                break;
-                            }
-                        }
-
-                        {
-                            U_SStream s2;
-                            U_sstream_init(&s2, dev_cur->name, i);
-
-                            if (U_sstream_starts_with(&s2, "ConBee_III"))
-                            {
-                                dev_cur->baudrate = PL_BAUDRATE_115200;
-                            }
-                            else if (U_sstream_starts_with(&s2, "ConBee_II"))
-                            {
-                                dev_cur->baudrate = PL_BAUDRATE_115200;
-                            }
-                            else if (U_sstream_starts_with(&s2, "USB_JTAG_serial_debug_unit"))
-                            {
-                                dev_cur->baudrate = PL_BAUDRATE_115200; /* expressif (FLS-M) */
-                            }
-                        }
-                    }
-                }
+                dev_cur->baudrate = PL_BAUDRATE_115200;
             }
-
-            if (usb_vendor == 0x1a86)
+            else if (U_sstream_starts_with(&s2, "ConBee_II"))
             {
                 dev_cur->baudrate = PL_BAUDRATE_115200;
-                if (dev_cur->serial[0] == '\0')
-                {
-                    /* the CH340 chips don't have a serial? */
-                    dev_cur->serial[0] = '1';
-                    dev_cur->serial[1] = '\0';
-                }
             }
-            else if (usb_vendor == 0x303a)
+            else if (U_sstream_starts_with(&s2, "USB_JTAG_serial_debug_unit"))
             {
-                U_SStream s2;
-                U_sstream_init(&s2, dev_cur->name, sizeof(dev_cur->name));
-                U_sstream_put_str(&s2, "Espressif");
+                dev_cur->baudrate = PL_BAUDRATE_115200; /* expressif (FLS-M) */
             }
+        }
 
-            if (usb_vendor && dev_cur->serial[0] && dev_cur->name[0])
+        if (usb_vendor == 0x1a86)
+        {
+            dev_cur->baudrate = PL_BAUDRATE_115200;
+            if (dev_cur->serial[0] == '\0')
             {
-                U_memcpy(&dev_cur->stablepath[0], &dev_cur->path[0], sizeof(dev_cur->path));
-                dev_cur++;
+                /* the CH340 chips don't have a serial? */
+                dev_cur->serial[0] = '1';
+                dev_cur->serial[1] = '\0';
             }
         }
+        else if (usb_vendor == 0x303a)
+        {
+            U_SStream s2;
+            U_sstream_init(&s2, dev_cur->name, sizeof(dev_cur->name));
+            U_sstream_put_str(&s2, "Espressif");
+        }
 
+        if (dev_cur->serial[0] && dev_cur->name[0])
+        {
+            U_memcpy(&dev_cur->stablepath[0], &dev_cur->path[0], sizeof(dev_cur->path));
+            dev_cur++;
+        }
     }
 
     closedir(dir);
@@ -233,7 +329,7 @@ int plGetLinuxUSBDevices(Device *dev, Device *end)
     int result = 0;
     char buf[MAX_DEV_PATH_LENGTH];
 
-    result = query_udevadm(dev, end);
+    result = query_sysfs(dev, end);
     if (result > 0)
         return result;
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "gcf.h"
+#include "u_sstream.h"
+#include "u_mem.h"
+
+/* Reset via the GPIO character device v2 uAPI (Linux 5.10+), works
+   without libgpiod. The same ioctls are served by the gpio-sim module,
+   e.g. with --reset-gpio /dev/gpiochip2:17 against a simulated chip.
+*/
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+
+#define PL_GPIOCHIP_MAX_SCAN 20
+
+/* Opens the first gpiochip with a label starting with "pinctrl-". */
+static int plOpenPinctrlChip(void)
+{
+    int fd;
+    unsigned i;
+    char path[32];
+    U_SStream ss;
+    struct gpiochip_info info;
+
+    for (i = 0; i < PL_GPIOCHIP_MAX_SCAN; i++)
+    {
+        U_sstream_init(&ss, &path[0], sizeof(path));
+        U_sstream_put_str(&ss, "/dev/gpiochip");
+        U_sstream_put_long(&ss, (long)i);
+
+        fd = open(&path[0], O_RDWR | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+
+        U_bzero(&info, sizeof(info));
+
+        if (ioctl(fd, GPIO_GET_CHIPINFO_IOCTL, &info) == 0 && strncmp(info.label, "pinctrl-", 8) == 0)
+        {
+            PL_Printf(DBG_DEBUG, "gpiochip: %s, label: %s\n", &path[0], info.label);
+            return fd;
+        }
+
+        close(fd);
+    }
+
+    return -1;
+}
+
+static int plSetLineValue(int fd, int value)
+{
+    struct gpio_v2_line_values values;
+
+    U_bzero(&values, sizeof(values));
+    values.mask = 1;
+    values.bits = value ? 1 : 0;
+
+    return ioctl(fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+}
+
+/*! Pulls \p line of \p gpiochip low for 200 ms, then releases it as input.
+    Without \p gpiochip the RaspBee reset pin gpio17 of the pinctrl chip is used.
+
+    \returns 0 on success, -1 if the chip or line isn't available.
+ */
+int plResetGpioChip(const char *gpiochip, unsigned line)
+{
+    int ret;
+    int chipfd;
+    struct gpio_v2_line_request req;
+    struct gpio_v2_line_config config;
+
+    if (gpiochip)
+    {
+        chipfd = open(gpiochip, O_RDWR | O_CLOEXEC);
+    }
+    else
+    {
+        chipfd = plOpenPinctrlChip();
+        line = 17; /* https://pinout.xyz/pinout/raspbee */
+    }
+
+    if (chipfd == -1)
+        return -1;
+
+    U_bzero(&req, sizeof(req));
+    req.offsets[0] = line;
+    req.num_lines = 1;
+    U_memcpy(&req.consumer[0], "gcf", 4);
+    req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    req.config.num_attrs = 1;
+    req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    req.config.attrs[0].attr.values = 1; /* start high, reset is active low */
+    req.config.attrs[0].mask = 1;
+
+    ret = ioctl(chipfd, GPIO_V2_GET_LINE_IOCTL, &req);
+    close(chipfd);
+
+    if (ret == -1 || req.fd < 0)
+    {
+        PL_Printf(DBG_DEBUG, "gpiochip: failed to request line %u\n", line);
+        return -1;
+    }
+
+    ret = plSetLineValue(req.fd, 0);
+
+    if (ret == 0)
+    {
+        PL_MSleep(200);
+        ret = plSetLineValue(req.fd, 1);
+    }
+
+    /* hand the pin back as input like the libgpiod variants do */
+    U_bzero(&config, sizeof(config));
+    config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    ioctl(req.fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+
+    close(req.fd);
+
+    return ret == 0 ? 0 : -1;
+}
+
+#else /* kernel headers older than 5.10 */
+
+int plResetGpioChip(const char *gpiochip, unsigned line)
+{
+    (void)gpiochip;
+    (void)line;
+    return -1;
+}
+
+#endif /* GPIO_V2_GET_LINE_IOCTL */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021-2025 dresden elektronik ingenieurtechnik gmbh.
+ * Copyright (c) 2021-2026 dresden elektronik ingenieurtechnik gmbh.
  * All rights reserved.
  *
  * The software in this package is published under the terms of the BSD
@@ -12,6 +12,7 @@
 #include <dlfcn.h>
 #include <gpiod.h>
 #include <string.h>
+#include "u_sstream.h"
 #include "gcf.h"
 
 /* Implementation for libgpiod version < 2.x */
@@ -21,35 +22,59 @@
    /sys/devices/pci0000:00/0000:00:14.0/usb1/1-4/1-4.4/serial
 */
 
-typedef struct gpiod_chip_iter *(*pl_gpiod_chip_iter_new)(void);
-typedef struct gpiod_chip *(*pl_gpiod_chip_iter_next)(struct gpiod_chip_iter *iter);
-typedef const char *(*pl_gpiod_chip_name)(struct gpiod_chip *chip);
+/* libgpiod is loaded on first use and stays loaded until plExitLibGpiod().
+   The pinctrl and ftdi-cbus chips are opened once and cached, a chip of
+   an unplugged ConBee I becomes unusable, in that case the cache is
+   rebuilt and the reset tried once more.
+
+   The cache holds a chip for each ConBee I the device table can list
+   (MAX_DEVICES in gcf.c) plus the pinctrl chips. Lines are requested in
+   batches, so the open file descriptors stay well below the usual limit
+   of 1024.
+*/
+#define PL_GPIOD_MAX_CHIPS    (512 + 16)
+#define PL_GPIOD_MAX_SCAN     1024
+#define PL_GPIOD_TOGGLE_BATCH 64
+
+typedef struct gpiod_chip *(*pl_gpiod_chip_open_by_number)(unsigned int num);
+typedef void (*pl_gpiod_chip_close)(struct gpiod_chip *chip);
 typedef const char *(*pl_gpiod_chip_label)(struct gpiod_chip *chip);
 typedef struct gpiod_line *(*pl_gpiod_chip_get_line)(struct gpiod_chip *chip, unsigned int offset);
 typedef int (*pl_gpiod_line_request_output)(struct gpiod_line *line, const char *consumer, int default_val);
 typedef int (*pl_gpiod_line_request_input)(struct gpiod_line *line, const char *consumer);
 typedef int (*pl_gpiod_line_set_value)(struct gpiod_line *line, int value);
 typedef void (*pl_gpiod_line_release)(struct gpiod_line *line);
-typedef void (*pl_gpiod_chip_iter_free)(struct gpiod_chip_iter *iter);
+
+typedef struct
+{
+    struct gpiod_chip *chip;
+    int ftdi; /* ftdi-cbus, otherwise pinctrl */
+    char serial[MAX_DEV_SERIALNR_LENGTH]; /* USB serial number of ftdi-cbus */
+} PL_GpiodChip;
 
 static void* lib_gpiod_handle;
-static pl_gpiod_chip_iter_new        fn_gpiod_chip_iter_new;
-static pl_gpiod_chip_iter_next       fn_gpiod_chip_iter_next;
-static pl_gpiod_chip_iter_free       fn_gpiod_chip_iter_free;
-static pl_gpiod_chip_name            fn_gpiod_chip_name;
+static pl_gpiod_chip_open_by_number  fn_gpiod_chip_open_by_number;
+static pl_gpiod_chip_close           fn_gpiod_chip_close;
 static pl_gpiod_chip_label           fn_gpiod_chip_label;
 static pl_gpiod_chip_get_line        fn_gpiod_chip_get_line;
 static pl_gpiod_line_request_output  fn_gpiod_line_request_output;
-static pl_gpiod_line_request_input  fn_gpiod_line_request_input;
+static pl_gpiod_line_request_input   fn_gpiod_line_request_input;
 static pl_gpiod_line_set_value       fn_gpiod_line_set_value;
 static pl_gpiod_line_release         fn_gpiod_line_release;
 
+static int gpiod_chips_scanned;
+static unsigned gpiod_chip_count;
+static PL_GpiodChip gpiod_chips[PL_GPIOD_MAX_CHIPS];
+
+int plGetLinuxUSBSerial(const char *syspath, char *serial, unsigned size);
+
 static int plLoadLibGpiod(void);
 static int plUnloadLibGpiod(void);
 
 static int plLoadLibGpiod(void)
 {
-    Assert(lib_gpiod_handle == NULL);
+    if (lib_gpiod_handle)
+        return 0; /* already loaded */
 
     lib_gpiod_handle = dlopen("libgpiod.so", RTLD_LAZY);
     if (!lib_gpiod_handle)
@@ -58,10 +83,8 @@ static int plLoadLibGpiod(void)
         return -1;
     }
 
-    fn_gpiod_chip_iter_new = (pl_gpiod_chip_iter_new)dlsym(lib_gpiod_handle, "gpiod_chip_iter_new");
-    fn_gpiod_chip_iter_next = (pl_gpiod_chip_iter_next)dlsym(lib_gpiod_handle, "gpiod_chip_iter_next");
-    fn_gpiod_chip_iter_free = (pl_gpiod_chip_iter_free)dlsym(lib_gpiod_handle, "gpiod_chip_iter_free");
-    fn_gpiod_chip_name = (pl_gpiod_chip_name)dlsym(lib_gpiod_handle, "gpiod_chip_name");
+    fn_gpiod_chip_open_by_number = (pl_gpiod_chip_open_by_number)dlsym(lib_gpiod_handle, "gpiod_chip_open_by_number");
+    fn_gpiod_chip_close = (pl_gpiod_chip_close)dlsym(lib_gpiod_handle, "gpiod_chip_close");
     fn_gpiod_chip_label = (pl_gpiod_chip_label)dlsym(lib_gpiod_handle, "gpiod_chip_label");
     fn_gpiod_chip_get_line = (pl_gpiod_chip_get_line)dlsym(lib_gpiod_handle, "gpiod_chip_get_line");
     fn_gpiod_line_request_output = (pl_gpiod_line_request_output)dlsym(lib_gpiod_handle, "gpiod_line_request_output");
@@ -69,10 +92,8 @@ static int plLoadLibGpiod(void)
     fn_gpiod_line_set_value = (pl_gpiod_line_set_value)dlsym(lib_gpiod_handle, "gpiod_line_set_value");
     fn_gpiod_line_release = (pl_gpiod_line_release)dlsym(lib_gpiod_handle, "gpiod_line_release");
 
-    if (!fn_gpiod_chip_iter_new ||
-        !fn_gpiod_chip_iter_next ||
-        !fn_gpiod_chip_iter_free ||
-        !fn_gpiod_chip_name ||
+    if (!fn_gpiod_chip_open_by_number ||
+        !fn_gpiod_chip_close ||
         !fn_gpiod_chip_label ||
         !fn_gpiod_chip_get_line ||
         !fn_gpiod_line_request_output ||
@@ -87,18 +108,30 @@ static int plLoadLibGpiod(void)
     return 0;
 }
 
+static void plCloseGpiodChips(void)
+{
+    unsigned i;
+
+    for (i = 0; i < gpiod_chip_count; i++)
+        fn_gpiod_chip_close(gpiod_chips[i].chip);
+
+    gpiod_chip_count = 0;
+    gpiod_chips_scanned = 0;
+}
+
 static int plUnloadLibGpiod(void)
 {
     Assert(lib_gpiod_handle != NULL);
 
     if (lib_gpiod_handle)
     {
+        if (fn_gpiod_chip_close)
+            plCloseGpiodChips();
+
         dlclose(lib_gpiod_handle);
         lib_gpiod_handle = NULL;
-        fn_gpiod_chip_iter_new = NULL;
-        fn_gpiod_chip_iter_next = NULL;
-        fn_gpiod_chip_iter_free = NULL;
-        fn_gpiod_chip_name = NULL;
+        fn_gpiod_chip_open_by_number = NULL;
+        fn_gpiod_chip_close = NULL;
         fn_gpiod_chip_label = NULL;
         fn_gpiod_chip_get_line = NULL;
         fn_gpiod_line_request_output = NULL;
@@ -111,132 +144,189 @@ static int plUnloadLibGpiod(void)
     return -1;
 }
 
-int plResetRaspBeeLibGpiod(void)
+static void plScanGpiodChips(void)
 {
-    int ret = -1;
-    struct gpiod_chip *chip;
-    struct gpiod_chip_iter *iter;
-    struct gpiod_line *line;
-    const char *name;
+    unsigned i;
     const char *label;
+    struct gpiod_chip *chip;
+    PL_GpiodChip *c;
+    char path[64];
+    U_SStream ss;
 
-    if (plLoadLibGpiod() != 0)
-    {
-        return -1;
-    }
-
-    iter = fn_gpiod_chip_iter_new();
+    plCloseGpiodChips();
 
-    if (!iter)
+    for (i = 0; i < PL_GPIOD_MAX_SCAN && gpiod_chip_count < PL_GPIOD_MAX_CHIPS; i++)
     {
-        plUnloadLibGpiod();
-        return -2;
-    }
+        chip = fn_gpiod_chip_open_by_number(i);
+        if (!chip)
+            continue;
 
-    while ((chip = fn_gpiod_chip_iter_next(iter)) != NULL)
-    {
-        name = fn_gpiod_chip_name(chip);
         label = fn_gpiod_chip_label(chip);
 
-        if (!label || strncmp(label, "pinctrl-", 8) != 0)
+        if (!label || (strncmp(label, "pinctrl-", 8) != 0 && strcmp(label, "ftdi-cbus") != 0))
         {
+            fn_gpiod_chip_close(chip);
             continue;
         }
 
-        /* https://pinout.xyz/pinout/raspbee
-           RaspBee reset pin on gpio17
-        */
-        line = fn_gpiod_chip_get_line(chip, 17);
+        c = &gpiod_chips[gpiod_chip_count++];
+        c->chip = chip;
+        c->ftdi = label[0] == 'f';
+        c->serial[0] = '\0';
 
-        if (!line)
+        if (c->ftdi)
         {
-            continue;
+            U_sstream_init(&ss, &path[0], sizeof(path));
+            U_sstream_put_str(&ss, "/sys/bus/gpio/devices/gpiochip");
+            U_sstream_put_long(&ss, (long)i);
+            plGetLinuxUSBSerial(ss.str, &c->serial[0], sizeof(c->serial));
         }
 
-        PL_Printf(DBG_DEBUG, "gpiod chip: name: %s, label: %s\n", name, label);
+        PL_Printf(DBG_DEBUG, "gpiod chip: gpiochip%u, label: %s %s\n", i, label, c->serial);
+    }
 
-        ret = fn_gpiod_line_request_output(line, "gcf", 1);
-        Assert(ret != -1);
+    gpiod_chips_scanned = 1;
+}
 
-        ret = fn_gpiod_line_set_value(line, 0);
-        Assert(ret != -1);
+/* Selects the ftdi-cbus chips of \p serials. When sysfs doesn't tell the
+   serial number a single reset uses the first chip.
+*/
+static unsigned plSelectFtdiChips(const char *const *serials, unsigned count, PL_GpiodChip **sel)
+{
+    unsigned i;
+    unsigned j;
+    unsigned n;
+    PL_GpiodChip *c;
 
-        PL_MSleep(200);
+    n = 0;
 
-        ret = fn_gpiod_line_set_value(line, 1);
-        Assert(ret != -1);
+    for (i = 0; i < gpiod_chip_count; i++)
+    {
+        c = &gpiod_chips[i];
 
-        fn_gpiod_line_release(line);
+        for (j = 0; c->ftdi && c->serial[0] && j < count; j++)
+        {
+            if (serials[j] && strcmp(c->serial, serials[j]) == 0)
+            {
+                sel[n++] = c;
+                break;
+            }
+        }
+    }
 
-        ret = fn_gpiod_line_request_input(line, "gcf");
-        Assert(ret != -1);
+    for (i = 0; n == 0 && count == 1 && i < gpiod_chip_count; i++)
+    {
+        c = &gpiod_chips[i];
 
-        fn_gpiod_line_release(line);
+        if (c->ftdi && (c->serial[0] == '\0' || !serials[0] || serials[0][0] == '\0'))
+            sel[n++] = c;
+    }
 
-        ret = 0;
-        break;
+    return n;
+}
+
+/* Toggles CBUS0, which is connected to the MCU reset, of up to
+   PL_GPIOD_TOGGLE_BATCH \p sel chips in one round. Nothing is toggled
+   when a line can't be requested.
+*/
+static int plToggleFtdiChips(PL_GpiodChip **sel, unsigned n)
+{
+    int ret;
+    unsigned i;
+    unsigned nlines;
+    struct gpiod_line *lines[PL_GPIOD_TOGGLE_BATCH];
+
+    ret = 0;
+
+    for (nlines = 0; nlines < n; nlines++)
+    {
+        lines[nlines] = fn_gpiod_chip_get_line(sel[nlines]->chip, 0); /* CBUS0 */
+
+        if (!lines[nlines] || fn_gpiod_line_request_output(lines[nlines], "gcf", 0) != 0)
+        {
+            ret = -1;
+            break;
+        }
     }
 
-    fn_gpiod_chip_iter_free(iter);
+    for (i = 0; ret == 0 && i < nlines; i++)
+        fn_gpiod_line_set_value(lines[i], 1);
 
-    plUnloadLibGpiod();
+    for (i = 0; ret == 0 && i < nlines; i++)
+        fn_gpiod_line_set_value(lines[i], 0);
 
-    return ret;
+    for (i = 0; ret == 0 && i < nlines; i++)
+        fn_gpiod_line_set_value(lines[i], 1);
+
+    for (i = 0; i < nlines; i++)
+        fn_gpiod_line_release(lines[i]);
+
+    return ret == 0 ? (int)nlines : -1;
+}
+
+/* Toggles all \p sel chips batch by batch. On failure the caller
+   rescans and toggles all again, resetting a stick twice is harmless.
+*/
+static int plToggleFtdiBatches(PL_GpiodChip **sel, unsigned n)
+{
+    int ret;
+    unsigned i;
+    unsigned len;
+
+    for (i = 0; i < n; i += len)
+    {
+        len = n - i < PL_GPIOD_TOGGLE_BATCH ? n - i : PL_GPIOD_TOGGLE_BATCH;
+        ret = plToggleFtdiChips(&sel[i], len);
+        if (ret < 0)
+            return ret;
+    }
+
+    return (int)n;
 }
 
-int plResetFtdiLibGpiod(void)
+int plResetRaspBeeLibGpiod(void)
 {
     int ret = -1;
-    struct gpiod_chip *chip;
-    struct gpiod_chip_iter *iter;
+    unsigned i;
     struct gpiod_line *line;
-    const char *name;
-    const char *label;
 
     if (plLoadLibGpiod() != 0)
     {
         return -1;
     }
 
-    iter = fn_gpiod_chip_iter_new();
-
-    if (!iter)
-    {
-        plUnloadLibGpiod();
-        return -2;
-    }
+    if (!gpiod_chips_scanned)
+        plScanGpiodChips();
 
-    while ((chip = fn_gpiod_chip_iter_next(iter)) != NULL)
+    for (i = 0; i < gpiod_chip_count; i++)
     {
-        name = fn_gpiod_chip_name(chip);
-        label = fn_gpiod_chip_label(chip);
-
-        if (!label || strcmp(label, "ftdi-cbus") != 0)
-        {
+        if (gpiod_chips[i].ftdi)
             continue;
-        }
 
-        line = fn_gpiod_chip_get_line(chip, 0); /* CBUS0 */
+        /* https://pinout.xyz/pinout/raspbee
+           RaspBee reset pin on gpio17
+        */
+        line = fn_gpiod_chip_get_line(gpiod_chips[i].chip, 17);
 
         if (!line)
         {
             continue;
         }
 
-        PL_Printf(DBG_DEBUG, "gpiod chip: name: %s, label: %s\n", name, label);
-
-        /* toggle CBUS0 which is connected to MCU reset */
+        ret = fn_gpiod_line_request_output(line, "gcf", 1);
+        Assert(ret != -1);
 
-        ret = fn_gpiod_line_request_output(line, "gcf", 0);
+        ret = fn_gpiod_line_set_value(line, 0);
         Assert(ret != -1);
 
+        PL_MSleep(200);
+
         ret = fn_gpiod_line_set_value(line, 1);
         Assert(ret != -1);
 
-        ret = fn_gpiod_line_set_value(line, 0);
-        Assert(ret != -1);
+        fn_gpiod_line_release(line);
 
-        ret = fn_gpiod_line_set_value(line, 1);
+        ret = fn_gpiod_line_request_input(line, "gcf");
         Assert(ret != -1);
 
         fn_gpiod_line_release(line);
@@ -245,10 +335,51 @@ int plResetFtdiLibGpiod(void)
         break;
     }
 
-    fn_gpiod_chip_iter_free(iter);
+    return ret;
+}
+
+/*! Resets the ConBee I sticks with the FTDI serial numbers \p serials.
+
+    \returns the number of sticks reset, or < 0 on failure.
+ */
+int plResetFtdiLibGpiod(const char *const *serials, unsigned count)
+{
+    int ret;
+    unsigned n;
+    PL_GpiodChip *sel[PL_GPIOD_MAX_CHIPS];
+
+    if (plLoadLibGpiod() != 0)
+    {
+        return -1;
+    }
+
+    if (!gpiod_chips_scanned)
+        plScanGpiodChips();
+
+    n = plSelectFtdiChips(serials, count, &sel[0]);
+    if (n < count) /* plugged in after the last scan? */
+    {
+        plScanGpiodChips();
+        n = plSelectFtdiChips(serials, count, &sel[0]);
+    }
+
+    if (n == 0)
+        return -2;
 
-    plUnloadLibGpiod();
+    ret = plToggleFtdiBatches(&sel[0], n);
+    if (ret < 0) /* stale chip of a replugged stick */
+    {
+        plScanGpiodChips();
+        n = plSelectFtdiChips(serials, count, &sel[0]);
+        ret = n ? plToggleFtdiBatches(&sel[0], n) : -2;
+    }
 
     return ret;
 }
+
+void plExitLibGpiod(void)
+{
+    if (lib_gpiod_handle)
+        plUnloadLibGpiod();
+}
 #endif
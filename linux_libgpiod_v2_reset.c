@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2021-2025 dresden elektronik ingenieurtechnik gmbh.
+ * Copyright (c) 2021-2026 dresden elektronik ingenieurtechnik gmbh.
  * All rights reserved.
  *
  * The software in this package is published under the terms of the BSD
@@ -24,6 +24,20 @@
    /sys/devices/pci0000:00/0000:00:14.0/usb1/1-4/1-4.4/serial
 */
 
+/* libgpiod is loaded on first use and stays loaded until plExitLibGpiod().
+   The pinctrl and ftdi-cbus chips are opened once and cached, a chip of
+   an unplugged ConBee I becomes unusable, in that case the cache is
+   rebuilt and the reset tried once more.
+
+   The cache holds a chip for each ConBee I the device table can list
+   (MAX_DEVICES in gcf.c) plus the pinctrl chips. Lines are requested in
+   batches, so the open file descriptors stay well below the usual limit
+   of 1024.
+*/
+#define PL_GPIOD_MAX_CHIPS    (512 + 16)
+#define PL_GPIOD_MAX_SCAN     1024
+#define PL_GPIOD_TOGGLE_BATCH 64
+
 typedef const char *(*pl_gpiod_api_version)(void);
 typedef struct gpiod_chip *(*pl_gpiod_chip_open)(const char *path);
 typedef void (*pl_gpiod_chip_close)(struct gpiod_chip *chip);
@@ -44,6 +58,13 @@ typedef void (*pl_gpiod_request_config_free)(struct gpiod_request_config *config
 typedef void (*pl_gpiod_request_config_set_consumer)(struct gpiod_request_config *config, const char *consumer);
 typedef int (*pl_gpiod_line_request_set_value)(struct gpiod_line_request *request, unsigned int offset, enum gpiod_line_value value);
 
+typedef struct
+{
+    struct gpiod_chip *chip;
+    int ftdi; /* ftdi-cbus, otherwise pinctrl */
+    char serial[MAX_DEV_SERIALNR_LENGTH]; /* USB serial number of ftdi-cbus */
+} PL_GpiodChip;
+
 static void* lib_gpiod_handle;
 static pl_gpiod_api_version          fn_gpiod_api_version;
 static pl_gpiod_chip_open            fn_gpiod_chip_open;
@@ -66,12 +87,19 @@ static pl_gpiod_request_config_free fn_gpiod_request_config_free;
 static pl_gpiod_request_config_set_consumer fn_gpiod_request_config_set_consumer;
 static pl_gpiod_line_request_set_value fn_gpiod_line_request_set_value;
 
+static int gpiod_chips_scanned;
+static unsigned gpiod_chip_count;
+static PL_GpiodChip gpiod_chips[PL_GPIOD_MAX_CHIPS];
+
+int plGetLinuxUSBSerial(const char *syspath, char *serial, unsigned size);
+
 static int plLoadLibGpiod(void);
 static int plUnloadLibGpiod(void);
 
 static int plLoadLibGpiod(void)
 {
-    Assert(lib_gpiod_handle == NULL);
+    if (lib_gpiod_handle)
+        return 0; /* already loaded */
 
     lib_gpiod_handle = dlopen("libgpiod.so", RTLD_LAZY);
     if (!lib_gpiod_handle)
@@ -84,6 +112,7 @@ static int plLoadLibGpiod(void)
 
     if (!fn_gpiod_api_version)
     {
+        plUnloadLibGpiod();
         return -1;
     }
 
@@ -138,14 +167,29 @@ static int plLoadLibGpiod(void)
     return 0;
 }
 
+static void plCloseGpiodChips(void)
+{
+    unsigned i;
+
+    for (i = 0; i < gpiod_chip_count; i++)
+        fn_gpiod_chip_close(gpiod_chips[i].chip);
+
+    gpiod_chip_count = 0;
+    gpiod_chips_scanned = 0;
+}
+
 static int plUnloadLibGpiod(void)
 {
     Assert(lib_gpiod_handle != NULL);
 
     if (lib_gpiod_handle)
     {
+        if (fn_gpiod_chip_close)
+            plCloseGpiodChips();
+
         dlclose(lib_gpiod_handle);
         lib_gpiod_handle = NULL;
+        fn_gpiod_api_version = NULL;
         fn_gpiod_chip_open = NULL;
         fn_gpiod_chip_close = NULL;
         fn_gpiod_chip_get_info = NULL;
@@ -173,21 +217,24 @@ static int plUnloadLibGpiod(void)
     return -1;
 }
 
-static struct gpiod_chip *plGetGpiodChip(const char *prefix)
+static void plScanGpiodChips(void)
 {
-    int i;
+    unsigned i;
+    const char *label;
     struct gpiod_chip *chip;
     struct gpiod_chip_info *info;
-    const char *label;
+    PL_GpiodChip *c;
     char path[64];
     U_SStream ss;
 
-    for (i = 0; i < 20; i++)
+    plCloseGpiodChips();
+
+    for (i = 0; i < PL_GPIOD_MAX_SCAN && gpiod_chip_count < PL_GPIOD_MAX_CHIPS; i++)
     {
-        U_sstream_init(&ss, path, sizeof(path));
+        U_sstream_init(&ss, &path[0], sizeof(path));
         U_sstream_put_str(&ss, "/dev/gpiochip");
-        U_sstream_put_long(&ss, i);
-        chip = fn_gpiod_chip_open(path);
+        U_sstream_put_long(&ss, (long)i);
+        chip = fn_gpiod_chip_open(&path[0]);
         if (!chip)
             continue;
 
@@ -200,21 +247,68 @@ static struct gpiod_chip *plGetGpiodChip(const char *prefix)
 
         label = fn_gpiod_chip_info_get_label(info);
 
-        if (label)
+        if (!label || (strncmp(label, "pinctrl-", 8) != 0 && strcmp(label, "ftdi-cbus") != 0))
         {
-            U_sstream_init(&ss, (char*)label, strlen(label));
-            if (U_sstream_find(&ss, prefix))
+            fn_gpiod_chip_info_free(info);
+            fn_gpiod_chip_close(chip);
+            continue;
+        }
+
+        c = &gpiod_chips[gpiod_chip_count++];
+        c->chip = chip;
+        c->ftdi = label[0] == 'f';
+        c->serial[0] = '\0';
+
+        if (c->ftdi)
+        {
+            U_sstream_init(&ss, &path[0], sizeof(path));
+            U_sstream_put_str(&ss, "/sys/bus/gpio/devices/gpiochip");
+            U_sstream_put_long(&ss, (long)i);
+            plGetLinuxUSBSerial(ss.str, &c->serial[0], sizeof(c->serial));
+        }
+
+        PL_Printf(DBG_DEBUG, "gpiod chip: gpiochip%u, label: %s %s\n", i, label, c->serial);
+        fn_gpiod_chip_info_free(info);
+    }
+
+    gpiod_chips_scanned = 1;
+}
+
+/* Selects the ftdi-cbus chips of \p serials. When sysfs doesn't tell the
+   serial number a single reset uses the first chip.
+*/
+static unsigned plSelectFtdiChips(const char *const *serials, unsigned count, PL_GpiodChip **sel)
+{
+    unsigned i;
+    unsigned j;
+    unsigned n;
+    PL_GpiodChip *c;
+
+    n = 0;
+
+    for (i = 0; i < gpiod_chip_count; i++)
+    {
+        c = &gpiod_chips[i];
+
+        for (j = 0; c->ftdi && c->serial[0] && j < count; j++)
+        {
+            if (serials[j] && strcmp(c->serial, serials[j]) == 0)
             {
-                fn_gpiod_chip_info_free(info);
-                return chip;
+                sel[n++] = c;
+                break;
             }
         }
+    }
 
-        fn_gpiod_chip_info_free(info);
-        fn_gpiod_chip_close(chip);
+    for (i = 0; n == 0 && count == 1 && i < gpiod_chip_count; i++)
+    {
+        c = &gpiod_chips[i];
+
+        if (c->ftdi && (c->serial[0] == '\0' || !serials[0] || serials[0][0] == '\0'))
+            sel[n++] = c;
     }
 
-    return 0;
+    return n;
 }
 
 static struct gpiod_line_request * plRequestOutputLine(struct gpiod_chip *chip, unsigned int offset, enum gpiod_line_value value)
@@ -263,10 +357,69 @@ static struct gpiod_line_request * plRequestOutputLine(struct gpiod_chip *chip,
     return req;
 }
 
+/* Toggles CBUS0, which is connected to the MCU reset, of up to
+   PL_GPIOD_TOGGLE_BATCH \p sel chips in one round. Nothing is toggled
+   when a line can't be requested.
+*/
+static int plToggleFtdiChips(PL_GpiodChip **sel, unsigned n)
+{
+    int ret;
+    unsigned i;
+    unsigned nreqs;
+    struct gpiod_line_request *reqs[PL_GPIOD_TOGGLE_BATCH];
+
+    ret = 0;
+
+    for (nreqs = 0; nreqs < n; nreqs++)
+    {
+        reqs[nreqs] = plRequestOutputLine(sel[nreqs]->chip, 0, GPIOD_LINE_VALUE_INACTIVE); /* CBUS0 */
+
+        if (!reqs[nreqs])
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+    for (i = 0; ret == 0 && i < nreqs; i++)
+        fn_gpiod_line_request_set_value(reqs[i], 0, GPIOD_LINE_VALUE_ACTIVE);
+
+    for (i = 0; ret == 0 && i < nreqs; i++)
+        fn_gpiod_line_request_set_value(reqs[i], 0, GPIOD_LINE_VALUE_INACTIVE);
+
+    for (i = 0; ret == 0 && i < nreqs; i++)
+        fn_gpiod_line_request_set_value(reqs[i], 0, GPIOD_LINE_VALUE_ACTIVE);
+
+    for (i = 0; i < nreqs; i++)
+        fn_gpiod_line_request_release(reqs[i]);
+
+    return ret == 0 ? (int)nreqs : -1;
+}
+
+/* Toggles all \p sel chips batch by batch. On failure the caller
+   rescans and toggles all again, resetting a stick twice is harmless.
+*/
+static int plToggleFtdiBatches(PL_GpiodChip **sel, unsigned n)
+{
+    int ret;
+    unsigned i;
+    unsigned len;
+
+    for (i = 0; i < n; i += len)
+    {
+        len = n - i < PL_GPIOD_TOGGLE_BATCH ? n - i : PL_GPIOD_TOGGLE_BATCH;
+        ret = plToggleFtdiChips(&sel[i], len);
+        if (ret < 0)
+            return ret;
+    }
+
+    return (int)n;
+}
+
 int plResetRaspBeeLibGpiod(void)
 {
     int ret = -1;
-    struct gpiod_chip *chip;
+    unsigned i;
     struct gpiod_line_request *line_req;
 
     if (plLoadLibGpiod() != 0)
@@ -274,74 +427,80 @@ int plResetRaspBeeLibGpiod(void)
         return -1;
     }
 
-    chip = plGetGpiodChip("pinctrl-");
+    if (!gpiod_chips_scanned)
+        plScanGpiodChips();
 
-    if (!chip)
+    for (i = 0; i < gpiod_chip_count; i++)
     {
-        plUnloadLibGpiod();
-        return -2;
-    }
+        if (gpiod_chips[i].ftdi)
+            continue;
 
-    /* https://pinout.xyz/pinout/raspbee
-       RaspBee reset pin on gpio17
-    */
-    line_req = plRequestOutputLine(chip, 17, GPIOD_LINE_VALUE_ACTIVE); /* CBUS0 */
+        /* https://pinout.xyz/pinout/raspbee
+           RaspBee reset pin on gpio17
+        */
+        line_req = plRequestOutputLine(gpiod_chips[i].chip, 17, GPIOD_LINE_VALUE_ACTIVE);
+
+        if (!line_req)
+            continue;
 
-    if (line_req)
-    {
         /* TODO not tested yet due lack of libgpoid version 2 for Raspberry Pi */
-        ret = fn_gpiod_line_request_set_value(line_req, 0, GPIOD_LINE_VALUE_INACTIVE);
+        ret = fn_gpiod_line_request_set_value(line_req, 17, GPIOD_LINE_VALUE_INACTIVE);
         Assert(ret == 0);
-        ret = fn_gpiod_line_request_set_value(line_req, 0, GPIOD_LINE_VALUE_ACTIVE);
+        ret = fn_gpiod_line_request_set_value(line_req, 17, GPIOD_LINE_VALUE_ACTIVE);
         Assert(ret == 0);
         fn_gpiod_line_request_release(line_req);
         ret = 0;
+        break;
     }
 
-    fn_gpiod_chip_close(chip);
-    plUnloadLibGpiod();
-
     return ret;
 }
 
-/* https://web.git.kernel.org/pub/scm/libs/libgpiod/libgpiod.git/tree/examples/toggle_line_value.c */
-int plResetFtdiLibGpiod(void)
+/*! Resets the ConBee I sticks with the FTDI serial numbers \p serials.
+
+    https://web.git.kernel.org/pub/scm/libs/libgpiod/libgpiod.git/tree/examples/toggle_line_value.c
+
+    \returns the number of sticks reset, or < 0 on failure.
+ */
+int plResetFtdiLibGpiod(const char *const *serials, unsigned count)
 {
-    int ret = -1;
-    struct gpiod_chip *chip;
-    struct gpiod_line_request *line_req;
+    int ret;
+    unsigned n;
+    PL_GpiodChip *sel[PL_GPIOD_MAX_CHIPS];
 
     if (plLoadLibGpiod() != 0)
     {
         return -1;
     }
 
-    chip = plGetGpiodChip("ftdi-cbus");
-    if (!chip)
+    if (!gpiod_chips_scanned)
+        plScanGpiodChips();
+
+    n = plSelectFtdiChips(serials, count, &sel[0]);
+    if (n < count) /* plugged in after the last scan? */
     {
-        plUnloadLibGpiod();
-        return -2;
+        plScanGpiodChips();
+        n = plSelectFtdiChips(serials, count, &sel[0]);
     }
 
-    line_req = plRequestOutputLine(chip, 0, GPIOD_LINE_VALUE_INACTIVE); /* CBUS0 */
+    if (n == 0)
+        return -2;
 
-    if (line_req)
+    ret = plToggleFtdiBatches(&sel[0], n);
+    if (ret < 0) /* stale chip of a replugged stick */
     {
-        ret = fn_gpiod_line_request_set_value(line_req, 0, GPIOD_LINE_VALUE_ACTIVE);
-        Assert(ret == 0);
-        ret = fn_gpiod_line_request_set_value(line_req, 0, GPIOD_LINE_VALUE_INACTIVE);
-        Assert(ret == 0);
-        ret = fn_gpiod_line_request_set_value(line_req, 0, GPIOD_LINE_VALUE_ACTIVE);
-        Assert(ret == 0);
-        fn_gpiod_line_request_release(line_req);
-        ret = 0;
+        plScanGpiodChips();
+        n = plSelectFtdiChips(serials, count, &sel[0]);
+        ret = n ? plToggleFtdiBatches(&sel[0], n) : -2;
     }
 
-    fn_gpiod_chip_close(chip);
-
-    plUnloadLibGpiod();
-
     return ret;
 }
 
+void plExitLibGpiod(void)
+{
+    if (lib_gpiod_handle)
+        plUnloadLibGpiod();
+}
+
 #endif /* HAS_LIBGPIOD */
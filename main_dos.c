@@ -21,6 +21,7 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 #include "gcf.h"
 #include "u_sstream.h"
@@ -54,6 +55,12 @@ PL_time_t PL_Time(void)
     return platform.time;
 }
 
+/*! Returns the wall clock time in milliseconds since 1970-01-01 UTC. */
+PL_time_t PL_WallTime(void)
+{
+    return (PL_time_t)time(NULL) * 1000;
+}
+
 /*! Lets the programm sleep for \p ms milliseconds. */
 void PL_MSleep(unsigned long ms)
 {
@@ -222,7 +229,38 @@ void PL_Disconnect(void)
         platform.com_int = 0;
     }
 
-    GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+    /* after PL_ShutDown() the state machine would take it as a finished
+       reset and report success for an aborted run */
+    if (platform.running)
+        GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+}
+
+PL_Handle PL_SerialOpen(const char *path, PL_Baudrate baudrate)
+{
+    (void)path;
+    (void)baudrate;
+    return 0; /* not supported, see PL_AddPollHandle() */
+}
+
+int PL_SerialRead(PL_Handle handle, unsigned char *buf, unsigned size)
+{
+    (void)handle;
+    (void)buf;
+    (void)size;
+    return -1;
+}
+
+int PL_SerialWrite(PL_Handle handle, const unsigned char *data, unsigned len)
+{
+    (void)handle;
+    (void)data;
+    (void)len;
+    return -1;
+}
+
+void PL_SerialClose(PL_Handle handle)
+{
+    (void)handle;
 }
 
 /*! Shuts down platform layer (ends main loop). */
@@ -231,14 +269,26 @@ void PL_ShutDown(void)
     platform.running = 0;
 }
 
+int PL_StartReplay(const char *path, int realtime)
+{
+    (void)path;
+    (void)realtime;
+    return 0; /* not supported */
+}
+
 /*! Executes a MCU reset for ConBee I via FTDI CBUS0 reset. */
 int PL_ResetFTDI(int num, const char *serialnum)
 {
     return -1;
 }
 
+int PL_ResetFTDIDevices(const char *const *serialnums, unsigned count)
+{
+    return -1;
+}
+
 /*! Executes a MCU reset for RaspBee I / II via GPIO17 reset pin. */
-int PL_ResetRaspBee(void)
+int PL_ResetRaspBee(const char *gpiochip, unsigned line)
 {
     return -1;
 }
@@ -250,12 +300,98 @@ int PL_ReadFile(const char *path, unsigned char *buf, unsigned long buflen)
     return result;
 }
 
+PL_File PL_FileOpen(const char *path, int mode)
+{
+    (void)path;
+    (void)mode;
+    return 0;
+}
+
+int PL_FileWrite(PL_File file, const void *data, unsigned long len)
+{
+    (void)file;
+    (void)data;
+    (void)len;
+    return -1;
+}
+
+void PL_FileClose(PL_File file)
+{
+    (void)file;
+}
+
+int PL_ReplaceFile(const char *path, const void *data, unsigned long len)
+{
+    (void)path;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int PL_GetCachePath(const char *name, char *buf, unsigned size)
+{
+    (void)name;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+int PL_GetDeviceNodeId(const char *path, unsigned long long *id)
+{
+    (void)path;
+    (void)id;
+    return 0; /* COM ports have no stable identity, cache isn't used */
+}
+
+void PL_EnableHotplug(void)
+{
+}
+
+void *PL_SharedMemoryOpen(const char *name, unsigned long size)
+{
+    (void)name;
+    (void)size;
+    return 0;
+}
+
+void PL_SharedMemoryClose(void *mem, unsigned long size)
+{
+    (void)mem;
+    (void)size;
+}
+
+void *PL_MemoryAlloc(unsigned long size)
+{
+    (void)size;
+    return 0;
+}
+
+/* Only main_posix.c polls further handles, so the network server, bridge,
+   metrics endpoint and inventory are not available on this platform.
+*/
+int PL_AddPollHandle(PL_Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+void PL_RemovePollHandle(PL_Handle handle)
+{
+    (void)handle;
+}
 
 void PL_Print(const char *line)
 {
     printf("%s", line);
 }
 
+static int plPrintStderr;
+
+void PL_SetPrintStderr(int enable)
+{
+    plPrintStderr = enable;
+}
+
 void PL_Printf(DebugLevel level, const char *format, ...)
 {
 #ifdef NDEBUG
@@ -268,7 +404,10 @@ void PL_Printf(DebugLevel level, const char *format, ...)
 #endif
     va_list args;
     va_start (args, format);
-    vprintf(format, args);
+    if (plPrintStderr)
+        vfprintf(stderr, format, args);
+    else
+        vprintf(format, args);
     va_end (args);
 }
 
@@ -295,6 +434,7 @@ int PROT_Write(const unsigned char *data, unsigned len)
         return 0;
 
     gcfDebugHex(platform.gcf, "send", data, len);
+    GCF_TraceSent(platform.gcf, data, len);
 
     for (; len != 0; len--)
     {
@@ -22,38 +22,75 @@
 #include <dlfcn.h>
 #include <termios.h> /* POSIX terminal control definitions */
 #include <signal.h>
+#include <sys/mman.h> /* shm_open(), mmap() */
+#include <sys/stat.h> /* stat(), mkdir() */
+
+#ifdef PL_LINUX
+  #include <sys/socket.h>
+  #include <linux/netlink.h>
+#endif
 
 #include "gcf.h"
 #include "protocol.h"
+#include "metrics.h"
+#include "replay.h"
 #include "u_sstream.h"
 #include "u_mem.h"
 
 #define RX_BUF_SIZE 1024
 #define TX_BUF_SIZE 2048
+#define MAX_POLL_HANDLES 128
+#define PL_REPLAY_FD -2 /* PL_Connect() handle during replay */
+#define PL_REPLAY_TX_SIZE 8192
 
 typedef struct
 {
     PL_time_t timer;
     int fd;
     unsigned char running;
+    unsigned char inputClosed;
+    int ueventFd; /* kernel hotplug events, -1 if not available */
     unsigned char rxbuf[RX_BUF_SIZE];
     unsigned char txbuf[TX_BUF_SIZE];
     unsigned tx_rp;
     unsigned tx_wp;
+    unsigned pollCount;
+    PL_Handle pollHandles[MAX_POLL_HANDLES];
     GCF *gcf;
 } PL_Internal;
 
+/* Kept apart from the platform state, which is cleared in PL_Loop(). */
+typedef struct
+{
+    int active;
+    int realtime;
+    REPLAY_Reader reader;
+    PL_time_t now;   /* virtual time of the current record */
+    PL_time_t start; /* time of the first record */
+    unsigned long records;
+    unsigned long mismatches;
+    unsigned long firstMismatch; /* record number */
+    unsigned txLength;
+    unsigned char tx[PL_REPLAY_TX_SIZE]; /* sent, not yet compared */
+} PL_Replay;
+
 static PL_Internal platform;
+static PL_Replay plReplay;
+static unsigned char plReplayFile[REPLAY_MAX_SIZE];
 static struct termios restore_attr;
 static volatile sig_atomic_t keyboard_initialized = 0;
+static volatile sig_atomic_t trigger_signal = 0;
+static volatile sig_atomic_t shutdown_signal = 0;
 
 #ifdef PL_LINUX
 int plGetLinuxUSBDevices(Device *dev, Device *end);
 int plGetLinuxSerialDevices(Device *dev, Device *end);
+int plResetGpioChip(const char *gpiochip, unsigned line);
 
 #ifdef HAS_LIBGPIOD
 int plResetRaspBeeLibGpiod(void);
-int plResetFtdiLibGpiod(void);
+int plResetFtdiLibGpiod(const char *const *serials, unsigned count);
+void plExitLibGpiod(void);
 #endif
 
 #endif
@@ -93,7 +130,7 @@ static int plSetupPort(int fd, int baudrate)
 }
 
 /* Returns a monotonic timestamps in milliseconds */
-PL_time_t PL_Time(void)
+static PL_time_t plMonotonicTime(void)
 {
     PL_time_t res;
     struct timespec ts;
@@ -108,8 +145,34 @@ PL_time_t PL_Time(void)
     return res;
 }
 
+PL_time_t PL_Time(void)
+{
+    if (plReplay.active)
+        return plReplay.now;
+
+    return plMonotonicTime();
+}
+
+PL_time_t PL_WallTime(void)
+{
+    PL_time_t res;
+    struct timespec ts;
+
+    res = 0;
+    if (clock_gettime(CLOCK_REALTIME, &ts) == 0)
+    {
+        res = ts.tv_sec * 1000ULL;
+        res += ts.tv_nsec / 1000000;
+    }
+
+    return res;
+}
+
 void PL_MSleep(unsigned long ms)
 {
+    if (plReplay.active)
+        return; /* the recording has the real delays */
+
     while (ms > 0)
     {
         usleep(1000);
@@ -121,8 +184,12 @@ int PL_ResetFTDI(int num, const char *serialnum)
 {
     (void)num;
     (void)serialnum;
+
+    if (plReplay.active)
+        return 0;
+
 #ifdef HAS_LIBGPIOD
-    return plResetFtdiLibGpiod();
+    return plResetFtdiLibGpiod(&serialnum, 1) > 0 ? 0 : -1;
 #endif
 
 #ifdef HAS_LIBFTDI
@@ -132,8 +199,43 @@ int PL_ResetFTDI(int num, const char *serialnum)
     return -1;
 }
 
-int PL_ResetRaspBee(void)
+int PL_ResetFTDIDevices(const char *const *serialnums, unsigned count)
 {
+    if (plReplay.active)
+        return (int)count;
+
+#ifdef HAS_LIBGPIOD
+    return plResetFtdiLibGpiod(serialnums, count);
+#else
+    int n;
+    unsigned i;
+
+    for (i = 0, n = 0; i < count; i++)
+    {
+        if (PL_ResetFTDI((int)i, serialnums[i]) == 0)
+            n++;
+    }
+
+    return n ? n : -1;
+#endif
+}
+
+int PL_ResetRaspBee(const char *gpiochip, unsigned line)
+{
+    if (plReplay.active)
+        return 0;
+
+#ifdef PL_LINUX
+    if (plResetGpioChip(gpiochip, line) == 0)
+        return 0;
+
+    if (gpiochip) /* libgpiod only knows the default pin */
+        return -1;
+#else
+    (void)gpiochip;
+    (void)line;
+#endif
+
 #ifdef HAS_LIBGPIOD
     return plResetRaspBeeLibGpiod();
 #endif
@@ -146,6 +248,13 @@ void PL_Print(const char *line)
     fflush(stdout);
 }
 
+static int plPrintStderr;
+
+void PL_SetPrintStderr(int enable)
+{
+    plPrintStderr = enable;
+}
+
 void PL_Printf(DebugLevel level, const char *format, ...)
 {
     FILE *fp;
@@ -155,7 +264,7 @@ void PL_Printf(DebugLevel level, const char *format, ...)
     if (level == DBG_DEBUG)
         return;
 #endif
-    if (level == DBG_DEBUG)
+    if (level == DBG_DEBUG || plPrintStderr)
         fp = stderr;
 
     va_list args;
@@ -177,6 +286,14 @@ GCF_Status PL_Connect(const char *path, PL_Baudrate baudrate)
         return GCF_SUCCESS;
     }
 
+    if (plReplay.active)
+    {
+        platform.fd = PL_REPLAY_FD;
+        platform.tx_rp = 0;
+        platform.tx_wp = 0;
+        return GCF_SUCCESS;
+    }
+
     platform.fd = open(path, O_CLOEXEC | O_RDWR /*| O_NONBLOCK*/);
     platform.tx_rp = 0;
     platform.tx_wp = 0;
@@ -224,12 +341,55 @@ void PL_Disconnect(void)
     PL_Printf(DBG_DEBUG, "PL_Disconnect\n");
     if (platform.fd != 0)
     {
-        close(platform.fd);
+        if (platform.fd != PL_REPLAY_FD)
+            close(platform.fd);
         platform.fd = 0;
     }
     platform.tx_rp = 0;
     platform.tx_wp = 0;
-    GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+    /* after PL_ShutDown() the state machine would take it as a finished
+       reset and report success for an aborted run */
+    if (platform.running)
+        GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+}
+
+PL_Handle PL_SerialOpen(const char *path, PL_Baudrate baudrate)
+{
+    int fd;
+
+    /* O_NONBLOCK doesn't wait for carrier, plSetupPort() clears it again */
+    fd = open(path, O_CLOEXEC | O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+    {
+        PL_Printf(DBG_DEBUG, "failed to open device %s, err: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    plSetupPort(fd, baudrate == PL_BAUDRATE_115200 ? B115200 : B38400);
+
+    return fd;
+}
+
+int PL_SerialRead(PL_Handle handle, unsigned char *buf, unsigned size)
+{
+    ssize_t n;
+
+    n = read(handle, buf, size);
+    if (n <= 0) /* 0 is hangup on a tty */
+        return -1;
+
+    return (int)n;
+}
+
+int PL_SerialWrite(PL_Handle handle, const unsigned char *data, unsigned len)
+{
+    return PL_FileWrite(handle, data, len);
+}
+
+void PL_SerialClose(PL_Handle handle)
+{
+    if (handle > STDERR_FILENO)
+        close(handle);
 }
 
 void PL_ShutDown(void)
@@ -243,7 +403,7 @@ int PL_ReadFile(const char *path, unsigned char *buf, unsigned long buflen)
     int fd;
     int ret;
 
-    Assert(path && buf && buflen >= MAX_GCF_FILE_SIZE);
+    Assert(path && buf && buflen > 0);
 
     ret = -1;
     fd = open(path, O_RDONLY);
@@ -268,6 +428,219 @@ int PL_ReadFile(const char *path, unsigned char *buf, unsigned long buflen)
     return ret;
 }
 
+PL_File PL_FileOpen(const char *path, int mode)
+{
+    int fd;
+    int flags;
+
+    if (path[0] == '-' && path[1] == '\0')
+        return STDOUT_FILENO;
+
+    flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    flags |= (mode == PL_FILE_APPEND) ? O_APPEND : O_TRUNC;
+
+    fd = open(path, flags, 0644);
+    if (fd == -1)
+    {
+        PL_Printf(DBG_DEBUG, "failed to open %s, err: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    return fd;
+}
+
+int PL_FileWrite(PL_File file, const void *data, unsigned long len)
+{
+    ssize_t n;
+    unsigned long pos;
+
+    for (pos = 0; pos < len;)
+    {
+        n = write(file, (const char*)data + pos, len - pos);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            PL_Printf(DBG_DEBUG, "failed to write file, err: %s\n", strerror(errno));
+            return -1;
+        }
+        pos += (unsigned long)n;
+    }
+
+    return (int)pos;
+}
+
+void PL_FileClose(PL_File file)
+{
+    if (file > STDERR_FILENO)
+        close(file);
+}
+
+int PL_ReplaceFile(const char *path, const void *data, unsigned long len)
+{
+    int ret;
+    PL_File file;
+    U_SStream ss;
+    char tmp[MAX_DEV_PATH_LENGTH + 16];
+
+    /* the temporary file is on the same file system, rename() is atomic */
+    U_sstream_init(&ss, &tmp[0], sizeof(tmp));
+    U_sstream_put_str(&ss, path);
+    U_sstream_put_str(&ss, ".");
+    U_sstream_put_long(&ss, (long)getpid());
+
+    if (ss.status != U_SSTREAM_OK)
+        return 0;
+
+    file = PL_FileOpen(ss.str, PL_FILE_WRITE);
+    if (!file)
+        return 0;
+
+    ret = PL_FileWrite(file, data, len) == (int)len;
+    PL_FileClose(file);
+
+    if (ret && rename(ss.str, path) == -1)
+    {
+        PL_Printf(DBG_DEBUG, "failed to rename %s, err: %s\n", ss.str, strerror(errno));
+        ret = 0;
+    }
+
+    if (!ret)
+        unlink(ss.str);
+
+    return ret;
+}
+
+int PL_GetCachePath(const char *name, char *buf, unsigned size)
+{
+    const char *dir;
+    U_SStream ss;
+
+    U_sstream_init(&ss, buf, size);
+
+    dir = getenv("XDG_CACHE_HOME");
+    if (dir && dir[0] == '/')
+    {
+        U_sstream_put_str(&ss, dir);
+    }
+    else
+    {
+        dir = getenv("HOME");
+        if (!dir || dir[0] != '/')
+            return 0;
+
+        U_sstream_put_str(&ss, dir);
+        U_sstream_put_str(&ss, "/.cache");
+    }
+
+    if (ss.status != U_SSTREAM_OK)
+        return 0;
+
+    if (mkdir(ss.str, 0700) == -1 && errno != EEXIST)
+        return 0;
+
+    U_sstream_put_str(&ss, "/");
+    U_sstream_put_str(&ss, name);
+
+    return ss.status == U_SSTREAM_OK ? 1 : 0;
+}
+
+int PL_GetDeviceNodeId(const char *path, unsigned long long *id)
+{
+    struct stat st;
+
+    if (stat(path, &st) == -1 || !S_ISCHR(st.st_mode))
+        return 0;
+
+    /* devtmpfs assigns a new inode when the node is recreated */
+    *id = ((unsigned long long)st.st_rdev << 32) ^ (unsigned long long)st.st_ino;
+    return 1;
+}
+
+void *PL_SharedMemoryOpen(const char *name, unsigned long size)
+{
+    int fd;
+    void *mem;
+    char path[MAX_DEV_PATH_LENGTH];
+    U_SStream ss;
+
+    U_sstream_init(&ss, &path[0], sizeof(path));
+    if (name[0] != '/')
+        U_sstream_put_str(&ss, "/");
+    U_sstream_put_str(&ss, name);
+
+    fd = shm_open(ss.str, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        PL_Printf(DBG_DEBUG, "failed to open shared memory %s, err: %s\n", ss.str, strerror(errno));
+        return 0;
+    }
+
+    mem = 0;
+    if (ftruncate(fd, (off_t)size) == 0)
+    {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED)
+            mem = 0;
+    }
+
+    if (mem == 0)
+    {
+        PL_Printf(DBG_DEBUG, "failed to map shared memory %s, err: %s\n", ss.str, strerror(errno));
+    }
+
+    close(fd); /* mapping stays valid */
+
+    return mem;
+}
+
+void PL_SharedMemoryClose(void *mem, unsigned long size)
+{
+    if (mem)
+        munmap(mem, size);
+}
+
+void *PL_MemoryAlloc(unsigned long size)
+{
+    void *mem;
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return mem == MAP_FAILED ? 0 : mem;
+}
+
+int PL_AddPollHandle(PL_Handle handle)
+{
+    unsigned i;
+
+    for (i = 0; i < platform.pollCount; i++)
+    {
+        if (platform.pollHandles[i] == handle)
+            return 1;
+    }
+
+    if (platform.pollCount == MAX_POLL_HANDLES)
+        return 0;
+
+    platform.pollHandles[platform.pollCount++] = handle;
+    return 1;
+}
+
+void PL_RemovePollHandle(PL_Handle handle)
+{
+    unsigned i;
+
+    for (i = 0; i < platform.pollCount; i++)
+    {
+        if (platform.pollHandles[i] == handle)
+        {
+            platform.pollCount--;
+            platform.pollHandles[i] = platform.pollHandles[platform.pollCount];
+            return;
+        }
+    }
+}
+
 void PL_SetTimeout(unsigned long ms)
 {
     platform.timer = PL_Time() + ms;
@@ -299,6 +672,71 @@ int PL_GetDevices(Device *devs, unsigned max)
     return result;
 }
 
+static void plReplayMismatch(void)
+{
+    if (plReplay.mismatches == 0)
+        plReplay.firstMismatch = plReplay.records;
+
+    plReplay.mismatches++;
+}
+
+/* Collects the bytes sent during replay for the next REPLAY_REC_TX record. */
+static void plReplaySent(const unsigned char *data, unsigned len)
+{
+    if (PL_REPLAY_TX_SIZE - plReplay.txLength < len)
+    {
+        plReplayMismatch(); /* far more sent than recorded */
+        plReplay.txLength = 0;
+    }
+
+    if (len <= PL_REPLAY_TX_SIZE)
+    {
+        U_memcpy(&plReplay.tx[plReplay.txLength], data, len);
+        plReplay.txLength += len;
+    }
+}
+
+static void plReplayCompare(const REPLAY_Record *rec)
+{
+    unsigned n;
+
+    n = rec->length < plReplay.txLength ? rec->length : plReplay.txLength;
+
+    if (n != rec->length || memcmp(&plReplay.tx[0], rec->data, n) != 0)
+    {
+        PL_Printf(DBG_DEBUG, "replay: record %lu, sent data differs\n", plReplay.records);
+        plReplayMismatch();
+    }
+
+    plReplay.txLength -= n;
+    memmove(&plReplay.tx[0], &plReplay.tx[n], plReplay.txLength);
+}
+
+int PL_StartReplay(const char *path, int realtime)
+{
+    int n;
+
+    n = PL_ReadFile(path, &plReplayFile[0], sizeof(plReplayFile));
+    if (n <= 0)
+        return 0;
+
+    if ((unsigned long)n == sizeof(plReplayFile))
+    {
+        PL_Printf(DBG_INFO, "%s exceeds the replay limit of %lu MB\n", path, REPLAY_MAX_SIZE >> 20);
+        return 0;
+    }
+
+    if (REPLAY_ReadInit(&plReplay.reader, &plReplayFile[0], (unsigned long)n) == 0)
+        return 0;
+
+    plReplay.active = 1;
+    plReplay.realtime = realtime;
+    plReplay.start = plMonotonicTime();
+    plReplay.now = plReplay.start;
+
+    return 1;
+}
+
 int PROT_Write(const unsigned char *data, unsigned len)
 {
     int result;
@@ -351,7 +789,14 @@ int PROT_Flush(void)
 
     gcfDebugHex(platform.gcf, "send", &buf[0], len);
 
-    for (pos = 0; pos < len;)
+    pos = 0;
+    if (platform.fd == PL_REPLAY_FD)
+    {
+        plReplaySent(&buf[0], len);
+        pos = len;
+    }
+
+    for (; pos < len;)
     {
         n = (int)write(platform.fd, &buf[pos], len - pos);
         if (n == -1)
@@ -372,6 +817,8 @@ int PROT_Flush(void)
     }
 
     platform.tx_rp += pos;
+    METRICS_Add(METRICS_SERIAL_TX_BYTES, pos);
+    GCF_TraceSent(platform.gcf, &buf[0], pos);
 
     return (int)pos;
 }
@@ -421,19 +868,195 @@ static void PL_AtExit(void)
     }
 }
 
+/* SIGINT and SIGTERM end the main loop, so GCF_Exit() writes the
+   timing, status and wire trace of the interrupted run. A second
+   signal exits immediately.
+*/
 static void PL_SignalHandler(int sig)
 {
     (void)sig;
-    PL_AtExit();
-    _exit(1);
+
+    if (shutdown_signal)
+    {
+        PL_AtExit();
+        _exit(1);
+    }
+
+    shutdown_signal = 1;
+}
+
+static void PL_TriggerSignalHandler(int sig)
+{
+    (void)sig;
+    trigger_signal = 1;
+}
+
+#ifdef PL_LINUX
+/* Hotplug of USB serial devices via kernel uevents. The device node is
+   created by devtmpfs before the event is sent, permissions might still
+   be applied by udev shortly after.
+*/
+static void plOpenUevent(void)
+{
+    int fd;
+    struct sockaddr_nl addr;
+
+    if (platform.ueventFd != -1)
+        return;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd == -1)
+        return;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; /* kernel events */
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return;
+    }
+
+    platform.ueventFd = fd;
+}
+
+static void plProcessUevent(GCF *gcf)
+{
+    int add;
+    ssize_t n;
+    unsigned pos;
+    const char *devname;
+    char path[MAX_DEV_PATH_LENGTH];
+    char buf[2048 + 1];
+
+    for (;;)
+    {
+        n = recv(platform.ueventFd, buf, sizeof(buf) - 1, 0);
+        if (n <= 0)
+            break;
+
+        buf[n] = '\0';
+        add = 0;
+        devname = 0;
+
+        /* add@/devices/...\0ACTION=add\0DEVPATH=...\0SUBSYSTEM=tty\0DEVNAME=ttyACM0\0... */
+        for (pos = 0; pos < (unsigned)n; pos += (unsigned)strlen(&buf[pos]) + 1)
+        {
+            if (strcmp(&buf[pos], "ACTION=add") == 0)
+                add = 1;
+            else if (strncmp(&buf[pos], "DEVNAME=ttyACM", 14) == 0 || strncmp(&buf[pos], "DEVNAME=ttyUSB", 14) == 0)
+                devname = &buf[pos + 8];
+        }
+
+        if (add && devname)
+        {
+            snprintf(path, sizeof(path), "/dev/%.64s", devname);
+            GCF_DeviceAdded(gcf, path);
+        }
+    }
+}
+#endif /* PL_LINUX */
+
+void PL_EnableHotplug(void)
+{
+#ifdef PL_LINUX
+    if (!plReplay.active) /* hotplug events come from the recording */
+        plOpenUevent();
+#endif
+}
+
+/* Feeds the recording into the state machine, takes the place of the
+   main loop when PL_StartReplay() was called.
+*/
+static void plRunReplay(GCF *gcf)
+{
+    Event event;
+    REPLAY_Record rec;
+    char path[MAX_DEV_PATH_LENGTH];
+
+    while (platform.running && !shutdown_signal && REPLAY_ReadNext(&plReplay.reader, &rec))
+    {
+        plReplay.records++;
+
+        while (plReplay.realtime && plMonotonicTime() < plReplay.start + rec.time)
+            usleep(1000);
+
+        plReplay.now = plReplay.start + rec.time;
+
+        if (rec.type == REPLAY_REC_RX)
+        {
+            if (platform.fd != 0 && rec.length > 0)
+                GCF_Received(gcf, rec.data, (int)rec.length);
+        }
+        else if (rec.type == REPLAY_REC_TX)
+        {
+            plReplayCompare(&rec);
+        }
+        else if (rec.type == REPLAY_REC_EVENT)
+        {
+            event = REPLAY_RecordEventValue(&rec);
+
+            if (event == EV_TIMEOUT)
+            {
+                platform.timer = 0;
+            }
+            else if (event == EV_DISCONNECTED) /* device was gone */
+            {
+                platform.fd = 0;
+                platform.tx_rp = 0;
+                platform.tx_wp = 0;
+            }
+            else if (event == EV_INPUT_CLOSED)
+            {
+                platform.inputClosed = 1;
+            }
+
+            if (event == EV_DEVICE_ADDED)
+            {
+                REPLAY_RecordEventPath(&rec, &path[0], sizeof(path));
+                GCF_DeviceAdded(gcf, &path[0]);
+            }
+            else
+            {
+                GCF_HandleEvent(gcf, event);
+            }
+        }
+
+        if (platform.fd != 0 && platform.tx_rp != platform.tx_wp)
+            PROT_Flush();
+    }
+
+    if (platform.running)
+    {
+        PL_Printf(DBG_INFO, "replay: recording ended before the program\n");
+    }
+    else if (plReplay.txLength)
+    {
+        plReplay.records++;
+        plReplayMismatch(); /* sent more than recorded */
+    }
+
+    PL_Printf(DBG_INFO, "replay: %lu records, %lu mismatches", plReplay.records, plReplay.mismatches);
+    if (plReplay.mismatches)
+        PL_Printf(DBG_INFO, ", first at record %lu", plReplay.firstMismatch);
+    PL_Printf(DBG_INFO, "\n");
+
+    platform.running = 0;
 }
 
 static int PL_Loop(GCF *gcf)
 {
+    int i;
     int nfds;
     int ret;
     int nread;
-    struct pollfd fds[2];
+    int devIdx;
+    int pollIdx;
+#ifdef PL_LINUX
+    int ueventIdx;
+#endif
+    struct pollfd fds[3 + MAX_POLL_HANDLES];
     unsigned codepoint;
 
     PL_InitKeyboard();
@@ -442,28 +1065,66 @@ static int PL_Loop(GCF *gcf)
     platform.gcf = gcf;
 
     platform.running = 1;
+    platform.ueventFd = -1;
 
-    fds[0].events = POLLIN;
-    fds[1].events = POLLIN;
-
-    GCF_HandleEvent(gcf, EV_PL_STARTED);
+    if (plReplay.active)
+        plRunReplay(gcf); /* EV_PL_STARTED is recorded */
+    else
+        GCF_HandleEvent(gcf, EV_PL_STARTED);
 
     while (platform.running)
     {
         GCF_HandleEvent(gcf, EV_PL_LOOP);
 
+        if (trigger_signal)
+        {
+            trigger_signal = 0;
+            GCF_HandleEvent(gcf, EV_TRIGGER);
+        }
+
+        if (shutdown_signal)
+        {
+            PL_ShutDown();
+            break;
+        }
+
         nfds = 0;
+        devIdx = -1;
 
-        /* always poll STDIN at fds[0], to get poll() timeout and keyboard input */
-        fds[nfds++].fd = STDIN_FILENO;
+        /* always poll STDIN at fds[0], to get poll() timeout and keyboard input,
+           negative fd after EOF is ignored by poll() */
+        fds[nfds++].fd = platform.inputClosed ? -1 : STDIN_FILENO;
 
         /* when device is connected fds[1] */
         if (platform.fd != 0)
+        {
+            devIdx = nfds;
             fds[nfds++].fd = platform.fd;
+        }
+
+#ifdef PL_LINUX
+        ueventIdx = nfds;
+        fds[nfds++].fd = platform.ueventFd;
+#endif
+
+        /* sockets etc. added by PL_AddPollHandle() */
+        pollIdx = nfds;
+        for (i = 0; i < (int)platform.pollCount; i++)
+            fds[nfds++].fd = platform.pollHandles[i];
+
+        for (i = 0; i < nfds; i++)
+        {
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
 
         ret = poll(&fds[0], nfds, 5);
 
-        if (ret < 0)
+        if (ret < 0 && errno == EINTR)
+        {
+            continue; /* signal, e.g. SIGUSR1 trigger */
+        }
+        else if (ret < 0)
         {
             PL_Printf(DBG_DEBUG, "poll error: %s\n", strerror(errno));
             break;
@@ -483,17 +1144,29 @@ static int PL_Loop(GCF *gcf)
             continue;
         }
 
-        if (nfds == 2) /* device connected */
+        for (i = pollIdx; i < nfds; i++)
         {
-            if (fds[1].revents & (POLLHUP | POLLERR | POLLNVAL))
+            /* errors are reported as readable, the following read fails */
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                GCF_HandleReadable(gcf, fds[i].fd);
+        }
+
+#ifdef PL_LINUX
+        if (fds[ueventIdx].revents & POLLIN)
+            plProcessUevent(gcf);
+#endif
+
+        if (devIdx != -1) /* device connected */
+        {
+            if (fds[devIdx].revents & (POLLHUP | POLLERR | POLLNVAL))
             {
                 PL_Disconnect();
                 continue;
             }
 
-            if (fds[1].revents & POLLIN)
+            if (fds[devIdx].revents & POLLIN)
             {
-                nread = (int) read(fds[1].fd, platform.rxbuf, sizeof(platform.rxbuf));
+                nread = (int) read(fds[devIdx].fd, platform.rxbuf, sizeof(platform.rxbuf));
 
                 if (nread > 0)
                 {
@@ -515,7 +1188,8 @@ static int PL_Loop(GCF *gcf)
 
             if (nread <= 0)
             {
-                platform.running = 0;
+                platform.inputClosed = 1;
+                GCF_HandleEvent(gcf, EV_INPUT_CLOSED);
                 continue;
             }
 
@@ -564,6 +1238,13 @@ static int PL_Loop(GCF *gcf)
 
     PL_Disconnect();
 
+    if (platform.ueventFd != -1)
+        close(platform.ueventFd);
+
+#ifdef HAS_LIBGPIOD
+    plExitLibGpiod();
+#endif
+
     return 1;
 }
 
@@ -574,6 +1255,7 @@ int main(int argc, char *argv[])
     atexit(PL_AtExit);
     signal(SIGINT, PL_SignalHandler);
     signal(SIGTERM, PL_SignalHandler);
+    signal(SIGUSR1, PL_TriggerSignalHandler);
 
     gcf = GCF_Init(argc, argv);
     if (gcf == NULL)
@@ -583,5 +1265,5 @@ int main(int argc, char *argv[])
 
     GCF_Exit(gcf);
 
-    return 0;
+    return (plReplay.mismatches || shutdown_signal) ? 1 : 0;
 }
\ No newline at end of file
@@ -26,6 +26,7 @@
 #include <stdarg.h>
 
 #include "gcf.h"
+#include "metrics.h"
 #include "u_sstream.h"
 #include "u_strlen.h"
 #include "u_mem.h"
@@ -118,6 +119,20 @@ PL_time_t PL_Time(void)
     return GetTickCount();
 }
 
+/*! Returns the wall clock time in milliseconds since 1970-01-01 UTC. */
+PL_time_t PL_WallTime(void)
+{
+    FILETIME ft;
+    ULARGE_INTEGER t;
+
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+
+    /* 100 ns intervals since 1601-01-01 */
+    return (t.QuadPart - 116444736000000000ULL) / 10000;
+}
+
 /*! Lets the programm sleep for \p ms milliseconds. */
 void PL_MSleep(unsigned long ms)
 {
@@ -586,7 +601,38 @@ void PL_Disconnect(void)
         CloseHandle(platform.fd);
         platform.fd = INVALID_HANDLE_VALUE;
     }
-    GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+    /* after PL_ShutDown() the state machine would take it as a finished
+       reset and report success for an aborted run */
+    if (platform.running)
+        GCF_HandleEvent(platform.gcf, EV_DISCONNECTED);
+}
+
+PL_Handle PL_SerialOpen(const char *path, PL_Baudrate baudrate)
+{
+    (void)path;
+    (void)baudrate;
+    return 0; /* not supported, see PL_AddPollHandle() */
+}
+
+int PL_SerialRead(PL_Handle handle, unsigned char *buf, unsigned size)
+{
+    (void)handle;
+    (void)buf;
+    (void)size;
+    return -1;
+}
+
+int PL_SerialWrite(PL_Handle handle, const unsigned char *data, unsigned len)
+{
+    (void)handle;
+    (void)data;
+    (void)len;
+    return -1;
+}
+
+void PL_SerialClose(PL_Handle handle)
+{
+    (void)handle;
 }
 
 /*! Shuts down platform layer (ends main loop). */
@@ -595,6 +641,13 @@ void PL_ShutDown(void)
     platform.running = 0;
 }
 
+int PL_StartReplay(const char *path, int realtime)
+{
+    (void)path;
+    (void)realtime;
+    return 0; /* not supported */
+}
+
 /*! Executes a MCU reset for ConBee I via FTDI CBUS0 reset. */
 int PL_ResetFTDI(int num, const char *serialnum)
 {
@@ -688,9 +741,25 @@ err_close:
     return -1;
 }
 
+int PL_ResetFTDIDevices(const char *const *serialnums, unsigned count)
+{
+    int n;
+    unsigned i;
+
+    for (i = 0, n = 0; i < count; i++)
+    {
+        if (PL_ResetFTDI((int)i, serialnums[i]) == 0)
+            n++;
+    }
+
+    return n ? n : -1;
+}
+
 /*! Executes a MCU reset for RaspBee I / II via GPIO17 reset pin. */
-int PL_ResetRaspBee(void)
+int PL_ResetRaspBee(const char *gpiochip, unsigned line)
 {
+    (void)gpiochip;
+    (void)line;
     return -1;
 }
 
@@ -726,6 +795,126 @@ int PL_ReadFile(const char *path, unsigned char *buf, unsigned long buflen)
     return result;
 }
 
+PL_File PL_FileOpen(const char *path, int mode)
+{
+    HANDLE hFile;
+
+    if (path[0] == '-' && path[1] == '\0')
+    {
+        hFile = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    else
+    {
+        hFile = CreateFile(path,
+                           mode == PL_FILE_APPEND ? FILE_APPEND_DATA : GENERIC_WRITE,
+                           FILE_SHARE_READ,
+                           NULL,
+                           mode == PL_FILE_APPEND ? OPEN_ALWAYS : CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL,
+                           NULL);
+    }
+
+    if (hFile == INVALID_HANDLE_VALUE || hFile == NULL)
+    {
+        return 0;
+    }
+
+    return (PL_File)hFile;
+}
+
+int PL_FileWrite(PL_File file, const void *data, unsigned long len)
+{
+    DWORD nwritten = 0;
+
+    if (!WriteFile((HANDLE)file, data, (DWORD)len, &nwritten, NULL))
+    {
+        return -1;
+    }
+
+    return (int)nwritten;
+}
+
+void PL_FileClose(PL_File file)
+{
+    if ((HANDLE)file != GetStdHandle(STD_OUTPUT_HANDLE))
+        CloseHandle((HANDLE)file);
+}
+
+int PL_ReplaceFile(const char *path, const void *data, unsigned long len)
+{
+    (void)path;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int PL_GetCachePath(const char *name, char *buf, unsigned size)
+{
+    (void)name;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+int PL_GetDeviceNodeId(const char *path, unsigned long long *id)
+{
+    (void)path;
+    (void)id;
+    return 0; /* COM ports have no stable identity, cache isn't used */
+}
+
+void PL_EnableHotplug(void)
+{
+}
+
+void *PL_SharedMemoryOpen(const char *name, unsigned long size)
+{
+    HANDLE hMap;
+    void *mem;
+    char path[MAX_DEV_PATH_LENGTH];
+    U_SStream ss;
+
+    U_sstream_init(&ss, &path[0], sizeof(path));
+    U_sstream_put_str(&ss, "Local\\");
+    U_sstream_put_str(&ss, name);
+
+    hMap = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, ss.str);
+    if (hMap == NULL)
+    {
+        return 0;
+    }
+
+    mem = MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(hMap); /* the view keeps the mapping alive */
+
+    return mem;
+}
+
+void PL_SharedMemoryClose(void *mem, unsigned long size)
+{
+    (void)size;
+    if (mem)
+        UnmapViewOfFile(mem);
+}
+
+void *PL_MemoryAlloc(unsigned long size)
+{
+    return VirtualAlloc(NULL, (SIZE_T)size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+/* Only main_posix.c polls further handles, so the network server, bridge,
+   metrics endpoint and inventory are not available on this platform.
+*/
+int PL_AddPollHandle(PL_Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+void PL_RemovePollHandle(PL_Handle handle)
+{
+    (void)handle;
+}
 
 void PL_Print(const char *line)
 {
@@ -747,6 +936,14 @@ void PL_Print(const char *line)
  *           should be moved into gcf.c so that platform layers only
  *           need to provide PL_Print()
  */
+/* not in platform, which is cleared after GCF_Init() */
+static int plPrintStderr;
+
+void PL_SetPrintStderr(int enable)
+{
+    plPrintStderr = enable;
+}
+
 void PL_Printf(DebugLevel level, const char *format, ...)
 {
 #ifdef NDEBUG
@@ -834,7 +1031,12 @@ void PL_Printf(DebugLevel level, const char *format, ...)
 
     va_end (args);
 
-    if (ss.pos)
+    if (ss.pos && plPrintStderr)
+    {
+        DWORD written;
+        WriteFile(GetStdHandle(STD_ERROR_HANDLE), buf, (DWORD)ss.pos, &written, NULL);
+    }
+    else if (ss.pos)
     {
         PL_Print(buf);
     }
@@ -886,6 +1088,9 @@ int PROT_Write(const unsigned char *data, unsigned len)
         gcfDebugHex(platform.gcf, "send", data, len);
     }
 
+    METRICS_Add(METRICS_SERIAL_TX_BYTES, BytesWritten);
+    GCF_TraceSent(platform.gcf, data, (unsigned)BytesWritten);
+
     return (int)BytesWritten;
 }
 
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "metrics.h"
+
+#ifdef USE_METRICS
+#include "u_sstream.h"
+#include "u_strlen.h"
+#include "net_sock.h"
+
+typedef struct METRICS_State
+{
+    const char *addr;
+    PL_time_t startTime;
+    S_Stream listener;
+    S_Stream conn; /* single pending request */
+    unsigned rxPos;
+    char rx[METRICS_MAX_REQUEST + 1];
+    char tx[2048];
+    unsigned long long counters[METRICS_COUNTER_MAX];
+} METRICS_State;
+
+static METRICS_State metrics_state;
+
+static const struct
+{
+    const char *name;
+    const char *help;
+} metrics_info[METRICS_COUNTER_MAX] =
+{
+    { "gcf_serial_rx_bytes_total", "Bytes received from the serial device." },
+    { "gcf_serial_tx_bytes_total", "Bytes written to the serial device." },
+    { "gcf_serial_crc_errors_total", "SLIP frames dropped due to CRC mismatch." },
+    { "gcf_frames_total", "Frames decoded from the serial device." },
+    { "gcf_udp_sent_total", "Sniffer UDP datagrams sent." },
+    { "gcf_udp_send_errors_total", "Sniffer UDP datagrams which failed to send." },
+    { "gcf_reconnects_total", "Device disconnects in long running modes." }
+};
+
+void METRICS_Add(METRICS_Counter counter, unsigned long n)
+{
+    metrics_state.counters[counter] += n;
+}
+
+int METRICS_Init(const char *addr)
+{
+    char host[16];
+    unsigned short port;
+
+    if (metrics_state.startTime == 0)
+        metrics_state.startTime = PL_Time();
+
+    /* called again on each retry, keep the socket */
+    if (metrics_state.listener.state == S_STREAM_STATE_LISTEN && metrics_state.addr == addr)
+        return 1;
+
+    METRICS_Exit();
+
+    if (SOCK_ParseHostPort(addr, &host[0], sizeof(host), &port) != 1)
+        return 0;
+
+    if (SOCK_StreamListenTcp(&metrics_state.listener, host[0] ? host : "127.0.0.1", port) != 1)
+        return 0;
+
+    if (PL_AddPollHandle((PL_Handle)metrics_state.listener.handle) != 1)
+    {
+        SOCK_StreamFree(&metrics_state.listener);
+        return 0;
+    }
+
+    metrics_state.addr = addr;
+    PL_Printf(DBG_INFO, "metrics on http://%s:%u/metrics\n", host[0] ? host : "127.0.0.1", (unsigned)port);
+
+    return 1;
+}
+
+static void metricsClose(void)
+{
+    if (metrics_state.conn.state == S_STREAM_STATE_INIT)
+        return;
+
+    PL_RemovePollHandle((PL_Handle)metrics_state.conn.handle);
+    SOCK_StreamFree(&metrics_state.conn);
+    metrics_state.rxPos = 0;
+}
+
+static void metricsPutHeader(U_SStream *ss, const char *name, const char *help, const char *type)
+{
+    U_sstream_put_str(ss, "# HELP ");
+    U_sstream_put_str(ss, name);
+    U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, help);
+    U_sstream_put_str(ss, "\n# TYPE ");
+    U_sstream_put_str(ss, name);
+    U_sstream_put_str(ss, " ");
+    U_sstream_put_str(ss, type);
+    U_sstream_put_str(ss, "\n");
+}
+
+static void metricsRespond(void)
+{
+    unsigned i;
+    U_SStream ss;
+    U_SStream req;
+
+    U_sstream_init(&ss, &metrics_state.tx[0], sizeof(metrics_state.tx));
+    U_sstream_init(&req, &metrics_state.rx[0], metrics_state.rxPos);
+
+    if (!U_sstream_starts_with(&req, "GET /metrics ") && !U_sstream_starts_with(&req, "GET / "))
+    {
+        U_sstream_put_str(&ss, "HTTP/1.0 404 Not Found\r\n"
+                               "Content-Length: 0\r\n"
+                               "Connection: close\r\n\r\n");
+    }
+    else
+    {
+        U_sstream_put_str(&ss, "HTTP/1.0 200 OK\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Connection: close\r\n\r\n");
+
+        for (i = 0; i < METRICS_COUNTER_MAX; i++)
+        {
+            metricsPutHeader(&ss, metrics_info[i].name, metrics_info[i].help, "counter");
+            U_sstream_put_str(&ss, metrics_info[i].name);
+            U_sstream_put_str(&ss, " ");
+            U_sstream_put_ulonglong(&ss, metrics_state.counters[i]);
+            U_sstream_put_str(&ss, "\n");
+        }
+
+        metricsPutHeader(&ss, "gcf_uptime_seconds", "Seconds since start.", "gauge");
+        U_sstream_put_str(&ss, "gcf_uptime_seconds ");
+        U_sstream_put_ulonglong(&ss, (unsigned long long)((PL_Time() - metrics_state.startTime) / 1000));
+        U_sstream_put_str(&ss, "\n");
+
+        metricsPutHeader(&ss, "gcf_state", "Current state of the state machine.", "gauge");
+        U_sstream_put_str(&ss, "gcf_state{state=\"");
+        U_sstream_put_str(&ss, METRICS_StateName());
+        U_sstream_put_str(&ss, "\"} 1\n");
+    }
+
+    Assert(ss.status == U_SSTREAM_OK);
+
+    /* fits into the socket buffer, a partial write only truncates the reply */
+    SOCK_StreamSend(&metrics_state.conn, (unsigned char*)ss.str, ss.pos);
+    metricsClose();
+}
+
+static void metricsAccept(void)
+{
+    S_Stream conn;
+
+    if (SOCK_StreamAccept(&metrics_state.listener, &conn) != 1)
+        return;
+
+    /* a stalled scraper is replaced */
+    metricsClose();
+
+    if (PL_AddPollHandle((PL_Handle)conn.handle) != 1)
+    {
+        SOCK_StreamFree(&conn);
+        return;
+    }
+
+    metrics_state.conn = conn;
+    metrics_state.rxPos = 0;
+}
+
+int METRICS_Readable(PL_Handle handle)
+{
+    int n;
+    U_SStream ss;
+
+    if (metrics_state.listener.state == S_STREAM_STATE_LISTEN && handle == (PL_Handle)metrics_state.listener.handle)
+    {
+        metricsAccept();
+        return 1;
+    }
+
+    if (metrics_state.conn.state != S_STREAM_STATE_CONNECTED || handle != (PL_Handle)metrics_state.conn.handle)
+        return 0;
+
+    n = SOCK_StreamRecv(&metrics_state.conn, (unsigned char*)&metrics_state.rx[metrics_state.rxPos],
+                        METRICS_MAX_REQUEST - metrics_state.rxPos);
+
+    if (n < 0)
+    {
+        metricsClose();
+        return 1;
+    }
+
+    metrics_state.rxPos += (unsigned)n;
+    metrics_state.rx[metrics_state.rxPos] = '\0';
+
+    /* respond when the request header is complete */
+    U_sstream_init(&ss, &metrics_state.rx[0], metrics_state.rxPos);
+
+    if (U_sstream_find(&ss, "\r\n\r\n") || U_sstream_find(&ss, "\n\n"))
+        metricsRespond();
+    else if (metrics_state.rxPos == METRICS_MAX_REQUEST)
+        metricsClose();
+
+    return 1;
+}
+
+void METRICS_Exit(void)
+{
+    metricsClose();
+
+    if (metrics_state.listener.state != S_STREAM_STATE_INIT)
+    {
+        PL_RemovePollHandle((PL_Handle)metrics_state.listener.handle);
+        SOCK_StreamFree(&metrics_state.listener);
+    }
+
+    metrics_state.addr = 0;
+}
+
+#else
+void METRICS_Add(METRICS_Counter counter, unsigned long n)
+{
+    (void)counter;
+    (void)n;
+}
+
+int METRICS_Init(const char *addr)
+{
+    (void)addr;
+    return 0;
+}
+
+int METRICS_Readable(PL_Handle handle)
+{
+    (void)handle;
+    return 0;
+}
+
+void METRICS_Exit(void)
+{
+}
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "gcf.h"
+
+/* Metrics endpoint
+
+   Counters for long running modes (sniffer, connect, bridge), served in
+   the Prometheus text exposition format from the main loop. Each
+   connection gets a single HTTP/1.0 response and is closed.
+
+   Without USE_METRICS the functions are no-ops.
+*/
+#define METRICS_MAX_REQUEST 512
+
+typedef enum METRICS_Counter
+{
+    METRICS_SERIAL_RX_BYTES = 0,
+    METRICS_SERIAL_TX_BYTES,
+    METRICS_CRC_ERRORS,
+    METRICS_FRAMES,
+    METRICS_UDP_SENT,
+    METRICS_UDP_FAILED,
+    METRICS_RECONNECTS,
+    METRICS_COUNTER_MAX
+} METRICS_Counter;
+
+void METRICS_Add(METRICS_Counter counter, unsigned long n);
+/*! Listens on "[<ip>:]<port>", default address is 127.0.0.1. The socket
+    is kept when called again with the same address.
+ */
+int METRICS_Init(const char *addr);
+/*! \returns 1 if \p handle belongs to the endpoint and was processed. */
+int METRICS_Readable(PL_Handle handle);
+void METRICS_Exit(void);
+
+/* callback implemented in gcf.c, name of the current state */
+const char *METRICS_StateName(void);
+
+#endif /* METRICS_H */
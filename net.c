@@ -8,101 +8,284 @@
  *
  */
 
-#define MAX_NET_CLIENTS 4
-
-#include <stdio.h>
+#define NET_RX_BATCH 16
 
+#include "gcf.h"
 #include "u_mem.h"
 #include "net.h"
 
 #ifdef USE_NET
 #include "net_sock.h"
 
+#ifndef NDEBUG
+  #include "u_sstream.h"
+#endif
+
+/* Clients are kept in a fixed pool, the pool index is the client id.
+   The hash table maps (af, address, port) to pool indices using linear
+   probing, it is twice the pool size to keep probe sequences short.
+*/
+#define NET_HASH_SIZE (NET_MAX_CLIENTS * 2)
+#define NET_HASH_EMPTY 0xFFFF
+
 typedef struct NET_Client
 {
     S_Addr addr;
     unsigned short port;
+    unsigned char used;
+    unsigned short pins; /* NET_PinClient() references, not evicted */
+    PL_time_t last_seen;
 } NET_Client;
 
 typedef struct NET_State
 {
     S_Udp udp_main;
-    unsigned char rx_buf[1280 + 1];
+    S_UdpMsg rx_msgs[NET_RX_BATCH];
+    unsigned char rx_buf[NET_RX_BATCH][S_UDP_MAX_PKG_SIZE + 1];
 
     unsigned n_clients;
-    NET_Client clients[MAX_NET_CLIENTS];
+    unsigned max_clients;
+    PL_time_t client_ttl;
+    NET_Client clients[NET_MAX_CLIENTS];
+    unsigned short hash[NET_HASH_SIZE];
 
 } NET_State;
 
 static NET_State net_state;
 
+static void netResetClients(void)
+{
+    unsigned i;
+
+    net_state.n_clients = 0;
+
+    for (i = 0; i < NET_MAX_CLIENTS; i++)
+        net_state.clients[i].used = 0;
+
+    for (i = 0; i < NET_HASH_SIZE; i++)
+        net_state.hash[i] = NET_HASH_EMPTY;
+}
+
 int NET_Init(const char *interface, unsigned short port)
 {
+    unsigned i;
     S_Udp *sock;
+
+    sock = &net_state.udp_main;
+
+    if (!interface)
+        interface = NET_DEFAULT_INTERFACE;
+
+    /* called again on each retry, keep the socket */
+    if (sock->state == S_UDP_STATE_OPEN && sock->port == port)
+        return 1;
+
+    if (sock->state != S_UDP_STATE_INIT)
+        NET_Exit();
+
     SOCK_Init();
 
-    net_state.n_clients = 0;
+    netResetClients();
 
-    (void)interface; /* TODO */
-    sock = &net_state.udp_main;
+    if (net_state.max_clients == 0)
+        NET_SetClientLimits(NET_DEFAULT_CLIENTS, NET_DEFAULT_CLIENT_TTL);
+
+    for (i = 0; i < NET_RX_BATCH; i++)
+        net_state.rx_msgs[i].buf = &net_state.rx_buf[i][0];
 
     if (SOCK_UdpInit(sock, S_AF_IPV4) != 1)
         goto err1;
 
-    if (SOCK_UdpBind(sock, port) != 1)
+    if (SOCK_UdpBind(sock, interface, port) != 1)
+        goto err1;
+
+    if (PL_AddPollHandle((PL_Handle)sock->handle) != 1)
         goto err1;
 
     return 1;
 
 err1:
+    SOCK_UdpFree(sock);
     return 0;
 }
 
-static int netCheckNewClient(void)
+static unsigned netAddrLength(const S_Addr *addr)
+{
+    return addr->af == S_AF_IPV4 ? 4 : 16;
+}
+
+static unsigned netHash(const S_Addr *addr, unsigned short port)
+{
+    unsigned i;
+    unsigned long h;
+
+    h = 2166136261UL; /* FNV-1a */
+    h = ((h ^ addr->af) * 16777619UL) & 0xFFFFFFFF;
+    h = ((h ^ (port & 0xFF)) * 16777619UL) & 0xFFFFFFFF;
+    h = ((h ^ (port >> 8)) * 16777619UL) & 0xFFFFFFFF;
+
+    for (i = 0; i < netAddrLength(addr); i++)
+        h = ((h ^ addr->data[i]) * 16777619UL) & 0xFFFFFFFF;
+
+    return (unsigned)(h & (NET_HASH_SIZE - 1));
+}
+
+static int netClientEquals(const NET_Client *client, const S_Addr *addr, unsigned short port)
+{
+    unsigned i;
+
+    if (client->port != port || client->addr.af != addr->af)
+        return 0;
+
+    for (i = 0; i < netAddrLength(addr); i++)
+    {
+        if (client->addr.data[i] != addr->data[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Removes client \p id from pool and hash table (backward shift deletion). */
+static void netRemoveClient(unsigned id)
 {
     unsigned i;
     unsigned j;
-    unsigned addr_len;
-    S_Udp *sock;
+    unsigned home;
     NET_Client *client;
 
-    sock = &net_state.udp_main;
-    client = &net_state.clients[0];
+    client = &net_state.clients[id];
+    i = netHash(&client->addr, client->port);
+
+    for (; net_state.hash[i] != id; i = (i + 1) & (NET_HASH_SIZE - 1))
+    {
+        Assert(net_state.hash[i] != NET_HASH_EMPTY);
+    }
+
+    for (j = i;;)
+    {
+        net_state.hash[i] = NET_HASH_EMPTY;
+
+        for (;;)
+        {
+            j = (j + 1) & (NET_HASH_SIZE - 1);
+            if (net_state.hash[j] == NET_HASH_EMPTY)
+                goto done;
+
+            /* entry j may move to i if its home slot isn't in (i, j] */
+            home = netHash(&net_state.clients[net_state.hash[j]].addr, net_state.clients[net_state.hash[j]].port);
+            if (i <= j ? (home <= i || home > j) : (home <= i && home > j))
+                break;
+        }
+
+        net_state.hash[i] = net_state.hash[j];
+        i = j;
+    }
+
+done:
+    client->used = 0;
+    net_state.n_clients--;
+}
+
+static void netEvictClients(PL_time_t now)
+{
+    unsigned i;
+
+    for (i = 0; i < NET_MAX_CLIENTS && net_state.n_clients; i++)
+    {
+        if (net_state.clients[i].used && net_state.clients[i].pins == 0 &&
+            net_state.clients[i].last_seen + net_state.client_ttl < now)
+        {
+            PL_Printf(DBG_DEBUG, "NET client %u expired\n", i);
+            netRemoveClient(i);
+        }
+    }
+}
+
+/* \returns the client id of the sender of \p msg, or -1 if the table is full. */
+static int netCheckNewClient(const S_UdpMsg *msg)
+{
+    unsigned i;
+    unsigned id;
+    PL_time_t now;
+    NET_Client *client;
+
+    now = PL_Time();
+    i = netHash(&msg->peer_addr, msg->peer_port);
+
+    for (; net_state.hash[i] != NET_HASH_EMPTY; i = (i + 1) & (NET_HASH_SIZE - 1))
+    {
+        client = &net_state.clients[net_state.hash[i]];
+        if (netClientEquals(client, &msg->peer_addr, msg->peer_port))
+        {
+            client->last_seen = now;
+            return (int)net_state.hash[i];
+        }
+    }
 
-    for (i = 0; i < net_state.n_clients; i++, client++)
+    if (net_state.n_clients >= net_state.max_clients)
     {
-        if (sock->peer_port == client->port && sock->peer_addr.af == client->addr.af)
+        netEvictClients(now);
+
+        if (net_state.n_clients >= net_state.max_clients)
         {
-            addr_len = (client->addr.af == S_AF_IPV4) ? 4 : 16;
-            for (j = 0; j < addr_len; j++)
-            {
-                if (sock->peer_addr.data[j] != client->addr.data[j])
-                    break;
-            }
-
-            if (j == addr_len)
-            {
-                // already known TODO refresh ttl
-                return (int)i;
-            }
+            PL_Printf(DBG_DEBUG, "NET client table full (%u)\n", net_state.max_clients);
+            return -1;
         }
+
+        /* slot i might have been shifted */
+        i = netHash(&msg->peer_addr, msg->peer_port);
+        for (; net_state.hash[i] != NET_HASH_EMPTY; i = (i + 1) & (NET_HASH_SIZE - 1))
+        { }
     }
 
-    if (net_state.n_clients < MAX_NET_CLIENTS)
+    for (id = 0; net_state.clients[id].used; id++)
     {
-        client = &net_state.clients[net_state.n_clients];
-        client->port = sock->peer_port;
-        U_memcpy(&client->addr, &sock->peer_addr, sizeof(sock->peer_addr));
-        net_state.n_clients++;
-        return (int)net_state.n_clients - 1;
+        Assert(id < NET_MAX_CLIENTS);
+    }
+
+    client = &net_state.clients[id];
+    client->used = 1;
+    client->pins = 0;
+    client->port = msg->peer_port;
+    client->last_seen = now;
+    U_memcpy(&client->addr, &msg->peer_addr, sizeof(msg->peer_addr));
+
+    net_state.hash[i] = (unsigned short)id;
+    net_state.n_clients++;
+
+    return (int)id;
+}
+
+#ifndef NDEBUG
+static void netDebugPeer(const S_UdpMsg *msg)
+{
+    unsigned i;
+    U_SStream ss;
+    char buf[64];
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+
+    if (msg->peer_addr.af == S_AF_IPV4)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            if (i) U_sstream_put_str(&ss, ".");
+            U_sstream_put_long(&ss, msg->peer_addr.data[i]);
+        }
     }
     else
     {
-        /* clients exhausted (send error to last client?) */
+        for (i = 0; i < 16; i += 2)
+        {
+            if (i) U_sstream_put_str(&ss, ":");
+            U_sstream_put_hex(&ss, &msg->peer_addr.data[i], 2);
+        }
     }
 
-    return -1;
+    PL_Printf(DBG_DEBUG, "UDP peer %s port: %u\n", ss.str, (unsigned)msg->peer_port);
 }
+#endif
 
 int NET_Step(void)
 {
@@ -110,23 +293,88 @@ int NET_Step(void)
         echo -n "hello" >/dev/udp/127.0.0.1/19817
      */
 
+    int i;
     int n;
     int client_id;
+    S_UdpMsg *msg;
 
-    n = SOCK_UdpRecv(&net_state.udp_main, net_state.rx_buf, sizeof(net_state.rx_buf) - 1);
-    if (n > 0)
+    /* drain all pending datagrams */
+    do
     {
-        client_id = netCheckNewClient();
-        net_state.rx_buf[n] = '\0';
-        NET_Received(client_id, net_state.rx_buf, (unsigned)n);
-    }
+        n = SOCK_UdpRecvBatch(&net_state.udp_main, &net_state.rx_msgs[0], NET_RX_BATCH, S_UDP_MAX_PKG_SIZE + 1);
+
+        for (i = 0; i < n; i++)
+        {
+            msg = &net_state.rx_msgs[i];
+            if (msg->len == 0) /* dropped by SOCK_UdpRecvBatch() */
+                continue;
+#ifndef NDEBUG
+            netDebugPeer(msg);
+#endif
+            client_id = netCheckNewClient(msg);
+            msg->buf[msg->len] = '\0';
+            NET_Received(client_id, msg->buf, msg->len);
+        }
+    } while (n == NET_RX_BATCH);
 
     return 1;
 }
 
+int NET_Send(int client_id, const unsigned char *buf, unsigned bufsize)
+{
+    S_Udp *sock;
+    NET_Client *client;
+
+    if (client_id < 0 || client_id >= NET_MAX_CLIENTS)
+        return -1;
+
+    client = &net_state.clients[client_id];
+    sock = &net_state.udp_main;
+
+    if (!client->used || sock->state != S_UDP_STATE_OPEN)
+        return -1;
+
+    client->last_seen = PL_Time();
+    sock->peer_port = client->port;
+    U_memcpy(&sock->peer_addr, &client->addr, sizeof(client->addr));
+
+    return SOCK_UdpSend(sock, (unsigned char*)buf, bufsize);
+}
+
+void NET_PinClient(int client_id, int pin)
+{
+    NET_Client *client;
+
+    if (client_id < 0 || client_id >= NET_MAX_CLIENTS)
+        return;
+
+    client = &net_state.clients[client_id];
+
+    if (!client->used)
+        return;
+
+    if (pin)
+        client->pins++;
+    else if (client->pins)
+        client->pins--;
+}
+
+void NET_SetClientLimits(unsigned max_clients, unsigned long ttl)
+{
+    if (max_clients == 0 || max_clients > NET_MAX_CLIENTS)
+        max_clients = NET_MAX_CLIENTS;
+
+    net_state.max_clients = max_clients;
+    net_state.client_ttl = (PL_time_t)ttl * 1000;
+}
+
 void NET_Exit(void)
 {
-    net_state.n_clients = 0;
+    netResetClients();
+
+    if (net_state.udp_main.state != S_UDP_STATE_INIT)
+        PL_RemovePollHandle((PL_Handle)net_state.udp_main.handle);
+
     SOCK_UdpFree(&net_state.udp_main);
 }
 
@@ -143,6 +391,26 @@ int NET_Step(void)
     return 0;
 }
 
+int NET_Send(int client_id, const unsigned char *buf, unsigned bufsize)
+{
+    (void)client_id;
+    (void)buf;
+    (void)bufsize;
+    return -1;
+}
+
+void NET_PinClient(int client_id, int pin)
+{
+    (void)client_id;
+    (void)pin;
+}
+
+void NET_SetClientLimits(unsigned max_clients, unsigned long ttl)
+{
+    (void)max_clients;
+    (void)ttl;
+}
+
 void NET_Exit(void)
 {
 }
@@ -11,8 +11,28 @@
 #ifndef NET_H
 #define NET_H
 
+#define NET_MAX_CLIENTS 1024
+#define NET_DEFAULT_CLIENTS 64
+#define NET_DEFAULT_CLIENT_TTL 300 /* seconds */
+#define NET_DEFAULT_INTERFACE "127.0.0.1"
+
+/*! Opens the UDP server socket on IPv4 address \p interface and \p port,
+    0 listens on NET_DEFAULT_INTERFACE only.
+    POSIX only, the socket is polled via PL_AddPollHandle().
+ */
 int NET_Init(const char *interface, unsigned short port);
+/*! Sets the max. number of clients and the time in seconds after which an
+    inactive client is removed when the table is full. */
+void NET_SetClientLimits(unsigned max_clients, unsigned long ttl);
 int NET_Step(void);
+/*! Sends a datagram to client \p client_id, counts as client activity.
+    \returns number of bytes sent or -1 on error.
+ */
+int NET_Send(int client_id, const unsigned char *buf, unsigned bufsize);
+/*! A pinned client isn't evicted, so its id stays valid, e.g. while it
+    owns queued jobs. Each pin (\p pin = 1) needs a matching unpin (0).
+ */
+void NET_PinClient(int client_id, int pin);
 void NET_Exit(void);
 
 /* callback implemented in gcf.c */
@@ -26,4 +26,36 @@ int SOCK_GetHostAF(const char *host)
     }
 
     return S_AF_UNKNOWN;
-}
\ No newline at end of file
+}
+
+int SOCK_ParseHostPort(const char *str, char *host, unsigned hostsize, unsigned short *port)
+{
+    unsigned i;
+    unsigned long val;
+
+    host[0] = '\0';
+
+    for (i = 0; str[i] && str[i] != ':'; i++)
+    { }
+
+    if (str[i] == ':')
+    {
+        if (i >= hostsize)
+            return 0;
+
+        for (i = 0; str[i] != ':'; i++)
+            host[i] = str[i];
+
+        host[i] = '\0';
+        str = &str[i + 1];
+    }
+
+    for (i = 0, val = 0; str[i] >= '0' && str[i] <= '9' && val <= 65535; i++)
+        val = val * 10 + (unsigned long)(str[i] - '0');
+
+    if (i == 0 || str[i] != '\0' || val < 1 || val > 65535)
+        return 0;
+
+    *port = (unsigned short)val;
+    return 1;
+}
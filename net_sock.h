@@ -25,6 +25,28 @@ typedef struct S_Addr
     unsigned  char af;
 } S_Addr;
 
+typedef struct S_UdpMsg
+{
+    S_Addr peer_addr;
+    unsigned short peer_port;
+    unsigned len;
+    unsigned char *buf; /* provided by caller */
+} S_UdpMsg;
+
+typedef enum S_StreamState
+{
+    S_STREAM_STATE_INIT =      0,
+    S_STREAM_STATE_LISTEN =    1,
+    S_STREAM_STATE_CONNECTED = 2
+} S_StreamState;
+
+/* TCP or Unix domain stream socket, non-blocking */
+typedef struct S_Stream
+{
+    S_Handle handle;
+    S_StreamState state;
+} S_Stream;
+
 typedef struct S_Udp
 {
     S_Addr addr;
@@ -39,13 +61,40 @@ int SOCK_Init();
 void SOCK_Free();
 
 int SOCK_GetHostAF(const char *host);
+/*! Splits "[<ipv4>:]<port>", \p host is empty if no address is given. */
+int SOCK_ParseHostPort(const char *str, char *host, unsigned hostsize, unsigned short *port);
 
 int SOCK_UdpInit(S_Udp *udp, int af);
 int SOCK_UdpSetPeer(S_Udp *udp, const char *peer, unsigned short port);
-int SOCK_UdpBind(S_Udp *udp, unsigned short port);
+/*! Binds to address \p addr of the socket family (0 for any) and \p port. */
+int SOCK_UdpBind(S_Udp *udp, const char *addr, unsigned short port);
 int SOCK_UdpJoinMulticast(S_Udp *udp, const char *maddr);
 int SOCK_UdpSend(S_Udp *udp, unsigned char *buf, unsigned bufsize);
 int SOCK_UdpRecv(S_Udp *udp, unsigned char *buf, unsigned bufsize);
+/*! Receives up to \p count datagrams without blocking, each \p msgs[i].buf
+    must hold \p bufsize bytes. Datagrams which don't fit or have an unknown
+    address family are dropped, their \p msgs[i].len is 0.
+
+    \returns number of received datagrams including dropped ones, so that
+    \p count means more may be pending, 0 if none is pending or -1 on error.
+    POSIX only, like the stream sockets below.
+ */
+int SOCK_UdpRecvBatch(S_Udp *udp, S_UdpMsg *msgs, unsigned count, unsigned bufsize);
 void SOCK_UdpFree(S_Udp *udp);
 
+/*! Listens on IPv4 address \p addr (0 for any) and \p port. */
+int SOCK_StreamListenTcp(S_Stream *st, const char *addr, unsigned short port);
+/*! Listens on Unix domain socket \p path, a stale socket file is replaced.
+    Fails if \p path exists and is not a socket. */
+int SOCK_StreamListenUnix(S_Stream *st, const char *path);
+/*! Accepts a pending connection of listening socket \p st into \p conn. */
+int SOCK_StreamAccept(S_Stream *st, S_Stream *conn);
+/*! \returns number of bytes sent without blocking or -1 on error. */
+int SOCK_StreamSend(S_Stream *st, const unsigned char *buf, unsigned bufsize);
+/*! \returns number of received bytes, 0 if none is pending or -1 if the
+    connection was closed or on error.
+ */
+int SOCK_StreamRecv(S_Stream *st, unsigned char *buf, unsigned bufsize);
+void SOCK_StreamFree(S_Stream *st);
+
 #endif /* NET_SOCK_H */
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "u_mem.h"
+#include "u_strlen.h"
+#include "net_sock.h"
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0 /* macOS, SO_NOSIGPIPE is set instead */
+#endif
+
+static int sockSetNonBlocking(int fd)
+{
+    int flags;
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1)
+        return 0;
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static int sockListen(S_Stream *st, int fd, const struct sockaddr *addr, socklen_t addrlen)
+{
+    U_bzero(st, sizeof(*st));
+
+    if (fd == -1)
+        return 0;
+
+    if (bind(fd, addr, addrlen) != 0 || listen(fd, 2) != 0 || !sockSetNonBlocking(fd))
+    {
+        close(fd);
+        return 0;
+    }
+
+    st->handle = fd;
+    st->state = S_STREAM_STATE_LISTEN;
+
+    return 1;
+}
+
+int SOCK_StreamListenTcp(S_Stream *st, const char *addr, unsigned short port)
+{
+    int fd;
+    int yes = 1;
+    struct sockaddr_in sa;
+
+    U_bzero(&sa, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (addr && inet_pton(AF_INET, addr, &sa.sin_addr) != 1)
+        return 0;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd != -1)
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
+
+    return sockListen(st, fd, (struct sockaddr*)&sa, sizeof(sa));
+}
+
+int SOCK_StreamListenUnix(S_Stream *st, const char *path)
+{
+    unsigned long len;
+    struct stat st_path;
+    struct sockaddr_un sa;
+
+    len = U_strlen(path);
+    if (len == 0 || len >= sizeof(sa.sun_path))
+        return 0;
+
+    U_bzero(&sa, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    U_memcpy(sa.sun_path, path, len + 1);
+
+    /* only replace a stale socket, never another kind of file */
+    if (lstat(path, &st_path) == 0)
+    {
+        if (!S_ISSOCK(st_path.st_mode))
+            return 0;
+
+        unlink(path);
+    }
+
+    return sockListen(st, socket(AF_UNIX, SOCK_STREAM, 0), (struct sockaddr*)&sa, sizeof(sa));
+}
+
+int SOCK_StreamAccept(S_Stream *st, S_Stream *conn)
+{
+    int fd;
+    int yes = 1;
+
+    U_bzero(conn, sizeof(*conn));
+
+    if (st->state != S_STREAM_STATE_LISTEN)
+        return 0;
+
+    fd = accept(st->handle, 0, 0);
+    if (fd == -1)
+        return 0;
+
+    if (!sockSetNonBlocking(fd))
+    {
+        close(fd);
+        return 0;
+    }
+
+    /* small frames should go out immediately, fails for Unix sockets */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (char*)&yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, (char*)&yes, sizeof(yes));
+#endif
+
+    conn->handle = fd;
+    conn->state = S_STREAM_STATE_CONNECTED;
+
+    return 1;
+}
+
+int SOCK_StreamSend(S_Stream *st, const unsigned char *buf, unsigned bufsize)
+{
+    ssize_t n;
+
+    if (st->state != S_STREAM_STATE_CONNECTED)
+        return -1;
+
+    n = send(st->handle, buf, (size_t)bufsize, MSG_NOSIGNAL);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+
+    return n < 0 ? -1 : (int)n;
+}
+
+int SOCK_StreamRecv(S_Stream *st, unsigned char *buf, unsigned bufsize)
+{
+    ssize_t n;
+
+    if (st->state != S_STREAM_STATE_CONNECTED)
+        return -1;
+
+    n = recv(st->handle, buf, (size_t)bufsize, 0);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return 0;
+
+    return n <= 0 ? -1 : (int)n;
+}
+
+void SOCK_StreamFree(S_Stream *st)
+{
+    if (st->state != S_STREAM_STATE_INIT)
+        close(st->handle);
+
+    U_bzero(st, sizeof(*st));
+    st->state = S_STREAM_STATE_INIT;
+}
@@ -65,12 +65,12 @@ int SOCK_UdpSetPeer(S_Udp *udp, const char *peer, unsigned short port)
     return -1;
 }
 
-int SOCK_UdpBind(S_Udp *udp, unsigned short port)
+int SOCK_UdpBind(S_Udp *udp, const char *addr, unsigned short port)
 {
     int ret;
     int yes = 1;
-    struct sockaddr_in addr;
-    struct sockaddr_in6 addr6;
+    struct sockaddr_in sa;
+    struct sockaddr_in6 sa6;
 
     if (udp->state != S_UDP_STATE_OPEN)
         return 0;
@@ -83,11 +83,15 @@ int SOCK_UdpBind(S_Udp *udp, unsigned short port)
 
     if (udp->addr.af == S_AF_IPV4)
     {
-        U_bzero(&addr, sizeof(addr));
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        addr.sin_port = htons(port);
-        ret = bind(udp->handle, (struct sockaddr*) &addr, sizeof(addr));
+        U_bzero(&sa, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_ANY);
+        sa.sin_port = htons(port);
+
+        if (addr && inet_pton(AF_INET, addr, &sa.sin_addr) != 1)
+            goto err;
+
+        ret = bind(udp->handle, (struct sockaddr*) &sa, sizeof(sa));
 
         if (ret == -1)
             goto err;
@@ -97,11 +101,15 @@ int SOCK_UdpBind(S_Udp *udp, unsigned short port)
     }
     else if (udp->addr.af == S_AF_IPV6)
     {
-        U_bzero(&addr6, sizeof(addr6));
-        addr6.sin6_family = AF_INET6;
-        addr6.sin6_addr = in6addr_any;
-        addr6.sin6_port = htons(port);
-        ret = bind(udp->handle, (struct sockaddr*) &addr6, sizeof(addr6));
+        U_bzero(&sa6, sizeof(sa6));
+        sa6.sin6_family = AF_INET6;
+        sa6.sin6_addr = in6addr_any;
+        sa6.sin6_port = htons(port);
+
+        if (addr && inet_pton(AF_INET6, addr, &sa6.sin6_addr) != 1)
+            goto err;
+
+        ret = bind(udp->handle, (struct sockaddr*) &sa6, sizeof(sa6));
 
         if (ret == -1)
             goto err;
@@ -185,75 +193,131 @@ int SOCK_UdpSend(S_Udp *udp, unsigned char *buf, unsigned bufsize)
 
     if (n < 0)
     {
-
         return -1;
     }
 
     return (int)n;
 }
 
-int SOCK_UdpRecv(S_Udp *udp, unsigned char *buf, unsigned bufsize)
+static void sockSetPeer(S_UdpMsg *msg, const struct sockaddr_storage *addr)
 {
-    ssize_t n;
-    fd_set readfds;
-    struct timeval tv;
+    const struct sockaddr_in *sa4;
+    const struct sockaddr_in6 *sa6;
+
+    if (addr->ss_family == AF_INET6)
+    {
+        sa6 = (const struct sockaddr_in6*)addr;
+        msg->peer_addr.af = S_AF_IPV6;
+        msg->peer_port = ntohs(sa6->sin6_port);
+        U_memcpy(&msg->peer_addr.data[0], &sa6->sin6_addr.s6_addr[0], 16);
+    }
+    else if (addr->ss_family == AF_INET)
+    {
+        sa4 = (const struct sockaddr_in*)addr;
+        msg->peer_addr.af = S_AF_IPV4;
+        msg->peer_port = ntohs(sa4->sin_port);
+        U_memcpy(&msg->peer_addr.data[0], &sa4->sin_addr.s_addr, 4);
+    }
+}
+
+#define S_UDP_MAX_BATCH 32
+
+int SOCK_UdpRecvBatch(S_Udp *udp, S_UdpMsg *msgs, unsigned count, unsigned bufsize)
+{
+    unsigned i;
+    int n;
+    struct sockaddr_storage addr[S_UDP_MAX_BATCH];
+    unsigned len;
+#ifdef __linux__
+    struct mmsghdr hdr[S_UDP_MAX_BATCH];
+    struct iovec iov[S_UDP_MAX_BATCH];
+#else
+    ssize_t nread;
     socklen_t addr_len;
-    struct sockaddr_in *sa4;
-    struct sockaddr_in6 *sa6;
-    struct sockaddr_storage addr;
-    char abuf[INET6_ADDRSTRLEN];
+#endif
 
     if (udp->state != S_UDP_STATE_OPEN)
         return -1;
 
-    /* TODO non blocking */
-    tv.tv_sec = 0;
-    tv.tv_usec = 5 * 1000; // 5 msec
-    FD_ZERO(&readfds);
-    FD_SET(udp->handle, &readfds);
-    // don't care about writefds and exceptfds:
-    select(udp->handle+1, &readfds, NULL, NULL, &tv);
-    if (FD_ISSET(udp->handle, &readfds))
+    if (count > S_UDP_MAX_BATCH)
+        count = S_UDP_MAX_BATCH;
+
+#ifdef __linux__
+    U_bzero(&hdr[0], sizeof(hdr[0]) * count);
+
+    for (i = 0; i < count; i++)
     {
-        addr_len = sizeof(addr);
-        n = recvfrom(udp->handle, buf, bufsize, 0, (struct sockaddr*)&addr, &addr_len);
-
-        if (addr.ss_family == AF_INET6)
-        {
-            sa6 = (struct sockaddr_in6*)&addr;
-            udp->peer_addr.af = S_AF_IPV6;
-            udp->peer_port = sa6->sin6_port;
-            U_memcpy(&udp->peer_addr.data[0], &sa6->sin6_addr.s6_addr[0], 16);
-        }
-        else if (addr.ss_family == AF_INET)
-        {
-            sa4 = (struct sockaddr_in*)&addr;
-            udp->peer_addr.af = S_AF_IPV4;
-            udp->peer_port = sa4->sin_port;
-            U_memcpy(&udp->peer_addr.data[0], &sa4->sin_addr.s_addr, 4);
-        }
-        else
-        {
-            return -1;
-        }
-
-        if (inet_ntop(addr.ss_family, (void*)&udp->peer_addr.data[0], &abuf[0], sizeof(abuf)))
-        {
-            fprintf(stderr, "UDP peer %s port: %u\n", &abuf[0], ntohs(udp->peer_port));
-        }
-
-        if (n > 0 && n < (ssize_t)bufsize)
-        {
-            return (int)n;
-        }
-        else if (n < 0)
-        {
-            fprintf(stderr, "UDP error %s\n", strerror(errno));
-            return -1;
-        }
+        iov[i].iov_base = msgs[i].buf;
+        iov[i].iov_len = bufsize;
+        hdr[i].msg_hdr.msg_iov = &iov[i];
+        hdr[i].msg_hdr.msg_iovlen = 1;
+        hdr[i].msg_hdr.msg_name = &addr[i];
+        hdr[i].msg_hdr.msg_namelen = sizeof(addr[i]);
     }
 
-    return 0;
+    n = recvmmsg(udp->handle, &hdr[0], count, MSG_DONTWAIT, NULL);
+#else
+    for (n = 0; (unsigned)n < count; n++)
+    {
+        addr_len = sizeof(addr[n]);
+        nread = recvfrom(udp->handle, msgs[n].buf, bufsize, MSG_DONTWAIT, (struct sockaddr*)&addr[n], &addr_len);
+        if (nread < 0)
+            break;
+
+        msgs[n].len = (unsigned)nread;
+    }
+
+    if (n == 0)
+        n = -1;
+#endif
+
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return 0;
+
+        return -1;
+    }
+
+    for (i = 0; i < (unsigned)n; i++)
+    {
+#ifdef __linux__
+        len = hdr[i].msg_len;
+        if (hdr[i].msg_hdr.msg_flags & MSG_TRUNC)
+            len = 0;
+#else
+        len = msgs[i].len;
+#endif
+        if (len >= bufsize || (addr[i].ss_family != AF_INET && addr[i].ss_family != AF_INET6))
+            len = 0; /* dropped */
+
+        msgs[i].len = len;
+        if (len)
+            sockSetPeer(&msgs[i], &addr[i]);
+    }
+
+    return n;
+}
+
+int SOCK_UdpRecv(S_Udp *udp, unsigned char *buf, unsigned bufsize)
+{
+    int n;
+    S_UdpMsg msg;
+
+    msg.buf = buf;
+    n = SOCK_UdpRecvBatch(udp, &msg, 1, bufsize);
+
+    if (n == 1)
+    {
+        if (msg.len == 0) /* dropped */
+            return 0;
+
+        udp->peer_addr = msg.peer_addr;
+        udp->peer_port = msg.peer_port;
+        return (int)msg.len;
+    }
+
+    return n;
 }
 
 void SOCK_UdpFree(S_Udp *udp)
@@ -61,7 +61,7 @@ int SOCK_UdpSetPeer(S_Udp *udp, const char *peer, unsigned short port)
     return -1;
 }
 
-int SOCK_UdpBind(S_Udp *udp, unsigned short port)
+int SOCK_UdpBind(S_Udp *udp, const char *addr, unsigned short port)
 {
 #if 0
     int ret;
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+/* Static tracepoints
+
+   On Linux with <sys/sdt.h> (systemtap-sdt-dev) these are USDT probes of
+   the provider "gcfflasher". An unused probe is a single nop instruction,
+   so they stay in release builds and can be attached to with bpftrace or
+   perf at any time. On other platforms the probes compile to nothing.
+
+   Probe arguments:
+
+     state_enter  name
+     state_exit   name, milliseconds spent in the state
+     event        state name, Event
+     timeout      state name
+     retry        state name, retry count of the run
+     frame_tx     data, length (unescaped frame without CRC)
+     frame_rx     data, length (unescaped frame without CRC)
+
+   State names are the names of the state functions, e.g. "ST_V3ProgramUpload".
+*/
+
+#if defined(PL_LINUX) && defined(HAS_SYS_SDT)
+
+#include <sys/sdt.h>
+
+/* the parameter names must differ from the probe names */
+#define PROBE_STATE_ENTER(st)       STAP_PROBE1(gcfflasher, state_enter, st)
+#define PROBE_STATE_EXIT(st, ms)    STAP_PROBE2(gcfflasher, state_exit, st, ms)
+#define PROBE_EVENT(st, ev)         STAP_PROBE2(gcfflasher, event, st, ev)
+#define PROBE_TIMEOUT(st)           STAP_PROBE1(gcfflasher, timeout, st)
+#define PROBE_RETRY(st, n)          STAP_PROBE2(gcfflasher, retry, st, n)
+#define PROBE_FRAME_TX(data, len)   STAP_PROBE2(gcfflasher, frame_tx, data, len)
+#define PROBE_FRAME_RX(data, len)   STAP_PROBE2(gcfflasher, frame_rx, data, len)
+
+#else
+
+#define PROBE_STATE_ENTER(st)       (void)(st)
+#define PROBE_STATE_EXIT(st, ms)    ((void)(st), (void)(ms))
+#define PROBE_EVENT(st, ev)         ((void)(st), (void)(ev))
+#define PROBE_TIMEOUT(st)           (void)(st)
+#define PROBE_RETRY(st, n)          ((void)(st), (void)(n))
+#define PROBE_FRAME_TX(data, len)   ((void)(data), (void)(len))
+#define PROBE_FRAME_RX(data, len)   ((void)(data), (void)(len))
+
+#endif /* PL_LINUX && HAS_SYS_SDT */
+
+#endif /* PROBE_H */
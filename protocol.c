@@ -9,6 +9,7 @@
  */
 
 #include "protocol.h"
+#include "probe.h"
 
 #define FR_END       (unsigned char)0xC0
 #define FR_ESC       (unsigned char)0xDB
@@ -40,6 +41,8 @@ void PROT_SendFlagged(const unsigned char *data, unsigned len)
     unsigned char c = 0;
     unsigned short crc = 0;
 
+    PROBE_FRAME_TX(data, len);
+
     /* put an end before the packet */
     PROT_Putc(FR_END);
 
@@ -59,7 +62,58 @@ void PROT_SendFlagged(const unsigned char *data, unsigned len)
     PROT_Flush();
 }
 
+static unsigned protEscape(unsigned char c, unsigned char *buf)
+{
+    if      (c == FR_ESC) { buf[0] = FR_ESC; buf[1] = T_FR_ESC; return 2; }
+    else if (c == FR_END) { buf[0] = FR_ESC; buf[1] = T_FR_END; return 2; }
+
+    buf[0] = c;
+    return 1;
+}
+
+unsigned PROT_EncodeFlagged(const unsigned char *data, unsigned len, unsigned char *buf, unsigned size)
+{
+    unsigned i;
+    unsigned pos;
+    unsigned short crc;
+
+    /* worst case every byte and the CRC are escaped */
+    if (size < 2 + (len + 2) * 2)
+        return 0;
+
+    pos = 0;
+    crc = 0;
+    buf[pos++] = FR_END;
+
+    for (i = 0; i < len; i++)
+    {
+        crc += data[i];
+        pos += protEscape(data[i], &buf[pos]);
+    }
+
+    crc = (~crc + 1);
+    pos += protEscape(crc & 0xFF, &buf[pos]);
+    pos += protEscape((crc >> 8) & 0xFF, &buf[pos]);
+
+    buf[pos++] = FR_END;
+
+    return pos;
+}
+
+static void protPacket(void *user, const unsigned char *data, unsigned len)
+{
+    (void)user;
+    PROBE_FRAME_RX(data, len);
+    PROT_Packet(data, len);
+}
+
 int PROT_ReceiveFlagged(PROT_RxState *rx, const unsigned char *data, unsigned len)
+{
+    return PROT_DecodeFlagged(rx, data, len, protPacket, 0);
+}
+
+int PROT_DecodeFlagged(PROT_RxState *rx, const unsigned char *data, unsigned len,
+                       PROT_PacketHandler handler, void *user)
 {
     int err;
     unsigned i;
@@ -95,7 +149,7 @@ nextTurn:
 
                     if (crc1 == crc)
                     {
-                        PROT_Packet(&rx->buf[0], rx->bufpos - 2);
+                        handler(user, &rx->buf[0], rx->bufpos - 2);
                     }
                     else
                     {
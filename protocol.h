@@ -11,6 +11,33 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+/* Bootloader V3.x serial protocol */
+#define BTL_MAGIC              0x81
+#define BTL_ID_REQUEST         0x02
+#define BTL_ID_RESPONSE        0x82
+#define BTL_FW_UPDATE_REQUEST  0x03
+#define BTL_FW_UPDATE_RESPONSE 0x83
+#define BTL_FW_DATA_REQUEST    0x04
+#define BTL_FW_DATA_RESPONSE   0x84
+
+/* Serial commands */
+#define CMD_STATUS             0x07
+#define CMD_FIRMWARE_VERSION   0x0D
+#define CMD_READ_REGISTER      0x18
+#define CMD_WRITE_PARAMETER    0x0B
+
+/* Serial command status codes */
+#define CMD_STATUS_SUCCESS      0x00
+#define CMD_STATUS_FAILURE      0x01
+#define CMD_STATUS_BUSY         0x02
+#define CMD_STATUS_TIMEOUT      0x03
+#define CMD_STATUS_UNSUPPORTED  0x04
+#define CMD_STATUS_ERROR        0x05
+#define CMD_STATUS_ENONET       0x06
+#define CMD_STATUS_EINVAL       0x07
+#define CMD_STATUS_ELEN         0x08
+#define CMD_STATUS_EOFFSET      0x09
+
 typedef struct {
     unsigned bufpos;
     unsigned char escaped;
@@ -23,6 +50,18 @@ void PROT_SendFlagged(const unsigned char *data, unsigned len);
 int PROT_ReceiveFlagged(PROT_RxState *rx, const unsigned char *data, unsigned len);
 void PROT_Packet(const unsigned char *data, unsigned len);
 
+typedef void (*PROT_PacketHandler)(void *user, const unsigned char *data, unsigned len);
+
+/* Variants for additional serial ports which don't go through the
+   platform layer, e.g. inventory. */
+
+/* Like PROT_ReceiveFlagged() but calls \p handler instead of PROT_Packet(). */
+int PROT_DecodeFlagged(PROT_RxState *rx, const unsigned char *data, unsigned len,
+                       PROT_PacketHandler handler, void *user);
+/* Writes the flagged frame of \p data into \p buf.
+   Returns the frame length or 0 if \p size is too small. */
+unsigned PROT_EncodeFlagged(const unsigned char *data, unsigned len, unsigned char *buf, unsigned size);
+
 /*! Platform specific declarations.
     Following functions need to be implemented in the platform layer.
  */
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "u_bstream.h"
+#include "u_mem.h"
+#include "u_strlen.h"
+#include "replay.h"
+
+static void replayFlush(REPLAY_Recorder *rec)
+{
+    if (rec->pos)
+    {
+        PL_FileWrite(rec->file, &rec->buf[0], rec->pos);
+        rec->pos = 0;
+    }
+
+    rec->flushTime = PL_Time();
+}
+
+static void replayClose(REPLAY_Recorder *rec)
+{
+    replayFlush(rec);
+    PL_FileClose(rec->file);
+    rec->file = 0;
+}
+
+int REPLAY_RecordInit(REPLAY_Recorder *rec, const char *path)
+{
+    U_BStream bs;
+
+    if (rec->file)
+        return 1;
+
+    rec->file = PL_FileOpen(path, PL_FILE_WRITE);
+    if (!rec->file)
+        return 0;
+
+    rec->start = PL_Time();
+    rec->flushTime = rec->start;
+
+    U_bstream_init(&bs, &rec->buf[0], sizeof(rec->buf));
+    U_bstream_put_u32_le(&bs, REPLAY_MAGIC);
+    U_bstream_put_u32_le(&bs, REPLAY_VERSION);
+    rec->pos = bs.pos;
+    rec->size = bs.pos;
+
+    return 1;
+}
+
+void REPLAY_RecordData(REPLAY_Recorder *rec, unsigned type, const unsigned char *data, unsigned length)
+{
+    unsigned n;
+    unsigned long time;
+    U_BStream bs;
+
+    if (!rec->file)
+        return;
+
+    time = (unsigned long)(PL_Time() - rec->start);
+
+    do /* larger than the buffer is split in several records */
+    {
+        n = length < sizeof(rec->buf) - REPLAY_HDR_SIZE ? length : sizeof(rec->buf) - REPLAY_HDR_SIZE;
+
+        if (rec->size + REPLAY_HDR_SIZE + n >= REPLAY_MAX_SIZE)
+        {
+            /* a replay reads at most REPLAY_MAX_SIZE - 1 bytes */
+            replayClose(rec);
+            PL_Printf(DBG_INFO, "recording stopped at the %lu MB limit\n", REPLAY_MAX_SIZE >> 20);
+            return;
+        }
+
+        if (sizeof(rec->buf) - rec->pos < REPLAY_HDR_SIZE + n)
+            replayFlush(rec);
+
+        U_bstream_init(&bs, &rec->buf[rec->pos], sizeof(rec->buf) - rec->pos);
+        U_bstream_put_u8(&bs, type & 0xFF);
+        U_bstream_put_u32_le(&bs, time);
+        U_bstream_put_u16_le(&bs, n & 0xFFFF);
+        U_memcpy(&rec->buf[rec->pos + bs.pos], data, n);
+        rec->pos += bs.pos + n;
+        rec->size += bs.pos + n;
+
+        data += n;
+        length -= n;
+    } while (length);
+}
+
+void REPLAY_RecordEvent(REPLAY_Recorder *rec, Event event)
+{
+    unsigned char data[2];
+
+    data[0] = (unsigned)event & 0xFF;
+    data[1] = ((unsigned)event >> 8) & 0xFF;
+    REPLAY_RecordData(rec, REPLAY_REC_EVENT, &data[0], sizeof(data));
+}
+
+void REPLAY_RecordDeviceAdded(REPLAY_Recorder *rec, const char *path)
+{
+    unsigned len;
+    unsigned char data[2 + MAX_DEV_PATH_LENGTH];
+
+    len = U_strlen(path);
+    if (len > MAX_DEV_PATH_LENGTH)
+        len = MAX_DEV_PATH_LENGTH;
+
+    data[0] = (unsigned)EV_DEVICE_ADDED & 0xFF;
+    data[1] = ((unsigned)EV_DEVICE_ADDED >> 8) & 0xFF;
+    U_memcpy(&data[2], path, len);
+    REPLAY_RecordData(rec, REPLAY_REC_EVENT, &data[0], 2 + len);
+}
+
+void REPLAY_RecordStep(REPLAY_Recorder *rec, PL_time_t now)
+{
+    if (rec->pos && now - rec->flushTime >= REPLAY_FLUSH_INTERVAL)
+        replayFlush(rec);
+}
+
+void REPLAY_RecordExit(REPLAY_Recorder *rec)
+{
+    if (rec->file)
+        replayClose(rec);
+}
+
+int REPLAY_ReadInit(REPLAY_Reader *rd, const unsigned char *data, unsigned long size)
+{
+    U_BStream bs;
+
+    if (size < 8)
+        return 0;
+
+    U_bstream_init(&bs, (void*)data, size);
+
+    if (U_bstream_get_u32_le(&bs) != REPLAY_MAGIC || U_bstream_get_u32_le(&bs) != REPLAY_VERSION)
+        return 0;
+
+    rd->data = data;
+    rd->size = size;
+    rd->pos = bs.pos;
+
+    return 1;
+}
+
+int REPLAY_ReadNext(REPLAY_Reader *rd, REPLAY_Record *rec)
+{
+    U_BStream bs;
+
+    if (rd->size - rd->pos < REPLAY_HDR_SIZE)
+        return 0;
+
+    U_bstream_init(&bs, (void*)&rd->data[rd->pos], rd->size - rd->pos);
+    rec->type = U_bstream_get_u8(&bs);
+    rec->time = U_bstream_get_u32_le(&bs);
+    rec->length = U_bstream_get_u16_le(&bs);
+
+    if (rd->size - rd->pos - REPLAY_HDR_SIZE < rec->length) /* truncated */
+        return 0;
+
+    rec->data = &rd->data[rd->pos + REPLAY_HDR_SIZE];
+    rd->pos += REPLAY_HDR_SIZE + rec->length;
+
+    return 1;
+}
+
+Event REPLAY_RecordEventValue(const REPLAY_Record *rec)
+{
+    if (rec->type != REPLAY_REC_EVENT || rec->length < 2)
+        return EV_ACTION;
+
+    return (Event)(rec->data[0] | (unsigned)rec->data[1] << 8);
+}
+
+void REPLAY_RecordEventPath(const REPLAY_Record *rec, char *buf, unsigned size)
+{
+    unsigned len;
+
+    len = rec->length > 2 ? rec->length - 2 : 0;
+    if (len > size - 1)
+        len = size - 1;
+
+    U_memcpy(buf, &rec->data[2], len);
+    buf[len] = '\0';
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "gcf.h"
+
+/* Session recording
+
+   Records the input of the state machine, the bytes received from the
+   device and the platform events like timeouts, as well as the bytes
+   written to the device. A platform which supports PL_StartReplay()
+   feeds a recording back into GCF_Received() and GCF_HandleEvent() and
+   compares the written bytes with the recorded ones.
+
+   File layout (little-endian):
+
+     U32 magic, U32 version
+     records:
+       U8  type (REPLAY_REC_*)
+       U32 time in milliseconds since the start of the recording
+       U16 length
+       U8  data[length], for REPLAY_REC_EVENT the U16 event, followed
+                         by the device path for EV_DEVICE_ADDED
+*/
+#define REPLAY_MAGIC   0x52464347 /* "GCFR" */
+#define REPLAY_VERSION 1
+
+#define REPLAY_REC_RX    1
+#define REPLAY_REC_TX    2
+#define REPLAY_REC_EVENT 3
+
+#define REPLAY_HDR_SIZE       7
+#define REPLAY_BUFFER_SIZE    8192
+#define REPLAY_FLUSH_INTERVAL 1000 /* ms, keeps the tail of interrupted runs */
+#define REPLAY_MAX_SIZE       (1UL << 23) /* 8 MB, recording stops before */
+
+typedef struct REPLAY_Record
+{
+    unsigned type;
+    unsigned long time;
+    unsigned length;
+    const unsigned char *data;
+} REPLAY_Record;
+
+typedef struct REPLAY_Recorder
+{
+    PL_File file;
+    PL_time_t start;
+    PL_time_t flushTime;
+    unsigned long size; /* file size incl. buffered bytes */
+    unsigned long pos;
+    unsigned char buf[REPLAY_BUFFER_SIZE];
+} REPLAY_Recorder;
+
+typedef struct REPLAY_Reader
+{
+    const unsigned char *data;
+    unsigned long size;
+    unsigned long pos;
+} REPLAY_Reader;
+
+/*! Creates the recording \p path, the time starts now. */
+int REPLAY_RecordInit(REPLAY_Recorder *rec, const char *path);
+void REPLAY_RecordData(REPLAY_Recorder *rec, unsigned type, const unsigned char *data, unsigned length);
+void REPLAY_RecordEvent(REPLAY_Recorder *rec, Event event);
+void REPLAY_RecordDeviceAdded(REPLAY_Recorder *rec, const char *path);
+/*! Writes buffered records which are older than REPLAY_FLUSH_INTERVAL. */
+void REPLAY_RecordStep(REPLAY_Recorder *rec, PL_time_t now);
+void REPLAY_RecordExit(REPLAY_Recorder *rec);
+
+/*! Starts reading the recording loaded in \p data.
+
+    \returns 1 on success, 0 if \p data has no valid header.
+ */
+int REPLAY_ReadInit(REPLAY_Reader *rd, const unsigned char *data, unsigned long size);
+/*! \returns 1 and the next record in \p rec, 0 at the end of the recording. */
+int REPLAY_ReadNext(REPLAY_Reader *rd, REPLAY_Record *rec);
+/*! \returns the event of a REPLAY_REC_EVENT record. */
+Event REPLAY_RecordEventValue(const REPLAY_Record *rec);
+/*! Copies the device path of an EV_DEVICE_ADDED record into \p buf,
+    empty if there is none. */
+void REPLAY_RecordEventPath(const REPLAY_Record *rec, char *buf, unsigned size);
+
+#endif /* REPLAY_H */
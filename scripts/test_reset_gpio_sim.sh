@@ -0,0 +1,85 @@
+#!/usr/bin/env bash
+#
+# Checks the RaspBee GPIO reset against a simulated GPIO chip.
+#
+# Creates a chip with the gpio-sim kernel module, runs
+# GCFFlasher -r --reset-gpio <chip>:<line> and verifies that the line
+# goes low and back high. Needs root, configfs and the gpio-sim module.
+#
+# Usage: scripts/test_reset_gpio_sim.sh [path/to/GCFFlasher]
+
+set -euo pipefail
+
+GCFFLASHER="${1:-build/GCFFlasher}"
+LINE=17
+CONFIGFS=/sys/kernel/config/gpio-sim
+SIM="$CONFIGFS/gcfflasher-test"
+POLL_LOG="$(mktemp)"
+
+cleanup() {
+	if [ -d "$SIM" ]; then
+		echo 0 > "$SIM/live" 2>/dev/null || true
+		rmdir "$SIM/bank0" "$SIM" 2>/dev/null || true
+	fi
+	rm -f "$POLL_LOG"
+}
+trap cleanup EXIT
+
+if [ ! -x "$GCFFLASHER" ]; then
+	echo "GCFFlasher not found: $GCFFLASHER" >&2
+	exit 1
+fi
+
+modprobe gpio-sim 2>/dev/null || true
+
+if [ ! -d "$CONFIGFS" ]; then
+	echo "gpio-sim not available, is configfs mounted?" >&2
+	exit 1
+fi
+
+mkdir "$SIM"
+mkdir "$SIM/bank0"
+echo 32 > "$SIM/bank0/num_lines"
+echo 1 > "$SIM/live"
+
+CHIP="$(cat "$SIM/bank0/chip_name")"
+SIM_LINE="/sys/devices/platform/$(cat "$SIM/dev_name")/$CHIP/sim_gpio$LINE"
+
+# the pin is released as input after the reset, pull-up makes the idle level high
+echo pull-up > "$SIM_LINE/pull"
+
+# records each level change until the reset is done
+(
+	last=
+	while :; do
+		v="$(cat "$SIM_LINE/value")"
+		if [ "$v" != "$last" ]; then
+			echo "$v" >> "$POLL_LOG"
+			last="$v"
+		fi
+		sleep 0.01
+	done
+) &
+POLL_PID=$!
+
+# the tty doesn't exist, the reset has to go through the GPIO line
+rc=0
+"$GCFFLASHER" -r -d /dev/ttyAMA-gpio-sim --reset-gpio "/dev/$CHIP:$LINE" </dev/null || rc=$?
+
+sleep 0.1
+kill "$POLL_PID"
+wait "$POLL_PID" 2>/dev/null || true
+
+levels="$(tr -d '\n' < "$POLL_LOG")"
+
+if [ "$rc" -ne 0 ]; then
+	echo "FAIL: GCFFlasher exited with $rc" >&2
+	exit 1
+fi
+
+if [ "$levels" != "101" ]; then
+	echo "FAIL: expected line levels 101 (high, low, high), got $levels" >&2
+	exit 1
+fi
+
+echo "OK: /dev/$CHIP:$LINE went low and back high"
@@ -0,0 +1,700 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "u_sstream.h"
+#include "u_bstream.h"
+#include "u_mem.h"
+#include "sniff.h"
+
+/* Ring record layout (little-endian)
+
+   U16 record length (0 marks wrap around to start)
+   U64 timestamp
+   U8  channel
+   U8  frame[]
+*/
+#define RING_HDR_SIZE 11
+
+#define PCAP_MAGIC 0xA1B2C3D4
+#define PCAP_LINKTYPE_IEEE802_15_4_WITHFCS 195
+
+int SNIFF_RingInit(SNIFF_Ring *ring, const char *prefix, unsigned long seconds, unsigned long size)
+{
+    if (ring->buf)
+        return 1; /* keep content across sniffer restarts */
+
+    if (size < 4096 || size > SNIFF_RING_MAX_SIZE)
+        return 0;
+
+    /* allocated on first use, most runs don't need the ring */
+    ring->buf = PL_MemoryAlloc(size);
+    if (!ring->buf)
+        return 0;
+
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->count = 0;
+    ring->window = (PL_time_t)seconds * 1000;
+    ring->postEnd = 0;
+    ring->file = 0;
+    ring->prefix = prefix;
+
+    return 1;
+}
+
+static unsigned long ringRecordLength(const SNIFF_Ring *ring, unsigned long pos)
+{
+    return ring->buf[pos] | (unsigned long)ring->buf[pos + 1] << 8;
+}
+
+/* Returns the position of the oldest record, following wrap markers. */
+static unsigned long ringHead(SNIFF_Ring *ring)
+{
+    if (ring->size - ring->head < RING_HDR_SIZE || ringRecordLength(ring, ring->head) == 0)
+        ring->head = 0;
+
+    return ring->head;
+}
+
+static PL_time_t ringTimestamp(const SNIFF_Ring *ring, unsigned long pos)
+{
+    int i;
+    PL_time_t ts;
+
+    ts = 0;
+    for (i = 7; i >= 0; i--)
+    {
+        ts <<= 8;
+        ts |= ring->buf[pos + 2 + (unsigned)i];
+    }
+
+    return ts;
+}
+
+static void ringPop(SNIFF_Ring *ring)
+{
+    unsigned long pos;
+
+    Assert(ring->count > 0);
+    pos = ringHead(ring);
+    ring->head = pos + ringRecordLength(ring, pos);
+    ring->count--;
+
+    if (ring->count == 0)
+    {
+        ring->head = 0;
+        ring->tail = 0;
+    }
+}
+
+static void ringPcapRecord(U_BStream *bs, PL_time_t timestamp, const unsigned char *data, unsigned length)
+{
+    unsigned i;
+
+    U_bstream_put_u32_le(bs, (unsigned long)(timestamp / 1000));
+    U_bstream_put_u32_le(bs, (unsigned long)(timestamp % 1000) * 1000);
+    U_bstream_put_u32_le(bs, length);
+    U_bstream_put_u32_le(bs, length);
+
+    for (i = 0; i < length; i++)
+        U_bstream_put_u8(bs, data[i]);
+}
+
+void SNIFF_RingPush(SNIFF_Ring *ring, const SNIFF_Frame *frame)
+{
+    unsigned i;
+    unsigned long need;
+    unsigned long pos;
+    PL_time_t ts;
+    U_BStream bs;
+    unsigned char buf[16 + 256];
+
+    if (!ring->buf || frame->length > 255)
+        return;
+
+    /* drop records which are too old */
+    for (;ring->count && ringTimestamp(ring, ringHead(ring)) + ring->window < frame->timestamp;)
+        ringPop(ring);
+
+    need = RING_HDR_SIZE + frame->length;
+
+    for (;;)
+    {
+        if (ring->count)
+            ringHead(ring);
+
+        if (ring->count == 0 || ring->tail > ring->head)
+        {
+            if (ring->size - ring->tail >= need)
+                break;
+
+            if (ring->head >= need) /* wrap around */
+            {
+                if (ring->size - ring->tail >= 2)
+                {
+                    ring->buf[ring->tail] = 0;
+                    ring->buf[ring->tail + 1] = 0;
+                }
+                ring->tail = 0;
+                break;
+            }
+        }
+        else if (ring->head - ring->tail >= need)
+        {
+            break;
+        }
+
+        ringPop(ring);
+    }
+
+    pos = ring->tail;
+    ring->buf[pos++] = need & 0xFF;
+    ring->buf[pos++] = (need >> 8) & 0xFF;
+    ts = frame->timestamp;
+    for (i = 0; i < 8; i++, ts >>= 8)
+        ring->buf[pos++] = ts & 0xFF;
+    ring->buf[pos++] = frame->channel & 0xFF;
+    U_memcpy(&ring->buf[pos], frame->data, frame->length);
+
+    ring->tail += need;
+    ring->count++;
+
+    if (ring->file)
+    {
+        U_bstream_init(&bs, &buf[0], sizeof(buf));
+        ringPcapRecord(&bs, frame->timestamp, frame->data, frame->length);
+        PL_FileWrite(ring->file, bs.data, bs.pos);
+    }
+
+    if (ring->patternLength && ring->patternLength <= frame->length)
+    {
+        for (pos = 0; pos <= frame->length - ring->patternLength; pos++)
+        {
+            for (i = 0; i < ring->patternLength; i++)
+            {
+                if (frame->data[pos + i] != ring->pattern[i])
+                    break;
+            }
+
+            if (i == ring->patternLength)
+            {
+                SNIFF_RingTrigger(ring, "pattern");
+                break;
+            }
+        }
+    }
+}
+
+void SNIFF_RingTrigger(SNIFF_Ring *ring, const char *reason)
+{
+    unsigned long n;
+    unsigned long pos;
+    unsigned long len;
+    PL_time_t now;
+    U_SStream ss;
+    U_BStream bs;
+    char path[MAX_DEV_PATH_LENGTH];
+    unsigned char buf[4096];
+
+    if (!ring->buf)
+        return;
+
+    now = PL_WallTime();
+
+    if (ring->file)
+    {
+        /* already capturing, extend post trigger period */
+        ring->postEnd = PL_Time() + SNIFF_RING_POST_TRIGGER;
+        return;
+    }
+
+    U_sstream_init(&ss, &path[0], sizeof(path));
+    U_sstream_put_str(&ss, ring->prefix);
+    U_sstream_put_str(&ss, "-");
+    U_sstream_put_ulonglong(&ss, now);
+    U_sstream_put_str(&ss, ".pcap");
+
+    if (ss.status != U_SSTREAM_OK)
+        return;
+
+    ring->file = PL_FileOpen(ss.str, PL_FILE_WRITE);
+    if (!ring->file)
+    {
+        PL_Printf(DBG_INFO, "failed to open capture file %s\n", ss.str);
+        return;
+    }
+
+    U_bstream_init(&bs, &buf[0], sizeof(buf));
+    U_bstream_put_u32_le(&bs, PCAP_MAGIC);
+    U_bstream_put_u16_le(&bs, 2); /* version major */
+    U_bstream_put_u16_le(&bs, 4); /* version minor */
+    U_bstream_put_u32_le(&bs, 0); /* this zone */
+    U_bstream_put_u32_le(&bs, 0); /* sigfigs */
+    U_bstream_put_u32_le(&bs, 65535); /* snaplen */
+    U_bstream_put_u32_le(&bs, PCAP_LINKTYPE_IEEE802_15_4_WITHFCS);
+
+    n = ring->count;
+    for (;ring->count;)
+    {
+        pos = ringHead(ring);
+        len = ringRecordLength(ring, pos) - RING_HDR_SIZE;
+
+        if (bs.size - bs.pos < 16 + len)
+        {
+            PL_FileWrite(ring->file, bs.data, bs.pos);
+            bs.pos = 0;
+        }
+
+        ringPcapRecord(&bs, ringTimestamp(ring, pos), &ring->buf[pos + RING_HDR_SIZE], (unsigned)len);
+        ringPop(ring);
+    }
+
+    PL_FileWrite(ring->file, bs.data, bs.pos);
+    ring->postEnd = PL_Time() + SNIFF_RING_POST_TRIGGER;
+
+    PL_Printf(DBG_INFO, "capture triggered (%s), %lu frames written to %s\n", reason, n, ss.str);
+}
+
+void SNIFF_RingStep(SNIFF_Ring *ring, PL_time_t now)
+{
+    if (ring->file && ring->postEnd < now)
+    {
+        PL_FileClose(ring->file);
+        ring->file = 0;
+    }
+}
+
+void SNIFF_RingExit(SNIFF_Ring *ring)
+{
+    if (ring->file)
+    {
+        PL_FileClose(ring->file);
+        ring->file = 0;
+    }
+}
+
+/* IEEE 802.15.4 frame control field */
+#define MAC_FC_FRAME_TYPE(fc)    ((fc) & 0x7)
+#define MAC_FC_SECURITY          0x0008
+#define MAC_FC_PANID_COMPRESSION 0x0040
+#define MAC_FC_DST_MODE(fc)      (((fc) >> 10) & 0x3)
+#define MAC_FC_VERSION(fc)       (((fc) >> 12) & 0x3)
+#define MAC_FC_SRC_MODE(fc)      (((fc) >> 14) & 0x3)
+
+#define MAC_FRAME_TYPE_DATA 1
+#define MAC_ADDR_MODE_EXT   3
+#define MAC_VERSION_2015    2
+#define MAC_FCS_SIZE        2
+
+#define PAN_DST 1
+#define PAN_SRC 2
+
+/* Zigbee NWK frame control field */
+#define NWK_FC_FRAME_TYPE(fc) ((fc) & 0x3)
+#define NWK_FC_VERSION(fc)    (((fc) >> 2) & 0xF)
+#define NWK_FC_MULTICAST      0x0100
+#define NWK_FC_SECURITY       0x0200
+#define NWK_FC_SOURCE_ROUTE   0x0400
+#define NWK_FC_DST_IEEE       0x0800
+#define NWK_FC_SRC_IEEE       0x1000
+
+#define NWK_HDR_MIN_SIZE 8
+
+static const char *macFrameTypes[8] =
+{
+    "beacon", "data", "ack", "cmd", "reserved", "multipurpose", "frag", "extended"
+};
+
+/* address length by addressing mode */
+static const unsigned char macAddrLength[4] = { 0, 0, 2, 8 };
+
+/* PAN ID presence, index: (dst mode != 0) << 2 | (src mode != 0) << 1 | PAN ID compression
+   For 2015 frames with extended destination and source address the
+   compressed case carries no PAN ID (handled separately).
+*/
+static const unsigned char macPanLegacy[8] =
+{
+    0, 0, PAN_SRC, 0, PAN_DST, PAN_DST, PAN_DST | PAN_SRC, PAN_DST
+};
+
+static const unsigned char macPan2015[8] =
+{
+    0, PAN_DST, PAN_SRC, 0, PAN_DST, 0, PAN_DST | PAN_SRC, PAN_DST
+};
+
+static const char *nwkFrameTypes[4] = { "data", "cmd", "reserved", "interpan" };
+
+typedef struct
+{
+    unsigned fc;
+    unsigned seq;
+    unsigned length; /* header length */
+    const unsigned char *dstPan;
+    const unsigned char *dst;
+    const unsigned char *srcPan;
+    const unsigned char *src;
+    unsigned dstLength;
+    unsigned srcLength;
+} MacHeader;
+
+typedef struct
+{
+    unsigned fc;
+    unsigned radius;
+    unsigned seq;
+    unsigned length; /* header length */
+    const unsigned char *dst;
+    const unsigned char *src;
+    const unsigned char *dst64;
+    const unsigned char *src64;
+} NwkHeader;
+
+/* \\returns 1 if the MAC header fits in \\p length, 0 otherwise. */
+static int sniffDecodeMac(const unsigned char *data, unsigned length, MacHeader *mac)
+{
+    unsigned pos;
+    unsigned dstMode;
+    unsigned srcMode;
+    unsigned pan;
+
+    U_bzero(mac, sizeof(*mac));
+
+    if (length < 3 + MAC_FCS_SIZE)
+        return 0;
+
+    mac->fc = data[0] | (unsigned)data[1] << 8;
+    mac->seq = data[2];
+    pos = 3;
+
+    dstMode = MAC_FC_DST_MODE(mac->fc);
+    srcMode = MAC_FC_SRC_MODE(mac->fc);
+
+    pan = (dstMode ? 4 : 0) | (srcMode ? 2 : 0) | (mac->fc & MAC_FC_PANID_COMPRESSION ? 1 : 0);
+
+    if (MAC_FC_VERSION(mac->fc) == MAC_VERSION_2015)
+    {
+        pan = macPan2015[pan];
+        if (dstMode == MAC_ADDR_MODE_EXT && srcMode == MAC_ADDR_MODE_EXT)
+            pan = (mac->fc & MAC_FC_PANID_COMPRESSION) ? 0 : PAN_DST;
+    }
+    else
+    {
+        pan = macPanLegacy[pan];
+    }
+
+    mac->dstLength = macAddrLength[dstMode];
+    mac->srcLength = macAddrLength[srcMode];
+
+    if (length < pos + (pan & PAN_DST ? 2 : 0) + (pan & PAN_SRC ? 2 : 0) +
+                 mac->dstLength + mac->srcLength + MAC_FCS_SIZE)
+        return 0;
+
+    if (pan & PAN_DST)
+    {
+        mac->dstPan = &data[pos];
+        pos += 2;
+    }
+
+    if (mac->dstLength)
+    {
+        mac->dst = &data[pos];
+        pos += mac->dstLength;
+    }
+
+    if (pan & PAN_SRC)
+    {
+        mac->srcPan = &data[pos];
+        pos += 2;
+    }
+
+    if (mac->srcLength)
+    {
+        mac->src = &data[pos];
+        pos += mac->srcLength;
+    }
+
+    mac->length = pos;
+
+    return 1;
+}
+
+/* \\returns 1 if \\p data holds a Zigbee NWK header, 0 otherwise. */
+static int sniffDecodeNwk(const unsigned char *data, unsigned length, NwkHeader *nwk)
+{
+    unsigned pos;
+    unsigned version;
+
+    U_bzero(nwk, sizeof(*nwk));
+
+    if (length < NWK_HDR_MIN_SIZE)
+        return 0;
+
+    nwk->fc = data[0] | (unsigned)data[1] << 8;
+    version = NWK_FC_VERSION(nwk->fc);
+
+    if (version < 2 || version > 3 || NWK_FC_FRAME_TYPE(nwk->fc) > 1)
+        return 0;
+
+    nwk->dst = &data[2];
+    nwk->src = &data[4];
+    nwk->radius = data[6];
+    nwk->seq = data[7];
+    pos = NWK_HDR_MIN_SIZE;
+
+    if (nwk->fc & NWK_FC_DST_IEEE)
+    {
+        nwk->dst64 = &data[pos];
+        pos += 8;
+    }
+
+    if (nwk->fc & NWK_FC_SRC_IEEE)
+    {
+        nwk->src64 = &data[pos];
+        pos += 8;
+    }
+
+    if (nwk->fc & NWK_FC_MULTICAST)
+        pos += 1;
+
+    if ((nwk->fc & NWK_FC_SOURCE_ROUTE) && pos < length)
+        pos += 2 + 2 * (unsigned)data[pos]; /* relay count, relay index, relay list */
+
+    if (length < pos)
+        return 0;
+
+    nwk->length = pos;
+
+    return 1;
+}
+
+/* Puts a little-endian address as big-endian hex string. */
+static void jsonPutAddr(U_SStream *ss, const char *key, const unsigned char *addr, unsigned length)
+{
+    U_sstream_put_str(ss, key);
+    U_sstream_put_str(ss, "\"");
+    for (; length; length--)
+        U_sstream_put_hex(ss, &addr[length - 1], 1);
+    U_sstream_put_str(ss, "\"");
+}
+
+static void jsonPutNum(U_SStream *ss, const char *key, unsigned long long num)
+{
+    U_sstream_put_str(ss, key);
+    U_sstream_put_ulonglong(ss, num);
+}
+
+static void jsonFlush(SNIFF_Json *json)
+{
+    if (json->pos)
+    {
+        PL_FileWrite(json->file, json->buf, json->pos);
+        json->pos = 0;
+    }
+}
+
+int SNIFF_JsonInit(SNIFF_Json *json, const char *path)
+{
+    if (json->file)
+        return 1; /* keep open across sniffer restarts */
+
+    json->pos = 0;
+    json->file = PL_FileOpen(path, PL_FILE_APPEND);
+
+    return json->file ? 1 : 0;
+}
+
+void SNIFF_JsonPush(SNIFF_Json *json, const SNIFF_Frame *frame)
+{
+    U_SStream ss;
+    MacHeader mac;
+    NwkHeader nwk;
+    unsigned payloadLength;
+    const unsigned char *payload;
+
+    if (!json->file)
+        return;
+
+    /* worst case line: 255 bytes payload as hex plus header fields */
+    if (sizeof(json->buf) - json->pos < 1024)
+        jsonFlush(json);
+
+    if (json->pos == 0)
+        json->flushTime = PL_Time() + SNIFF_JSON_FLUSH_INTERVAL;
+
+    U_sstream_init(&ss, &json->buf[json->pos], (unsigned)(sizeof(json->buf) - json->pos));
+
+    jsonPutNum(&ss, "{\"ts\":", frame->timestamp);
+    jsonPutNum(&ss, ",\"ch\":", frame->channel);
+    jsonPutNum(&ss, ",\"len\":", frame->length);
+
+    payload = frame->data;
+    payloadLength = frame->length;
+
+    if (sniffDecodeMac(frame->data, frame->length, &mac))
+    {
+        U_sstream_put_str(&ss, ",\"type\":\"");
+        U_sstream_put_str(&ss, macFrameTypes[MAC_FC_FRAME_TYPE(mac.fc)]);
+        U_sstream_put_str(&ss, "\"");
+        jsonPutAddr(&ss, ",\"fc\":", frame->data, 2);
+        jsonPutNum(&ss, ",\"seq\":", mac.seq);
+
+        if (mac.dstPan) jsonPutAddr(&ss, ",\"dst_pan\":", mac.dstPan, 2);
+        if (mac.dst)    jsonPutAddr(&ss, ",\"dst\":", mac.dst, mac.dstLength);
+        if (mac.srcPan) jsonPutAddr(&ss, ",\"src_pan\":", mac.srcPan, 2);
+        if (mac.src)    jsonPutAddr(&ss, ",\"src\":", mac.src, mac.srcLength);
+
+        if (mac.fc & MAC_FC_SECURITY)
+            U_sstream_put_str(&ss, ",\"sec\":true");
+
+        payload = &frame->data[mac.length];
+        payloadLength = frame->length - mac.length - MAC_FCS_SIZE;
+
+        if (MAC_FC_FRAME_TYPE(mac.fc) == MAC_FRAME_TYPE_DATA &&
+            (mac.fc & MAC_FC_SECURITY) == 0 &&
+            sniffDecodeNwk(payload, payloadLength, &nwk))
+        {
+            U_sstream_put_str(&ss, ",\"nwk\":{\"type\":\"");
+            U_sstream_put_str(&ss, nwkFrameTypes[NWK_FC_FRAME_TYPE(nwk.fc)]);
+            U_sstream_put_str(&ss, "\"");
+            jsonPutAddr(&ss, ",\"fc\":", payload, 2);
+            jsonPutAddr(&ss, ",\"dst\":", nwk.dst, 2);
+            jsonPutAddr(&ss, ",\"src\":", nwk.src, 2);
+            jsonPutNum(&ss, ",\"radius\":", nwk.radius);
+            jsonPutNum(&ss, ",\"seq\":", nwk.seq);
+
+            if (nwk.dst64) jsonPutAddr(&ss, ",\"dst64\":", nwk.dst64, 8);
+            if (nwk.src64) jsonPutAddr(&ss, ",\"src64\":", nwk.src64, 8);
+
+            if (nwk.fc & NWK_FC_SECURITY)
+                U_sstream_put_str(&ss, ",\"sec\":true");
+
+            U_sstream_put_str(&ss, "}");
+        }
+    }
+    else
+    {
+        U_sstream_put_str(&ss, ",\"malformed\":true");
+    }
+
+    U_sstream_put_str(&ss, ",\"payload\":\"");
+    if (payloadLength)
+        U_sstream_put_hex(&ss, payload, payloadLength);
+    U_sstream_put_str(&ss, "\"}\n");
+
+    if (ss.status == U_SSTREAM_OK)
+        json->pos += ss.pos;
+}
+
+void SNIFF_JsonGap(SNIFF_Json *json, PL_time_t start, PL_time_t duration)
+{
+    U_SStream ss;
+
+    if (!json->file)
+        return;
+
+    if (sizeof(json->buf) - json->pos < 128)
+        jsonFlush(json);
+
+    if (json->pos == 0)
+        json->flushTime = PL_Time() + SNIFF_JSON_FLUSH_INTERVAL;
+
+    U_sstream_init(&ss, &json->buf[json->pos], (unsigned)(sizeof(json->buf) - json->pos));
+    jsonPutNum(&ss, "{\"ts\":", start);
+    jsonPutNum(&ss, ",\"gap\":", duration);
+    U_sstream_put_str(&ss, "}\n");
+
+    if (ss.status == U_SSTREAM_OK)
+        json->pos += ss.pos;
+}
+
+void SNIFF_JsonStep(SNIFF_Json *json, PL_time_t now)
+{
+    if (json->pos && json->flushTime < now)
+        jsonFlush(json);
+}
+
+void SNIFF_JsonExit(SNIFF_Json *json)
+{
+    if (json->file)
+    {
+        jsonFlush(json);
+        PL_FileClose(json->file);
+        json->file = 0;
+    }
+}
+
+#define SHM_SIZE (sizeof(SNIFF_ShmHeader) + SNIFF_SHM_SLOTS * sizeof(SNIFF_ShmSlot))
+
+int SNIFF_ShmInit(SNIFF_Shm *shm, const char *name)
+{
+    SNIFF_ShmHeader *hdr;
+
+    if (shm->hdr)
+        return 1;
+
+    hdr = PL_SharedMemoryOpen(name, SHM_SIZE);
+    if (!hdr)
+        return 0;
+
+    if (hdr->magic != SNIFF_SHM_MAGIC ||
+        hdr->version != SNIFF_SHM_VERSION ||
+        hdr->slotCount != SNIFF_SHM_SLOTS ||
+        hdr->slotSize != sizeof(SNIFF_ShmSlot))
+    {
+        hdr->magic = 0;
+        SHM_FENCE_RELEASE();
+        U_bzero(hdr, SHM_SIZE);
+        hdr->version = SNIFF_SHM_VERSION;
+        hdr->slotCount = SNIFF_SHM_SLOTS;
+        hdr->slotSize = sizeof(SNIFF_ShmSlot);
+        hdr->writeSeq = 0;
+        SHM_FENCE_RELEASE();
+        hdr->magic = SNIFF_SHM_MAGIC;
+    }
+
+    shm->hdr = hdr;
+    shm->slots = (SNIFF_ShmSlot*)(hdr + 1);
+
+    return 1;
+}
+
+void SNIFF_ShmPush(SNIFF_Shm *shm, const SNIFF_Frame *frame)
+{
+    unsigned long long seq;
+    SNIFF_ShmSlot *slot;
+
+    if (!shm->hdr || frame->length > SNIFF_SHM_SLOT_DATA)
+        return;
+
+    seq = shm->hdr->writeSeq;
+    slot = &shm->slots[seq & (SNIFF_SHM_SLOTS - 1)];
+
+    SHM_STORE_RELEASE(&slot->seq, 0);
+    SHM_FENCE_RELEASE();
+
+    slot->timestamp = frame->timestamp;
+    slot->channel = frame->channel;
+    slot->length = frame->length;
+    U_memcpy(slot->data, frame->data, frame->length);
+
+    SHM_STORE_RELEASE(&slot->seq, seq + 1);
+    SHM_STORE_RELEASE(&shm->hdr->writeSeq, seq + 1);
+}
+
+void SNIFF_ShmExit(SNIFF_Shm *shm)
+{
+    if (shm->hdr)
+    {
+        PL_SharedMemoryClose(shm->hdr, SHM_SIZE);
+        shm->hdr = 0;
+        shm->slots = 0;
+    }
+}
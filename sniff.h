@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef SNIFF_H
+#define SNIFF_H
+
+#include "gcf.h"
+
+/* Sniffer frame sinks.
+
+   A frame is the IEEE 802.15.4 MAC frame as received from the ZShark
+   sniffer firmware, including the two trailing FCS bytes. The timestamp
+   is taken by the host on reception.
+*/
+
+typedef struct SNIFF_Frame
+{
+    PL_time_t timestamp; /* wall clock in milliseconds */
+    unsigned channel;
+    unsigned length;
+    const unsigned char *data;
+} SNIFF_Frame;
+
+/* Pre-trigger ring capture
+
+   Keeps the most recent frames in memory, limited by age and size.
+   When a trigger fires the content is written to a pcap file and frames
+   of the following SNIFF_RING_POST_TRIGGER milliseconds are appended.
+*/
+#define SNIFF_RING_MAX_SIZE (1UL << 24) /* 16 MB */
+#define SNIFF_RING_MAX_PATTERN 32
+#define SNIFF_RING_POST_TRIGGER 2000
+
+typedef struct SNIFF_Ring
+{
+    unsigned char *buf;
+    unsigned long size;
+    unsigned long head;  /* oldest record */
+    unsigned long tail;  /* next write position */
+    unsigned long count; /* number of records */
+    PL_time_t window;    /* max. age of records in ms */
+    PL_time_t postEnd;   /* end of post trigger capture */
+    PL_File file;        /* open during post trigger capture */
+    const char *prefix;
+    unsigned patternLength;
+    unsigned char pattern[SNIFF_RING_MAX_PATTERN];
+} SNIFF_Ring;
+
+/*! Sets up the ring, the content is kept when called again. */
+int SNIFF_RingInit(SNIFF_Ring *ring, const char *prefix, unsigned long seconds, unsigned long size);
+void SNIFF_RingPush(SNIFF_Ring *ring, const SNIFF_Frame *frame);
+/*! Writes the ring content to <prefix>-<unix ms>.pcap. */
+void SNIFF_RingTrigger(SNIFF_Ring *ring, const char *reason);
+/*! Closes the capture file after the post trigger period. */
+void SNIFF_RingStep(SNIFF_Ring *ring, PL_time_t now);
+void SNIFF_RingExit(SNIFF_Ring *ring);
+
+/* JSON-lines decode stream
+
+   Writes one JSON object per line with the decoded IEEE 802.15.4 MAC
+   header and, for unsecured data frames, the Zigbee NWK header.
+   Output is buffered and flushed when full or after
+   SNIFF_JSON_FLUSH_INTERVAL milliseconds.
+*/
+#define SNIFF_JSON_BUFFER_SIZE 16384
+#define SNIFF_JSON_FLUSH_INTERVAL 500
+
+typedef struct SNIFF_Json
+{
+    PL_File file;
+    PL_time_t flushTime; /* time of oldest unflushed line */
+    unsigned long pos;
+    unsigned char buf[SNIFF_JSON_BUFFER_SIZE];
+} SNIFF_Json;
+
+/*! Opens \p path for appending, "-" writes to stdout. */
+int SNIFF_JsonInit(SNIFF_Json *json, const char *path);
+void SNIFF_JsonPush(SNIFF_Json *json, const SNIFF_Frame *frame);
+/*! Records a capture gap of \p duration milliseconds starting at \p start. */
+void SNIFF_JsonGap(SNIFF_Json *json, PL_time_t start, PL_time_t duration);
+void SNIFF_JsonStep(SNIFF_Json *json, PL_time_t now);
+void SNIFF_JsonExit(SNIFF_Json *json);
+
+/* Shared memory ring
+
+   Single producer, multiple consumer ring in the named shared memory
+   region (/dev/shm/<name> on POSIX, Local\<name> on Windows). The region
+   starts with SNIFF_ShmHeader followed by slotCount SNIFF_ShmSlot.
+   Frame n is stored in slot n % slotCount, its seq is set to n + 1 once
+   the frame is complete and 0 while it is written.
+
+   Reader, starting with next = writeSeq:
+
+     1. head = writeSeq (acquire), nothing to read if next == head
+     2. if head - next > slotCount frames were overwritten,
+        continue with next = head - slotCount
+     3. s1 = slot.seq (acquire), copy the frame,
+        atomic_thread_fence(memory_order_acquire), s2 = slot.seq
+        if s1 != next + 1 or s2 != s1 the slot was overwritten, go to 1
+     4. next += 1
+
+   The header and slot layout only uses fixed size fields.
+*/
+#define SNIFF_SHM_MAGIC     0x46534347 /* "GCSF" */
+#define SNIFF_SHM_VERSION   1
+#define SNIFF_SHM_SLOTS     4096 /* power of two */
+#define SNIFF_SHM_SLOT_DATA 168  /* slot size 192 bytes */
+
+typedef struct SNIFF_ShmHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int slotCount;
+    unsigned int slotSize;
+    volatile unsigned long long writeSeq; /* number of frames written */
+    unsigned char reserved[40];
+} SNIFF_ShmHeader;
+
+typedef struct SNIFF_ShmSlot
+{
+    volatile unsigned long long seq;
+    unsigned long long timestamp; /* wall clock in milliseconds */
+    unsigned int channel;
+    unsigned int length;
+    unsigned char data[SNIFF_SHM_SLOT_DATA];
+} SNIFF_ShmSlot;
+
+typedef struct SNIFF_Shm
+{
+    SNIFF_ShmHeader *hdr;
+    SNIFF_ShmSlot *slots;
+} SNIFF_Shm;
+
+/*! Maps the region, the sequence continues if it has been used before. */
+int SNIFF_ShmInit(SNIFF_Shm *shm, const char *name);
+void SNIFF_ShmPush(SNIFF_Shm *shm, const SNIFF_Frame *frame);
+void SNIFF_ShmExit(SNIFF_Shm *shm);
+
+#endif /* SNIFF_H */
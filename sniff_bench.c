@@ -0,0 +1,507 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+/* Sniffer traffic generator and loss benchmark (POSIX)
+
+   Plays the ZShark sniffer firmware on a pseudo terminal, runs GCFFlasher
+   in sniffer mode on it and counts the ZEP packets which arrive on UDP
+   port 17754. For each rate a line with sent/received frames is printed.
+
+   cmake -B build -D BUILD_SNIFF_BENCH=ON .
+   ./build/sniff_bench -r 100,500,1000,2000 -l 9,127 -t 5
+
+   Each generated frame carries a 32-bit frame id after the MAC sequence
+   number, so only frames of the current step are counted.
+*/
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#ifndef GCF_PATH
+  #define GCF_PATH "./GCFFlasher"
+#endif
+
+#define ZEP_PORT 17754
+#define ZEP_DATA_HDR_SIZE 32
+#define MAX_RATES 32
+#define MIN_FRAME_LENGTH 9 /* fc(2) seq(1) id(4) fcs(2) */
+#define MAX_FRAME_LENGTH 127
+
+typedef struct
+{
+    int master;
+    int slave;
+    int udp;
+    int stdinPipe;
+    pid_t child;
+
+    unsigned long rng;
+    unsigned long nextId;
+
+    /* current step */
+    unsigned long firstId;
+    unsigned long received;
+
+    /* pending pty output */
+    unsigned txPos;
+    unsigned txLength;
+    unsigned char txBuf[4096];
+} Bench;
+
+static Bench bench;
+
+static unsigned long long benchTimeUs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+static unsigned long benchRandom(void)
+{
+    /* xorshift32, fixed seed for reproducible size distribution */
+    bench.rng ^= (bench.rng << 13) & 0xFFFFFFFF;
+    bench.rng ^= bench.rng >> 17;
+    bench.rng ^= (bench.rng << 5) & 0xFFFFFFFF;
+    return bench.rng;
+}
+
+static int benchParseList(const char *str, unsigned long *out, int max)
+{
+    int n;
+    char *end;
+
+    for (n = 0; n < max && *str; n++)
+    {
+        out[n] = strtoul(str, &end, 10);
+        if (end == str || (*end != ',' && *end != '\0'))
+            return -1;
+
+        str = *end == ',' ? end + 1 : end;
+    }
+
+    return n;
+}
+
+static int benchOpenPty(void)
+{
+    const char *name;
+
+    bench.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (bench.master < 0 || grantpt(bench.master) != 0 || unlockpt(bench.master) != 0)
+        return -1;
+
+    name = ptsname(bench.master);
+    if (!name)
+        return -1;
+
+    /* keep the slave open so GCFFlasher reconnects don't hang up the master */
+    bench.slave = open(name, O_RDWR | O_NOCTTY);
+    if (bench.slave < 0)
+        return -1;
+
+    fcntl(bench.master, F_SETFL, fcntl(bench.master, F_GETFL) | O_NONBLOCK);
+
+    return 0;
+}
+
+static int benchOpenUdp(void)
+{
+    int size;
+    struct sockaddr_in addr;
+
+    bench.udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (bench.udp < 0)
+        return -1;
+
+    size = 8 << 20;
+    setsockopt(bench.udp, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(ZEP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(bench.udp, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+        return -1;
+
+    return 0;
+}
+
+static int benchStartGcf(const char *gcfPath, int verbose)
+{
+    int fd;
+    int pipefd[2];
+
+    if (pipe(pipefd) != 0)
+        return -1;
+
+    bench.child = fork();
+    if (bench.child < 0)
+        return -1;
+
+    if (bench.child == 0)
+    {
+        /* GCFFlasher polls stdin, keep it open but silent */
+        dup2(pipefd[0], STDIN_FILENO);
+        close(pipefd[1]);
+
+        if (!verbose)
+        {
+            fd = open("/dev/null", O_WRONLY);
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+
+        execl(gcfPath, gcfPath, "-d", ptsname(bench.master), "-s", "11", "-H", "127.0.0.1", (char*)NULL);
+        fprintf(stderr, "failed to start %s: %s\n", gcfPath, strerror(errno));
+        _exit(1);
+    }
+
+    close(pipefd[0]);
+    bench.stdinPipe = pipefd[1];
+
+    return 0;
+}
+
+/* Answers sniffer firmware commands, returns 1 when sniffing was started. */
+static int benchHandleCommands(void)
+{
+    int n;
+    int started;
+    char buf[256];
+
+    started = 0;
+
+    for (;;)
+    {
+        n = (int)read(bench.master, buf, sizeof(buf) - 1);
+        if (n <= 0)
+            break;
+
+        buf[n] = '\0';
+
+        if (strstr(buf, "idle") || strstr(buf, "chan"))
+        {
+            if (write(bench.master, "OK\n", 3) != 3)
+                return -1;
+        }
+
+        if (strstr(buf, "sniff"))
+        {
+            if (write(bench.master, "OK\n", 3) != 3)
+                return -1;
+            started = 1;
+        }
+    }
+
+    return started;
+}
+
+static void benchReceiveUdp(void)
+{
+    int n;
+    unsigned long id;
+    unsigned char buf[512];
+
+    for (;;)
+    {
+        n = (int)recv(bench.udp, buf, sizeof(buf), 0);
+        if (n < 0)
+            break;
+
+        if (n < ZEP_DATA_HDR_SIZE + MIN_FRAME_LENGTH || buf[0] != 'E' || buf[1] != 'X' || buf[3] != 1)
+            continue;
+
+        id = (unsigned long)buf[ZEP_DATA_HDR_SIZE + 3] |
+             (unsigned long)buf[ZEP_DATA_HDR_SIZE + 4] << 8 |
+             (unsigned long)buf[ZEP_DATA_HDR_SIZE + 5] << 16 |
+             (unsigned long)buf[ZEP_DATA_HDR_SIZE + 6] << 24;
+
+        if (id >= bench.firstId && id < bench.nextId)
+            bench.received++;
+    }
+}
+
+/* Queues a record: 0x01 len <8 byte timestamp> frame 0x04 */
+static void benchQueueFrame(unsigned length)
+{
+    unsigned i;
+    unsigned char *p;
+
+    p = &bench.txBuf[0];
+
+    *p++ = 0x01;
+    *p++ = (unsigned char)(8 + length);
+    for (i = 1; i <= 8; i++)
+        *p++ = (unsigned char)i; /* dummy timestamp as sent by firmware */
+
+    *p++ = 0x41; /* fc: data, PAN ID compression, short addresses */
+    *p++ = 0x88;
+    *p++ = (unsigned char)bench.nextId;
+    *p++ = (unsigned char)bench.nextId;
+    *p++ = (unsigned char)(bench.nextId >> 8);
+    *p++ = (unsigned char)(bench.nextId >> 16);
+    *p++ = (unsigned char)(bench.nextId >> 24);
+
+    for (i = 7; i < length; i++)
+        *p++ = (unsigned char)benchRandom();
+
+    *p++ = 0x04;
+
+    bench.txPos = 0;
+    bench.txLength = (unsigned)(p - &bench.txBuf[0]);
+    bench.nextId++;
+}
+
+static void benchFlush(void)
+{
+    ssize_t n;
+
+    while (bench.txPos < bench.txLength)
+    {
+        n = write(bench.master, &bench.txBuf[bench.txPos], bench.txLength - bench.txPos);
+        if (n <= 0)
+            break;
+        bench.txPos += (unsigned)n;
+    }
+}
+
+static void benchRunStep(unsigned long rate, unsigned long seconds, unsigned long minLength, unsigned long maxLength)
+{
+    unsigned long due;
+    unsigned long sent;
+    unsigned long skipped;
+    unsigned long long start;
+    unsigned long long now;
+    unsigned long long end;
+    struct pollfd fds[2];
+
+    bench.firstId = bench.nextId;
+    bench.received = 0;
+    sent = 0;
+    skipped = 0;
+
+    start = benchTimeUs();
+    end = start + (unsigned long long)seconds * 1000000;
+
+    for (now = start; now < end; now = benchTimeUs())
+    {
+        due = (unsigned long)(((now - start) * rate) / 1000000);
+
+        for (; sent + skipped < due;)
+        {
+            if (bench.txPos < bench.txLength)
+            {
+                /* pty is full, the firmware would drop the frame */
+                skipped++;
+                continue;
+            }
+
+            benchQueueFrame((unsigned)(minLength + benchRandom() % (maxLength - minLength + 1)));
+            benchFlush();
+            sent++;
+        }
+
+        fds[0].fd = bench.master;
+        fds[0].events = POLLIN | (bench.txPos < bench.txLength ? POLLOUT : 0);
+        fds[1].fd = bench.udp;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, 1) > 0)
+        {
+            if (fds[0].revents & POLLIN)
+                benchHandleCommands();
+            if (fds[0].revents & POLLOUT)
+                benchFlush();
+            if (fds[1].revents & POLLIN)
+                benchReceiveUdp();
+        }
+    }
+
+    /* drain */
+    for (end = benchTimeUs() + 1000000; benchTimeUs() < end;)
+    {
+        benchFlush();
+        fds[0].fd = bench.udp;
+        fds[0].events = POLLIN;
+        if (poll(fds, 1, 10) > 0)
+            benchReceiveUdp();
+    }
+
+    printf("%8lu %8lu %8lu %8lu %8lu %7.2f\n", rate, sent, skipped, bench.received,
+           sent - bench.received,
+           sent ? (double)(sent - bench.received) * 100.0 / (double)sent : 0.0);
+    fflush(stdout);
+}
+
+static void benchUsage(void)
+{
+    printf("usage: sniff_bench <options>\n"
+           "options:\n"
+           " -g <path>            GCFFlasher executable, default " GCF_PATH "\n"
+           " -r <rate>[,<rate>]   frames per second, default 100,250,500,1000,2000,4000\n"
+           " -l <min>[,<max>]     frame length range, default 9,127\n"
+           " -t <seconds>         duration per rate, default 5\n"
+           " -v                   show GCFFlasher output\n");
+}
+
+int main(int argc, char **argv)
+{
+    int i;
+    int n;
+    int nrates;
+    int verbose;
+    int started;
+    const char *gcfPath;
+    unsigned long seconds;
+    unsigned long lengths[2];
+    unsigned long rates[MAX_RATES] = { 100, 250, 500, 1000, 2000, 4000 };
+    unsigned long long end;
+    struct pollfd pfd;
+
+    gcfPath = GCF_PATH;
+    nrates = 6;
+    seconds = 5;
+    lengths[0] = MIN_FRAME_LENGTH;
+    lengths[1] = MAX_FRAME_LENGTH;
+    verbose = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0')
+        {
+            benchUsage();
+            return 1;
+        }
+
+        if (argv[i][1] == 'v')
+        {
+            verbose = 1;
+            continue;
+        }
+
+        if (argv[i][1] == 'h' || (i + 1) == argc)
+        {
+            benchUsage();
+            return argv[i][1] == 'h' ? 0 : 1;
+        }
+
+        switch (argv[i][1])
+        {
+        case 'g':
+            gcfPath = argv[++i];
+            break;
+
+        case 'r':
+            nrates = benchParseList(argv[++i], rates, MAX_RATES);
+            if (nrates <= 0)
+            {
+                benchUsage();
+                return 1;
+            }
+            break;
+
+        case 'l':
+            n = benchParseList(argv[++i], lengths, 2);
+            if (n == 1)
+                lengths[1] = lengths[0];
+
+            if (n <= 0 || lengths[0] < MIN_FRAME_LENGTH || lengths[1] > MAX_FRAME_LENGTH || lengths[0] > lengths[1])
+            {
+                printf("frame length must be in range %d..%d\n", MIN_FRAME_LENGTH, MAX_FRAME_LENGTH);
+                return 1;
+            }
+            break;
+
+        case 't':
+            seconds = strtoul(argv[++i], NULL, 10);
+            if (seconds == 0)
+                seconds = 1;
+            break;
+
+        default:
+            benchUsage();
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    bench.rng = 0x1234567;
+    bench.nextId = 1;
+
+    if (benchOpenPty() != 0)
+    {
+        printf("failed to open pty: %s\n", strerror(errno));
+        return 2;
+    }
+
+    if (benchOpenUdp() != 0)
+    {
+        printf("failed to bind UDP port %d: %s\n", ZEP_PORT, strerror(errno));
+        return 2;
+    }
+
+    if (benchStartGcf(gcfPath, verbose) != 0)
+    {
+        printf("failed to start %s\n", gcfPath);
+        return 2;
+    }
+
+    started = 0;
+    for (end = benchTimeUs() + 10000000; !started && benchTimeUs() < end;)
+    {
+        pfd.fd = bench.master;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 10) > 0)
+            started = benchHandleCommands() > 0;
+    }
+
+    if (!started)
+    {
+        printf("GCFFlasher didn't start sniffing\n");
+        kill(bench.child, SIGTERM);
+        waitpid(bench.child, NULL, 0);
+        return 3;
+    }
+
+    usleep(100000);
+
+    printf("frame length %lu..%lu, %lu s per rate\n", lengths[0], lengths[1], seconds);
+    printf("%8s %8s %8s %8s %8s %7s\n", "rate", "sent", "skipped", "recv", "lost", "loss%");
+
+    for (i = 0; i < nrates; i++)
+    {
+        if (rates[i] == 0)
+            continue;
+
+        benchRunStep(rates[i], seconds, lengths[0], lengths[1]);
+    }
+
+    kill(bench.child, SIGTERM);
+    waitpid(bench.child, NULL, 0);
+
+    return 0;
+}
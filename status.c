@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "status.h"
+#include "u_mem.h"
+
+int STATUS_Init(STATUS_Shm *shm, const char *name)
+{
+    STATUS_Block *block;
+
+    if (shm->block)
+        return 1;
+
+    block = PL_SharedMemoryOpen(name, sizeof(*block));
+    if (!block)
+        return 0;
+
+    if (block->magic != STATUS_SHM_MAGIC ||
+        block->version != STATUS_SHM_VERSION ||
+        block->size != sizeof(*block))
+    {
+        block->magic = 0;
+        SHM_FENCE_RELEASE();
+        U_bzero(block, sizeof(*block));
+        block->version = STATUS_SHM_VERSION;
+        block->size = sizeof(*block);
+        SHM_FENCE_RELEASE();
+        block->magic = STATUS_SHM_MAGIC;
+    }
+    else if (block->seq & 1) /* previous writer died during an update */
+    {
+        SHM_STORE_RELEASE(&block->seq, block->seq + 1);
+    }
+
+    shm->block = block;
+
+    return 1;
+}
+
+void STATUS_Publish(STATUS_Shm *shm, const STATUS_Info *info)
+{
+    unsigned long long seq;
+    STATUS_Block *block;
+
+    block = shm->block;
+    if (!block)
+        return;
+
+    seq = block->seq;
+
+    SHM_STORE_RELEASE(&block->seq, seq + 1);
+    SHM_FENCE_RELEASE();
+
+    U_memcpy(&block->info, info, sizeof(*info));
+    block->heartbeat++;
+
+    SHM_STORE_RELEASE(&block->seq, seq + 2);
+}
+
+void STATUS_Exit(STATUS_Shm *shm)
+{
+    if (shm->block)
+    {
+        PL_SharedMemoryClose(shm->block, sizeof(*shm->block));
+        shm->block = 0;
+    }
+}
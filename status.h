@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include "gcf.h"
+
+/* Shared memory status block
+
+   The status of the running task is published in the named shared memory
+   region (/dev/shm/<name> on POSIX, Local\<name> on Windows) so that a
+   supervisor can poll many instances without reading their output.
+   The block is updated with a seqlock, seq is odd while it is written.
+
+   Reader:
+
+     1. s1 = seq (acquire), retry if s1 is odd
+     2. copy info
+     3. atomic_thread_fence(memory_order_acquire), so the copy can't
+        move past the next load
+     4. s2 = seq, retry if s2 != s1
+
+   heartbeat is incremented on every update, which happens at least every
+   STATUS_INTERVAL milliseconds while the process is alive. The block
+   stays in place after the process has exited.
+*/
+#define STATUS_SHM_MAGIC        0x53534347 /* "GCSS" */
+#define STATUS_SHM_VERSION      1
+#define STATUS_INTERVAL         100
+#define STATUS_MAX_ERROR_LENGTH 128
+
+#define STATUS_RESULT_RUNNING 0
+#define STATUS_RESULT_SUCCESS 1
+#define STATUS_RESULT_FAILED  2
+
+typedef struct STATUS_Info
+{
+    unsigned long long timestamp; /* wall clock in milliseconds */
+    unsigned long long uploadDone; /* bytes */
+    unsigned long long uploadTotal;
+    unsigned long long bytesPerSec;
+    unsigned int retries;
+    unsigned int result; /* STATUS_RESULT_* */
+    char state[32];
+    char device[128];
+    char error[STATUS_MAX_ERROR_LENGTH]; /* last message before a retry or failure */
+} STATUS_Info;
+
+typedef struct STATUS_Block
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int size; /* sizeof(STATUS_Block) */
+    unsigned int reserved;
+    volatile unsigned long long seq;
+    unsigned long long heartbeat;
+    STATUS_Info info;
+} STATUS_Block;
+
+typedef struct STATUS_Shm
+{
+    STATUS_Block *block;
+} STATUS_Shm;
+
+/*! Maps the block, a no-op if it is already mapped. */
+int STATUS_Init(STATUS_Shm *shm, const char *name);
+/*! Copies \p info into the block and increments the heartbeat. */
+void STATUS_Publish(STATUS_Shm *shm, const STATUS_Info *info);
+void STATUS_Exit(STATUS_Shm *shm);
+
+#endif /* STATUS_H */
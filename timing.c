@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "timing.h"
+#include "u_sstream.h"
+#include "u_mem.h"
+
+static const char *timing_names[TIMING_PHASE_MAX] =
+{
+    "other_ms",
+    "reset_ms",
+    "bootloader_ms",
+    "sync_ms",
+    "upload_ms",
+    "verify_ms"
+};
+
+void TIMING_SetPhase(TIMING_State *t, TIMING_Phase phase)
+{
+    PL_time_t now;
+
+    if (t->runStart == 0)
+    {
+        if (phase == TIMING_PHASE_OTHER)
+            t->ended = 0;
+
+        if (phase == TIMING_PHASE_OTHER || t->ended)
+            return;
+
+        U_bzero(t, sizeof(*t));
+        t->runStart = PL_Time();
+        t->phaseStart = t->runStart;
+        t->phase = phase;
+        return;
+    }
+
+    if (t->phase == phase)
+        return;
+
+    now = PL_Time();
+    t->durations[t->phase] += now - t->phaseStart;
+    t->phaseStart = now;
+    t->phase = phase;
+}
+
+PL_time_t TIMING_PhaseTime(const TIMING_State *t, TIMING_Phase phase)
+{
+    PL_time_t result;
+
+    result = t->durations[phase];
+
+    if (t->runStart != 0 && t->phase == phase)
+        result += PL_Time() - t->phaseStart;
+
+    return result;
+}
+
+int TIMING_Write(TIMING_State *t, const char *path, GCF_Status status,
+                 const char *device, const char *file)
+{
+    int ret;
+    unsigned i;
+    PL_File fp;
+    PL_time_t total;
+    U_SStream ss;
+    char buf[1024];
+
+    if (t->runStart == 0)
+        return 0;
+
+    TIMING_SetPhase(t, TIMING_PHASE_OTHER); /* close current phase */
+    total = PL_Time() - t->runStart;
+    t->runStart = 0;
+    t->ended = 1;
+
+    U_sstream_init(&ss, &buf[0], sizeof(buf));
+    U_sstream_put_str(&ss, "{\"status\":\"");
+    U_sstream_put_str(&ss, status == GCF_SUCCESS ? "success" : "failed");
+    U_sstream_put_str(&ss, "\",\"device\":");
+    U_sstream_put_json_str(&ss, device);
+    U_sstream_put_str(&ss, ",\"file\":");
+    U_sstream_put_json_str(&ss, file);
+    U_sstream_put_str(&ss, ",\"total_ms\":");
+    U_sstream_put_ulonglong(&ss, total);
+
+    for (i = 0; i < TIMING_PHASE_MAX; i++)
+    {
+        U_sstream_put_str(&ss, ",\"");
+        U_sstream_put_str(&ss, timing_names[i]);
+        U_sstream_put_str(&ss, "\":");
+        U_sstream_put_ulonglong(&ss, t->durations[i]);
+    }
+
+    U_sstream_put_str(&ss, ",\"upload_bytes\":");
+    U_sstream_put_ulonglong(&ss, t->uploadBytes);
+    U_sstream_put_str(&ss, ",\"upload_bytes_per_sec\":");
+    if (t->durations[TIMING_PHASE_UPLOAD])
+        U_sstream_put_ulonglong(&ss, (unsigned long long)t->uploadBytes * 1000 / t->durations[TIMING_PHASE_UPLOAD]);
+    else
+        U_sstream_put_str(&ss, "0");
+    U_sstream_put_str(&ss, ",\"retries\":");
+    U_sstream_put_long(&ss, (long)t->retries);
+    U_sstream_put_str(&ss, "}\n");
+
+    if (ss.status != U_SSTREAM_OK)
+        return 0;
+
+    fp = PL_FileOpen(path, PL_FILE_APPEND);
+    if (!fp)
+        return 0;
+
+    ret = PL_FileWrite(fp, ss.str, ss.pos) == (int)ss.pos;
+    PL_FileClose(fp);
+
+    return ret;
+}
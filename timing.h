@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include "gcf.h"
+
+/* Flash timing report
+
+   gcf.c maps each state of a flash run to a phase and reports every
+   state change, the time is accumulated per phase including retries.
+   The run starts with the first phase other than TIMING_PHASE_OTHER and
+   is summarised as one JSON line, e.g. to aggregate many runs.
+*/
+typedef enum TIMING_Phase
+{
+    TIMING_PHASE_OTHER = 0, /* init and waits between retries */
+    TIMING_PHASE_RESET,
+    TIMING_PHASE_BOOTLOADER,
+    TIMING_PHASE_SYNC,
+    TIMING_PHASE_UPLOAD,
+    TIMING_PHASE_VERIFY,
+    TIMING_PHASE_MAX
+} TIMING_Phase;
+
+typedef struct TIMING_State
+{
+    TIMING_Phase phase;
+    PL_time_t runStart; /* 0 when no run is active */
+    int ended; /* reported, the next run starts after TIMING_PHASE_OTHER */
+    PL_time_t phaseStart;
+    PL_time_t durations[TIMING_PHASE_MAX];
+    unsigned long uploadBytes;
+    unsigned retries;
+} TIMING_State;
+
+/*! Switches to \p phase, a no-op if it is the current one. */
+void TIMING_SetPhase(TIMING_State *t, TIMING_Phase phase);
+/*! \returns the time spent in \p phase so far, including the running phase. */
+PL_time_t TIMING_PhaseTime(const TIMING_State *t, TIMING_Phase phase);
+/*! Ends the run and appends the summary line to \p path ("-" for stdout).
+
+    \returns 1 on success, 0 if no run was active or the file can't be written.
+ */
+int TIMING_Write(TIMING_State *t, const char *path, GCF_Status status,
+                 const char *device, const char *file);
+
+#endif /* TIMING_H */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "u_sstream.h"
+#include "u_bstream.h"
+#include "u_mem.h"
+#include "trace.h"
+
+/* Ring record layout (little-endian), a record may wrap around the end
+
+   U16 data length
+   U64 timestamp
+   U8  direction
+   U8  data[]
+*/
+#define TRACE_HDR_SIZE 11
+#define TRACE_MAX_DATA 2048 /* larger buffers are split, fits the dump buffer */
+
+#define PCAP_MAGIC 0xA1B2C3D4
+#define PCAP_LINKTYPE_USER0 147
+
+static unsigned char traceRingBuf[TRACE_RING_SIZE];
+
+void TRACE_Init(TRACE_Ring *ring, const char *prefix)
+{
+    if (ring->buf)
+        return; /* keep content across retries */
+
+    ring->buf = &traceRingBuf[0];
+    ring->head = 0;
+    ring->used = 0;
+    ring->count = 0;
+    ring->dropped = 0;
+    ring->prefix = prefix;
+}
+
+static void traceWrite(TRACE_Ring *ring, unsigned long pos, const unsigned char *data, unsigned long length)
+{
+    unsigned long n;
+
+    pos %= TRACE_RING_SIZE;
+    n = TRACE_RING_SIZE - pos;
+    n = n < length ? n : length;
+
+    U_memcpy(&ring->buf[pos], data, n);
+    if (n < length)
+        U_memcpy(&ring->buf[0], data + n, length - n);
+}
+
+static void traceRead(const TRACE_Ring *ring, unsigned long pos, unsigned char *data, unsigned long length)
+{
+    unsigned long n;
+
+    pos %= TRACE_RING_SIZE;
+    n = TRACE_RING_SIZE - pos;
+    n = n < length ? n : length;
+
+    U_memcpy(data, &ring->buf[pos], n);
+    if (n < length)
+        U_memcpy(data + n, &ring->buf[0], length - n);
+}
+
+static unsigned long traceDataLength(const TRACE_Ring *ring, unsigned long pos)
+{
+    unsigned char len[2];
+
+    traceRead(ring, pos, &len[0], 2);
+    return len[0] | (unsigned long)len[1] << 8;
+}
+
+static void tracePop(TRACE_Ring *ring)
+{
+    unsigned long need;
+
+    Assert(ring->count > 0);
+    need = TRACE_HDR_SIZE + traceDataLength(ring, ring->head);
+    ring->head = (ring->head + need) % TRACE_RING_SIZE;
+    ring->used -= need;
+    ring->count--;
+}
+
+void TRACE_Push(TRACE_Ring *ring, unsigned dir, const unsigned char *data, unsigned length)
+{
+    unsigned i;
+    unsigned n;
+    unsigned long need;
+    unsigned long pos;
+    PL_time_t ts;
+    unsigned char hdr[TRACE_HDR_SIZE];
+
+    if (!ring->buf)
+        return;
+
+    ts = PL_WallTime();
+
+    for (; length; data += n, length -= n)
+    {
+        n = length < TRACE_MAX_DATA ? length : TRACE_MAX_DATA;
+        need = TRACE_HDR_SIZE + n;
+
+        for (;TRACE_RING_SIZE - ring->used < need;)
+        {
+            tracePop(ring);
+            ring->dropped++;
+        }
+
+        hdr[0] = n & 0xFF;
+        hdr[1] = (n >> 8) & 0xFF;
+        for (i = 0; i < 8; i++)
+            hdr[2 + i] = (ts >> (i * 8)) & 0xFF;
+        hdr[10] = dir & 0xFF;
+
+        pos = ring->head + ring->used;
+        traceWrite(ring, pos, &hdr[0], TRACE_HDR_SIZE);
+        traceWrite(ring, pos + TRACE_HDR_SIZE, data, n);
+
+        ring->used += need;
+        ring->count++;
+    }
+}
+
+long TRACE_Dump(TRACE_Ring *ring, char *path, unsigned size)
+{
+    long n;
+    int i;
+    unsigned long len;
+    PL_time_t ts;
+    PL_File fp;
+    U_SStream ss;
+    U_BStream bs;
+    unsigned char hdr[TRACE_HDR_SIZE];
+    unsigned char buf[4096];
+
+    if (!ring->buf || ring->count == 0)
+        return 0;
+
+    U_sstream_init(&ss, path, size);
+    U_sstream_put_str(&ss, ring->prefix);
+    U_sstream_put_str(&ss, "-");
+    U_sstream_put_ulonglong(&ss, PL_WallTime());
+    U_sstream_put_str(&ss, ".pcap");
+
+    if (ss.status != U_SSTREAM_OK)
+        return -1;
+
+    fp = PL_FileOpen(ss.str, PL_FILE_WRITE);
+    if (!fp)
+        return -1;
+
+    U_bstream_init(&bs, &buf[0], sizeof(buf));
+    U_bstream_put_u32_le(&bs, PCAP_MAGIC);
+    U_bstream_put_u16_le(&bs, 2); /* version major */
+    U_bstream_put_u16_le(&bs, 4); /* version minor */
+    U_bstream_put_u32_le(&bs, 0); /* this zone */
+    U_bstream_put_u32_le(&bs, 0); /* sigfigs */
+    U_bstream_put_u32_le(&bs, 65535); /* snaplen */
+    U_bstream_put_u32_le(&bs, PCAP_LINKTYPE_USER0);
+
+    for (n = 0; ring->count; n++)
+    {
+        traceRead(ring, ring->head, &hdr[0], TRACE_HDR_SIZE);
+        len = hdr[0] | (unsigned long)hdr[1] << 8;
+
+        ts = 0;
+        for (i = 7; i >= 0; i--)
+            ts = (ts << 8) | hdr[2 + i];
+
+        if (bs.size - bs.pos < 17 + len)
+        {
+            PL_FileWrite(fp, bs.data, bs.pos);
+            bs.pos = 0;
+        }
+
+        U_bstream_put_u32_le(&bs, (unsigned long)(ts / 1000));
+        U_bstream_put_u32_le(&bs, (unsigned long)(ts % 1000) * 1000);
+        U_bstream_put_u32_le(&bs, len + 1);
+        U_bstream_put_u32_le(&bs, len + 1);
+        U_bstream_put_u8(&bs, hdr[10]);
+
+        traceRead(ring, ring->head + TRACE_HDR_SIZE, &buf[bs.pos], len);
+        bs.pos += len;
+
+        tracePop(ring);
+    }
+
+    PL_FileWrite(fp, bs.data, bs.pos);
+    PL_FileClose(fp);
+    ring->dropped = 0;
+
+    return n;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "gcf.h"
+
+/* Serial wire trace
+
+   Keeps the most recent bytes sent to and received from the device in a
+   preallocated ring, the oldest records are dropped when it is full.
+   Recording is a copy into the ring, the trace is only formatted when it
+   is dumped to a pcap file (LINKTYPE_USER0, the first byte of each
+   packet is the TRACE_DIR_* direction).
+*/
+#define TRACE_RING_SIZE (1UL << 20) /* 1 MB */
+
+#define TRACE_DIR_RX 0 /* device to host */
+#define TRACE_DIR_TX 1 /* host to device */
+
+typedef struct TRACE_Ring
+{
+    unsigned char *buf;
+    unsigned long head;  /* oldest record */
+    unsigned long used;  /* bytes in use */
+    unsigned long count; /* number of records */
+    unsigned long dropped; /* records dropped since the last dump */
+    const char *prefix;
+} TRACE_Ring;
+
+/*! Sets up the ring, the content is kept when called again. */
+void TRACE_Init(TRACE_Ring *ring, const char *prefix);
+void TRACE_Push(TRACE_Ring *ring, unsigned dir, const unsigned char *data, unsigned length);
+/*! Writes the ring content to <prefix>-<unix ms>.pcap and empties the ring.
+
+    \returns the number of records written, 0 if the ring is empty
+             or -1 if the file can't be written.
+ */
+long TRACE_Dump(TRACE_Ring *ring, char *path, unsigned size);
+
+#endif /* TRACE_H */
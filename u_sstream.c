@@ -234,6 +234,42 @@ void U_sstream_put_str(U_SStream *ss, const char *str)
     }
 }
 
+void U_sstream_put_json_str(U_SStream *ss, const char *str)
+{
+    char ch[8];
+
+    U_sstream_put_str(ss, "\"");
+
+    for (; *str && U_sstream_remaining(ss) > 8; str++)
+    {
+        ch[0] = '\\';
+        ch[1] = *str;
+        ch[2] = '\0';
+
+        if      (*str == '\n') ch[1] = 'n';
+        else if (*str == '\r') ch[1] = 'r';
+        else if (*str == '\t') ch[1] = 't';
+        else if ((unsigned char)*str < 0x20)
+        {
+            ch[1] = 'u';
+            ch[2] = '0';
+            ch[3] = '0';
+            ch[4] = '0' + ((*str >> 4) & 1);
+            ch[5] = "0123456789abcdef"[*str & 0xF];
+            ch[6] = '\0';
+        }
+        else if (*str != '"' && *str != '\\')
+        {
+            ch[0] = *str;
+            ch[1] = '\0';
+        }
+
+        U_sstream_put_str(ss, &ch[0]);
+    }
+
+    U_sstream_put_str(ss, "\"");
+}
+
 /*  Outputs the signed 32/64-bit integer 'num' as ASCII string.
 
     The range is different on 32-bit systems and Windows
@@ -66,6 +66,13 @@ U_LIBAPI int U_sstream_find(U_SStream *ss, const char *str);
 U_LIBAPI void U_sstream_seek(U_SStream *ss, unsigned pos);
 U_LIBAPI void U_sstream_put_str(U_SStream *ss, const char *str);
 
+/** Outputs 'str' as quoted and escaped JSON string.
+ *
+ * Long strings are truncated to fit the stream, the result is always
+ * a complete JSON string.
+ */
+U_LIBAPI void U_sstream_put_json_str(U_SStream *ss, const char *str);
+
 /** Limited JSON friendly double to string conversion.
  *
  * Important: Only the values in range -2^53-1 to 2^53-1 are supported!